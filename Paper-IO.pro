@@ -1,5 +1,7 @@
 TEMPLATE = subdirs
-SUBDIRS = client server
+SUBDIRS = client selfplay server swarm
 
 client.file = client/client.pro
+selfplay.file = selfplay/selfplay.pro
 server.file = server/server.pro
+swarm.file = swarm/swarm.pro
@@ -10,14 +10,14 @@
 #include "arduino.h"
 #include "render.h"
 
-Arduino::Arduino(ClientGameState &gs, QObject *parent)
+Arduino::Arduino(ViewBuffer &vb, QObject *parent)
 	: QObject(parent)
 	, ctc(new QSerialPort(this))
 	, started(false)
 	, ba(1)
 	, bb(1)
 	, gfx()
-	, cgs(gs)
+	, views(vb)
 {
 	ctc->setBaudRate(115200);
 	ctc->setParity(QSerialPort::NoParity);
@@ -162,9 +162,7 @@ void Arduino::renderTick()
 	if (!ctc->isOpen())
 		return;
 
-	cgs.lockState();
-	renderGameArduino(cgs, gfx);
-	cgs.unlock();
+	renderGameArduino(views.latest(), gfx);
 
 	sendBuffer();
 }
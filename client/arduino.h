@@ -8,15 +8,15 @@
 #include <QtSerialPort/QSerialPort>
 
 #include "buffergfx.h"
-#include "clientgamestate.h"
 #include "types.h"
+#include "viewbuffer.h"
 
 class Arduino : public QObject
 {
 	Q_OBJECT
 
 public:
-	Arduino(ClientGameState &cgs, QObject *parent = Q_NULLPTR);
+	Arduino(ViewBuffer &views, QObject *parent = Q_NULLPTR);
 
 	/*
 	 * Tries to connect to the arduino. Returns -1 if already connected,
@@ -49,7 +49,7 @@ private:
 	quint32 bb;
 
 	BufferGFX gfx;
-	ClientGameState &cgs;
+	ViewBuffer &views;
 
 	void sendBuffer();
 };
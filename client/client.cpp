@@ -11,20 +11,20 @@
 
 #include "client.h"
 
-Client::Client(QWidget *parent)
+Client::Client(bool udp, bool spectate, plid_t target, QWidget *parent)
 	: QWidget(parent)
 	, cgs()
+	, views()
 	, stack(new QStackedLayout)
 	, session(Q_NULLPTR)
 	, timeout(new QTimer(this))
-	, ioh(new IOHandler(cgs))
+	, ioh(new IOHandler(cgs, &views))
 	, iothread(new QThread(this))
 	, disconnecting(false)
-	, arduino(new Arduino(cgs, this))
+	, arduino(new Arduino(views, this))
 	, launcher(new Launcher)
 	, waiting(new Waiting)
-	, render(new GameWidget(cgs))
-	, rtimer(new QTimer(this))
+	, render(new GameWidget(views))
 	, gameover(new GameOver)
 {
 	setWindowTitle(tr("Arduino-IO"));
@@ -39,9 +39,9 @@ Client::Client(QWidget *parent)
 	layout->addLayout(stack);
 	setLayout(layout);
 
-	rtimer->setInterval(30);
-
 	// Network setup
+	ioh->setUdp(udp);
+	ioh->setSpectate(spectate, target);
 	ioh->moveToThread(iothread);
 	connect(iothread, &QThread::finished, ioh, &QObject::deleteLater);
 	
@@ -73,7 +73,7 @@ Client::Client(QWidget *parent)
 		this->launcher->setStatus(tr("Ready."));
 	});
 	connect(ioh, &IOHandler::disconnected, launcher, &Launcher::enable);
-	connect(ioh, &IOHandler::disconnected, rtimer, &QTimer::stop);
+	connect(ioh, &IOHandler::disconnected, render, &GameWidget::stop);
 	connect(ioh, &IOHandler::disconnected, render, &QWidget::clearFocus);
 	connect(ioh, &IOHandler::disconnected, arduino, &Arduino::renderLauncher);
 	connect(ioh, &IOHandler::disconnected, stack, [this] {
@@ -85,7 +85,7 @@ Client::Client(QWidget *parent)
 	});
 	connect(ioh, &IOHandler::queued, arduino, &Arduino::renderWaiting);
 
-	connect(ioh, &IOHandler::enteredGame, rtimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+	connect(ioh, &IOHandler::enteredGame, render, &GameWidget::start);
 	connect(ioh, &IOHandler::enteredGame, stack, [this] {
 		this->stack->setCurrentIndex(2);
 	});
@@ -96,7 +96,7 @@ Client::Client(QWidget *parent)
 		QTimer::singleShot(50, this->arduino, &Arduino::renderTick);
 	} );
 
-	connect(ioh, &IOHandler::gameEnded, rtimer, &QTimer::stop);
+	connect(ioh, &IOHandler::gameEnded, render, &GameWidget::stop);
 	connect(ioh, &IOHandler::gameEnded, render, &QWidget::clearFocus);
 	connect(ioh, &IOHandler::gameEnded, gameover, &GameOver::setScore);
 	connect(ioh, &IOHandler::gameEnded, arduino, &Arduino::renderGameOver);
@@ -109,7 +109,7 @@ Client::Client(QWidget *parent)
 	});
 	connect(waiting, &Waiting::cancel, ioh, &IOHandler::disconnect);
 
-	connect(rtimer, &QTimer::timeout, render, &GameWidget::animate);
+	connect(ioh, &IOHandler::gameTick, render, &GameWidget::animate);
 	connect(render, &GameWidget::changeDirection, ioh, &IOHandler::changeDirection);
 	connect(render, &GameWidget::changeKiosk, this, [this] {
 		cgs.lockState();
@@ -133,9 +133,12 @@ Client::Client(QWidget *parent)
 			break;
 		case 2:
 		{
-			cgs.lockState();
-			Direction dir = Direction((cgs.getClient()->getDirection() % 4) + 1);
-			cgs.unlock();
+			// Spectating the whole board, there's no one to steer. A newer
+			// view could come in between two calls to latest(), so take one.
+			const ClientGameState &view = views.latest();
+			if (!view.getClient())
+				break;
+			Direction dir = Direction((view.getClient()->getDirection() % 4) + 1);
 
 			QMetaObject::invokeMethod(ioh, "changeDirection", Q_ARG(Direction, dir));
 			break;
@@ -155,9 +158,10 @@ Client::Client(QWidget *parent)
 			break;
 		case 2:
 		{
-			cgs.lockState();
-			Direction dir = Direction(((cgs.getClient()->getDirection() + 2) % 4) + 1);
-			cgs.unlock();
+			const ClientGameState &view = views.latest();
+			if (!view.getClient())
+				break;
+			Direction dir = Direction(((view.getClient()->getDirection() + 2) % 4) + 1);
 
 			QMetaObject::invokeMethod(ioh, "changeDirection", Q_ARG(Direction, dir));
 			break;
@@ -19,6 +19,7 @@
 #include "gameover.h"
 #include "iohandler.h"
 #include "launcher.h"
+#include "viewbuffer.h"
 #include "waiting.h"
 
 class Client : public QWidget
@@ -26,7 +27,12 @@ class Client : public QWidget
 	Q_OBJECT
 
 public:
-	Client(QWidget *parent = Q_NULLPTR);
+	/*
+	 * With udp, game ticks are asked for over UDP. With spectate, games
+	 * are watched rather than played, following target or, if it is
+	 * NULL_ID, the whole board.
+	 */
+	Client(bool udp = false, bool spectate = false, plid_t target = NULL_ID, QWidget *parent = Q_NULLPTR);
 	~Client();
 
 	QSize sizeHint() const override;
@@ -41,6 +47,7 @@ private slots:
 
 private:
 	ClientGameState cgs;
+	ViewBuffer views;
 
 	QStackedLayout *stack;
 
@@ -56,7 +63,6 @@ private:
 	Launcher *launcher;
 	Waiting *waiting;
 	GameWidget *render;
-	QTimer *rtimer;
 	GameOver *gameover;
 };
 
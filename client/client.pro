@@ -23,6 +23,7 @@ HEADERS += adafruit_gfx.h \
 	client.h \
 	clientgamestate.h \
 	font.h \
+	framehistogram.h \
 	gameover.h \
 	gamewidget.h \
 	gfxfont.h \
@@ -31,9 +32,14 @@ HEADERS += adafruit_gfx.h \
 	kioskai.h \
 	launcher.h \
 	render.h \
+	tickclock.h \
+	viewbuffer.h \
 	waiting.h \
+	../common/aiengine.h \
 	../common/protocol.h \
-	../common/types.h
+	../common/tickcoder.h \
+	../common/types.h \
+	../common/udplink.h
 SOURCES += main.cpp \
 	adafruit_gfx.cpp \
 	arduino.cpp \
@@ -43,22 +49,35 @@ SOURCES += main.cpp \
 	clientplayer.cpp \
 	clientsquarestate.cpp \
 	font.cpp \
+	framehistogram.cpp \
 	gameover.cpp \
 	gamewidget.cpp \
 	iohandler.cpp \
 	kioskai.cpp \
 	launcher.cpp \
 	render.cpp \
+	tickclock.cpp \
+	viewbuffer.cpp \
 	waiting.cpp \
 # Common files
+	../common/packetcapabilities.cpp \
+	../common/packetcatchup.cpp \
 	../common/packetgameend.cpp \
 	../common/packetgamejoin.cpp \
 	../common/packetgametick.cpp \
 	../common/packetleaderboardupdate.cpp \
+	../common/packetpartialboard.cpp \
+	../common/packetplayersdelta.cpp \
 	../common/packetplayersupdate.cpp \
 	../common/packetrequestjoin.cpp \
+	../common/packetrequestspectate.cpp \
 	../common/packetresendboard.cpp \
+	../common/packettimesync.cpp \
+	../common/packetudp.cpp \
 	../common/packetupdatedir.cpp \
-	../common/protocol.cpp
+	../common/protocol.cpp \
+	../common/tickcoder.cpp \
+	../common/tickcodes.cpp \
+	../common/udplink.cpp
 
 
@@ -2,20 +2,50 @@
  * Implements ClientGameState
  */
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
 #include "clientgamestate.h"
 #include "protocol.h"
 
+/*
+ * XORs n states from src into dst, four at a time where SSE2 is around.
+ */
+static void xorStates(state_t *dst, const state_t *src, int n)
+{
+	int i = 0;
+#ifdef __SSE2__
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(a, b));
+	}
+#endif // __SSE2__
+	for (; i < n; ++i)
+		dst[i] ^= src[i];
+}
+
 ClientGameState::ClientGameState()
 	: lock()
 	, players()
 	, tick(0)
 	, tickRate(0)
 	, lastTick()
+	, received()
+	, tickDelay(0)
+	, roundTrip(-1)
+	, originX(0)
+	, originY(0)
+	, goodTick(0)
 	, client(NULL_ID)
 	, kiosk(0)
 {
 	std::fill(leaderboard, leaderboard + 5, std::make_pair(NULL_ID, 0));
 	std::fill(board[0], board[0] + CLIENT_FRAME * CLIENT_FRAME, 0);
+	forgetGood();
+	std::fill(index, index + 256, static_cast<ClientPlayer *>(NULL));
 }
 
 ClientGameState::~ClientGameState()
@@ -39,12 +69,27 @@ QDateTime ClientGameState::getLastTick() const
 	return lastTick;
 }
 
+qint64 ClientGameState::getTickAge() const
+{
+	return received.isValid() ? received.nsecsElapsed() : -1;
+}
+
+qint64 ClientGameState::getTickDelay() const
+{
+	return tickDelay;
+}
+
+qint64 ClientGameState::getRoundTrip() const
+{
+	return roundTrip;
+}
+
 ClientSquareState ClientGameState::getState(pos_t x, pos_t y) const
 {
 	pos_t rx = x + (CLIENT_FRAME / 2);
 	pos_t ry = y + (CLIENT_FRAME / 2);
 	if (0 <= rx && rx < CLIENT_FRAME && 0 <= ry && ry < CLIENT_FRAME)
-		return ClientSquareState(*this, rx, ry, board[ry][rx]);
+		return ClientSquareState(*this, rx, ry, square(rx, ry));
 
 	return ClientSquareState(*this, OUT_OF_BOUNDS, OUT_OF_BOUNDS, OUT_OF_BOUNDS_STATE);
 }
@@ -56,9 +101,7 @@ const ClientPlayer *ClientGameState::lookupPlayer(plid_t id) const
 
 ClientPlayer *ClientGameState::lookupPlayer(plid_t id)
 {
-	if (!players.contains(id))
-		return NULL;
-	return players.value(id);
+	return index[id];
 }
 
 QList<const ClientPlayer *> ClientGameState::getPlayers() const
@@ -110,3 +153,297 @@ void ClientGameState::unlock()
 {
 	lock.unlock();
 }
+
+void ClientGameState::copyFrom(const ClientGameState &other)
+{
+	tick = other.tick;
+	tickRate = other.tickRate;
+	lastTick = other.lastTick;
+	received = other.received;
+	tickDelay = other.tickDelay;
+	roundTrip = other.roundTrip;
+	std::copy(other.leaderboard, other.leaderboard + 5, leaderboard);
+	std::copy(other.board[0], other.board[0] + CLIENT_FRAME * CLIENT_FRAME, board[0]);
+	originX = other.originX;
+	originY = other.originY;
+	totalSquares = other.totalSquares;
+	client = other.client;
+	kiosk = other.kiosk;
+
+	// Players rarely come or go, so most ticks only copy their positions.
+	for (auto iter = players.begin(); iter != players.end(); )
+	{
+		const ClientPlayer *pl = other.index[iter.key()];
+		if (!pl || !iter.value() || pl->getName() != iter.value()->getName())
+			iter = removePlayer(iter);
+		else
+			++iter;
+	}
+
+	foreach (const ClientPlayer *pl, other.players)
+	{
+		if (!pl)
+			continue;
+		if (!index[pl->getId()])
+			addPlayer(pl->getId(), pl->getName());
+
+		ClientPlayer *mine = index[pl->getId()];
+		mine->setX(pl->getX());
+		mine->setY(pl->getY());
+		mine->setScore(pl->getScore());
+	}
+}
+
+void ClientGameState::setBoard(const state_t *const *rows)
+{
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		std::copy(rows[i], rows[i] + CLIENT_FRAME, board[i]);
+	originX = 0;
+	originY = 0;
+}
+
+void ClientGameState::applyTick(Direction d, const state_t *news, const state_t *const *diff)
+{
+	// Moving the origin shifts every square at once. The square which
+	// wraps around ends up on the new edge, which news overwrites below.
+	switch (d)
+	{
+	case UP:
+		originY = originY ? originY - 1 : CLIENT_FRAME - 1;
+		break;
+	case DOWN:
+		originY = originY < CLIENT_FRAME - 1 ? originY + 1 : 0;
+		break;
+	case LEFT:
+		originX = originX ? originX - 1 : CLIENT_FRAME - 1;
+		break;
+	case RIGHT:
+		originX = originX < CLIENT_FRAME - 1 ? originX + 1 : 0;
+		break;
+	case NONE:
+		break;
+	}
+
+	// Each row of the view is stored in two pieces: the columns from
+	// originX to the end of the row, then the ones before it.
+	const int head = CLIENT_FRAME - originX;
+	for (int i = 0; i < CLIENT_FRAME; i++)
+	{
+		state_t *row = board[(i + originY) % CLIENT_FRAME];
+		xorStates(row + originX, diff[i], head);
+		xorStates(row, diff[i] + head, originX);
+	}
+
+	// The diff doesn't cover the new edge.
+	switch (d)
+	{
+	case UP:
+		std::copy(news, news + head, board[originY] + originX);
+		std::copy(news + head, news + CLIENT_FRAME, board[originY]);
+		break;
+	case DOWN:
+	{
+		state_t *row = board[(originY + CLIENT_FRAME - 1) % CLIENT_FRAME];
+		std::copy(news, news + head, row + originX);
+		std::copy(news + head, news + CLIENT_FRAME, row);
+		break;
+	}
+	case LEFT:
+		for (int i = 0; i < CLIENT_FRAME; i++)
+			board[(i + originY) % CLIENT_FRAME][originX] = news[i];
+		break;
+	case RIGHT:
+	{
+		int col = (originX + CLIENT_FRAME - 1) % CLIENT_FRAME;
+		for (int i = 0; i < CLIENT_FRAME; i++)
+			board[(i + originY) % CLIENT_FRAME][col] = news[i];
+		break;
+	}
+	case NONE:
+		break;
+	}
+
+	trackPlayers(d, news, diff);
+}
+
+void ClientGameState::markGood()
+{
+	GoodView &g = good[tick % GOOD_VIEWS];
+	std::copy(board[0], board[0] + CLIENT_FRAME * CLIENT_FRAME, g.board[0]);
+	g.originX = originX;
+	g.originY = originY;
+	g.tick = tick;
+	g.valid = true;
+	goodTick = tick;
+}
+
+bool ClientGameState::hasGood(tick_t t) const
+{
+	const GoodView &g = good[t % GOOD_VIEWS];
+	return g.valid && g.tick == t;
+}
+
+void ClientGameState::forgetGood()
+{
+	for (GoodView &g : good)
+		g.valid = false;
+	goodTick = 0;
+}
+
+bool ClientGameState::catchUp(tick_t from, int dx, int dy, const state_t *const *diff)
+{
+	if (!hasGood(from))
+		return false;
+
+	const GoodView &g = good[from % GOOD_VIEWS];
+	for (int ry = 0; ry < CLIENT_FRAME; ry++)
+	{
+		for (int rx = 0; rx < CLIENT_FRAME; rx++)
+		{
+			int ox = rx + dx;
+			int oy = ry + dy;
+			state_t before = 0;
+			if (0 <= ox && ox < CLIENT_FRAME && 0 <= oy && oy < CLIENT_FRAME)
+				before = g.board[(oy + g.originY) % CLIENT_FRAME][(ox + g.originX) % CLIENT_FRAME];
+			board[ry][rx] = before ^ diff[ry][rx];
+		}
+	}
+	originX = 0;
+	originY = 0;
+
+	updatePlayerPositions();
+	return true;
+}
+
+QByteArray ClientGameState::hashView(BoardHash algorithm) const
+{
+	const state_t *rows[CLIENT_FRAME];
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		rows[i] = board[(i + originY) % CLIENT_FRAME];
+	return hashBoard(rows, originX, algorithm);
+}
+
+void ClientGameState::hashRows(quint32 *hashes) const
+{
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		hashes[i] = hashRow(board[(i + originY) % CLIENT_FRAME], originX);
+}
+
+void ClientGameState::setRow(int ry, const state_t *row)
+{
+	state_t *dst = board[(ry + originY) % CLIENT_FRAME];
+	for (int rx = 0; rx < CLIENT_FRAME; rx++)
+		dst[(rx + originX) % CLIENT_FRAME] = row[rx];
+}
+
+void ClientGameState::addPlayer(plid_t id, const QString &name)
+{
+	ClientPlayer *pl = new ClientPlayer(*this, id, name, OUT_OF_VIEW, OUT_OF_VIEW);
+	players.insert(id, pl);
+	index[id] = pl;
+}
+
+QHash<plid_t, ClientPlayer *>::iterator ClientGameState::removePlayer(QHash<plid_t, ClientPlayer *>::iterator i)
+{
+	index[i.key()] = NULL;
+	delete i.value();
+	return players.erase(i);
+}
+
+void ClientGameState::updatePlayerPositions()
+{
+	foreach (ClientPlayer *pl, players)
+	{
+		if (!pl)
+			continue;
+		pl->setX(OUT_OF_VIEW);
+		pl->setY(OUT_OF_VIEW);
+	}
+
+	for (int ry = 0; ry < CLIENT_FRAME; ry++)
+		for (int rx = 0; rx < CLIENT_FRAME; rx++)
+			trackSquare(rx, ry, square(rx, ry), 0);
+}
+
+void ClientGameState::trackPlayers(Direction d, const state_t *news, const state_t *const *diff)
+{
+	// When we move, everyone else appears to move the other way.
+	if (d != NONE)
+	{
+		foreach (ClientPlayer *pl, players)
+		{
+			if (!pl || !pl->isVisible())
+				continue;
+
+			pos_t x = pl->getX() - getXOff(d);
+			pos_t y = pl->getY() - getYOff(d);
+			if (abs(x) > CLIENT_FRAME / 2 || abs(y) > CLIENT_FRAME / 2)
+				x = y = OUT_OF_VIEW;
+			pl->setX(x);
+			pl->setY(y);
+		}
+	}
+
+	const state_t OCCUPANT = 0x00FF0000;
+	for (int ry = 0; ry < CLIENT_FRAME; ry++)
+	{
+		const state_t *row = diff[ry];
+		for (int rx = 0; rx < CLIENT_FRAME; rx++)
+		{
+			if (row[rx] & OCCUPANT)
+			{
+				state_t now = square(rx, ry);
+				trackSquare(rx, ry, now, now ^ row[rx]);
+			}
+		}
+	}
+
+	// Nobody was tracked on the new edge, so only new arrivals matter.
+	for (int i = 0; i < CLIENT_FRAME; i++)
+	{
+		if (!(news[i] & OCCUPANT))
+			continue;
+
+		switch (d)
+		{
+		case UP:
+			trackSquare(i, 0, news[i], 0);
+			break;
+		case DOWN:
+			trackSquare(i, CLIENT_FRAME - 1, news[i], 0);
+			break;
+		case LEFT:
+			trackSquare(0, i, news[i], 0);
+			break;
+		case RIGHT:
+			trackSquare(CLIENT_FRAME - 1, i, news[i], 0);
+			break;
+		case NONE:
+			break;
+		}
+	}
+}
+
+void ClientGameState::trackSquare(int rx, int ry, state_t now, state_t before)
+{
+	pos_t x = rx - CLIENT_FRAME / 2;
+	pos_t y = ry - CLIENT_FRAME / 2;
+	plid_t was = static_cast<plid_t>((before & 0xFF0000) >> 16);
+	plid_t is = static_cast<plid_t>((now & 0xFF0000) >> 16);
+
+	// A player who left this square may already have been found on their
+	// new square, in which case they stay there.
+	ClientPlayer *pl = index[was];
+	if (was != is && pl && pl->getX() == x && pl->getY() == y)
+	{
+		pl->setX(OUT_OF_VIEW);
+		pl->setY(OUT_OF_VIEW);
+	}
+
+	pl = index[is];
+	if (pl)
+	{
+		pl->setX(x);
+		pl->setY(y);
+	}
+}
@@ -6,16 +6,21 @@
 #define CLIENTGAMESTATE_H
 
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QMutex>
 
 #include "protocol.h"
 
-class Arduino;
+class BoardLayer;
 class Client;
+class ClientBoardView;
 class ClientGameState;
 class ClientSquareState;
 class GameWidget;
 class IOHandler;
+class KioskAI;
+class SwarmBot;
+class ViewBuffer;
 
 class ClientPlayer
 {
@@ -126,15 +131,34 @@ private:
 
 class ClientGameState
 {
-friend class Arduino;
+friend class BoardLayer;
 friend class Client;
-friend class GameWidget;
+friend class ClientBoardView;
 friend class IOHandler;
+friend class KioskAI;
+friend class SwarmBot;
+friend class ViewBuffer;
 public:
 	tick_t getTick() const;
 	quint16 getTickRate() const;
 	QDateTime getLastTick() const;
 
+	/*
+	 * Nanoseconds since the current tick arrived, or -1 before the first
+	 * one. Unlike getLastTick() this is monotonic.
+	 */
+	qint64 getTickAge() const;
+
+	/*
+	 * How much later than usual the current tick took to get here from the
+	 * server, in nanoseconds. This is 0 unless the server timestamps its
+	 * ticks.
+	 */
+	qint64 getTickDelay() const;
+
+	/* The round trip time to the server in nanoseconds, or -1 if unknown. */
+	qint64 getRoundTrip() const;
+
 	/*
 	 * WARNING: If the coordinates passed to getState() are out of bounds, getState()
 	 * will return an out of bounds SquareState which means the values it will report
@@ -164,21 +188,118 @@ private:
 	QMutex lock;
 
 	QHash<plid_t, ClientPlayer *> players;
+	// The same players indexed by id, so that lookups are a single load.
+	ClientPlayer *index[256];
 	tick_t tick;
 	quint16 tickRate;
 	QDateTime lastTick;
+	QElapsedTimer received;
+	qint64 tickDelay;
+	qint64 roundTrip;
 
 	std::pair<plid_t, score_t> leaderboard[5];
 
+	/*
+	 * The view is stored as a ring so that moving only has to write the
+	 * new edge. The top left square of the view is at
+	 * board[originY][originX], and the view wraps around both axes from
+	 * there.
+	 */
 	state_t board[CLIENT_FRAME][CLIENT_FRAME];
+	int originX;
+	int originY;
 	quint16 totalSquares;
 
+	/*
+	 * The views as of the last few ticks whose checksums matched, in slots
+	 * by tick, which the server can catch us up from. Ticks over UDP are
+	 * sent from whichever one the server last heard about, so we keep a
+	 * few. goodTick is the newest.
+	 */
+	static const int GOOD_VIEWS = 8;
+	struct GoodView
+	{
+		state_t board[CLIENT_FRAME][CLIENT_FRAME];
+		int originX;
+		int originY;
+		tick_t tick;
+		bool valid;
+	};
+	GoodView good[GOOD_VIEWS];
+	tick_t goodTick;
+
 	plid_t client;
 	int kiosk;
 
 	ClientPlayer *getClient();
 	ClientPlayer *lookupPlayer(plid_t id);
 
+	/*
+	 * The square at the given position in the view, where (0, 0) is the top
+	 * left. Both coordinates must be in [0, CLIENT_FRAME).
+	 */
+	const state_t &square(int rx, int ry) const
+	{
+		int px = rx + originX;
+		int py = ry + originY;
+		return board[py < CLIENT_FRAME ? py : py - CLIENT_FRAME][px < CLIENT_FRAME ? px : px - CLIENT_FRAME];
+	}
+
+	/* Replaces the whole view with the given rows. */
+	void setBoard(const state_t *const *rows);
+
+	/*
+	 * Moves the view one square in the given direction, XORs in the diff
+	 * and fills the new edge from news. The diff is in the coordinates of
+	 * the moved view.
+	 */
+	void applyTick(Direction d, const state_t *news, const state_t *const *diff);
+
+	/* Remembers the current view as the last good one. */
+	void markGood();
+	bool hasGood(tick_t t) const;
+	/* Forgets every good view, as when joining a new game. */
+	void forgetGood();
+
+	/*
+	 * Goes back to the good view from tick from, moves it by (dx, dy) with
+	 * the new squares set to 0, and XORs in the diff, as for
+	 * PACKET_CATCHUP. Returns false if we don't have that view.
+	 */
+	bool catchUp(tick_t from, int dx, int dy, const state_t *const *diff);
+
+	/* Computes the same hash as hashBoard() would over the unwrapped view. */
+	QByteArray hashView(BoardHash algorithm = HASH_MD4) const;
+	/* Fills hashes with the hashRow() of each row of the view. */
+	void hashRows(quint32 *hashes) const;
+
+	/* Replaces row ry of the view, where 0 is the top. */
+	void setRow(int ry, const state_t *row);
+
+	/*
+	 * Adds and removes players. New players start out of view until
+	 * updatePlayerPositions() or a tick finds them.
+	 */
+	void addPlayer(plid_t id, const QString &name);
+	QHash<plid_t, ClientPlayer *>::iterator removePlayer(QHash<plid_t, ClientPlayer *>::iterator i);
+
+	/* Finds every player in the view from scratch. */
+	void updatePlayerPositions();
+
+	/*
+	 * Keeps the player positions up to date through a tick: everyone moves
+	 * with the view, then players follow the squares whose occupant
+	 * changed. Called by applyTick().
+	 */
+	void trackPlayers(Direction d, const state_t *news, const state_t *const *diff);
+	void trackSquare(int rx, int ry, state_t now, state_t before);
+
+	/*
+	 * Makes this state a copy of other, keeping the ClientPlayers of anyone
+	 * who is still around. Used to hand the state to the renderers.
+	 */
+	void copyFrom(const ClientGameState &other);
+
 	void lockState();
 	void unlock();
 
@@ -44,6 +44,11 @@ void ClientPlayer::setY(pos_t newY)
 	y = newY;
 }
 
+bool ClientPlayer::isVisible() const
+{
+	return x != OUT_OF_VIEW && y != OUT_OF_VIEW;
+}
+
 ClientSquareState ClientPlayer::getState() const
 {
 	return gs.getState(x, y);
@@ -0,0 +1,68 @@
+/*
+ * Implements FrameHistogram
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "framehistogram.h"
+
+FrameHistogram::FrameHistogram()
+{
+	clear();
+}
+
+void FrameHistogram::record(qint64 usecs)
+{
+	if (usecs < 0)
+		usecs = 0;
+
+	++counts[std::min<qint64>(usecs / BUCKET_USECS, BUCKETS - 1)];
+	++count;
+	sum += usecs;
+	max = std::max(max, usecs);
+}
+
+void FrameHistogram::clear()
+{
+	std::fill(counts, counts + BUCKETS, 0);
+	count = 0;
+	sum = 0;
+	max = 0;
+}
+
+quint32 FrameHistogram::getBucket(int i) const
+{
+	return counts[i];
+}
+
+quint64 FrameHistogram::getCount() const
+{
+	return count;
+}
+
+qint64 FrameHistogram::getMax() const
+{
+	return max;
+}
+
+qint64 FrameHistogram::getMean() const
+{
+	return count ? sum / static_cast<qint64>(count) : 0;
+}
+
+qint64 FrameHistogram::getQuantile(double q) const
+{
+	if (!count)
+		return 0;
+
+	quint64 target = std::max<quint64>(1, std::ceil(q * count));
+	quint64 seen = 0;
+	for (int i = 0; i < BUCKETS - 1; ++i)
+	{
+		seen += counts[i];
+		if (seen >= target)
+			return (i + 1) * BUCKET_USECS;
+	}
+	return max;
+}
@@ -0,0 +1,42 @@
+/*
+ * A histogram of the client's frame times and tick jitter, for the
+ * statistics overlay.
+ */
+
+#ifndef FRAMEHISTOGRAM_H
+#define FRAMEHISTOGRAM_H
+
+#include <QtGlobal>
+
+/*
+ * A histogram of durations in microseconds with half millisecond buckets.
+ * Anything past the last bucket is counted in it. Quantiles are reported
+ * as the upper bound of the bucket they fall in. Unlike the swarm's
+ * LatencyHistogram this is only used from one thread, and the buckets
+ * are narrow enough to tell a 60 Hz frame from a 50 Hz one.
+ */
+class FrameHistogram
+{
+public:
+	static const int BUCKETS = 100;
+	static const qint64 BUCKET_USECS = 500;
+
+	FrameHistogram();
+
+	void record(qint64 usecs);
+	void clear();
+
+	quint32 getBucket(int i) const;
+	quint64 getCount() const;
+	qint64 getMax() const;
+	qint64 getMean() const;
+	qint64 getQuantile(double q) const;
+
+private:
+	quint32 counts[BUCKETS];
+	quint64 count;
+	qint64 sum;
+	qint64 max;
+};
+
+#endif // !FRAMEHISTOGRAM_H
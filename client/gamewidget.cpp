@@ -14,13 +14,40 @@ const int KSTR[] = { Qt::Key_E, Qt::Key_T, Qt::Key_A, Qt::Key_O,
                      Qt::Key_R, Qt::Key_D, Qt::Key_L, Qt::Key_U };
 const int KSTRLEN = 12;
 
-GameWidget::GameWidget(ClientGameState &gs, QWidget *parent)
+GameWidget::GameWidget(ViewBuffer &vb, QWidget *parent)
 	: QOpenGLWidget(parent)
-	, cgs(gs)
+	, views(vb)
+	, layer()
+	, hud()
+	, running(false)
+	, overlay(false)
+	, timer()
+	, clock()
+	, lastFrame(-1)
+	, frameTimes()
+	, tickJitter()
 	, ks(0)
 {
 	setFocusPolicy(Qt::StrongFocus);
 	setAttribute(Qt::WA_MacShowFocusRect, 0);
+
+	timer.start();
+	connect(this, &QOpenGLWidget::frameSwapped, this, &GameWidget::scheduleFrame);
+}
+
+void GameWidget::start()
+{
+	running = true;
+	clock.reset();
+	lastFrame = -1;
+	frameTimes.clear();
+	tickJitter.clear();
+	update();
+}
+
+void GameWidget::stop()
+{
+	running = false;
 }
 
 void GameWidget::animate()
@@ -28,14 +55,48 @@ void GameWidget::animate()
 	update();
 }
 
+void GameWidget::scheduleFrame()
+{
+	if (!running)
+		return;
+
+	// Keep drawing while the view is still moving towards the latest tick
+	// or a newer one is waiting. Otherwise there's nothing new to show
+	// until the IOHandler's next tick calls animate().
+	if (clock.progress(timer.nsecsElapsed()) < 1 || views.latest().getTick() != clock.getTick())
+	{
+		update();
+	} else {
+		lastFrame = -1;
+	}
+}
+
 void GameWidget::paintEvent(QPaintEvent *event)
 {
 	QPainter painter;
 	painter.begin(this);
 	painter.setRenderHint(QPainter::Antialiasing);
-	cgs.lockState();
-	renderGame(cgs, &painter, event);
-	cgs.unlock();
+
+	const ClientGameState &cgs = views.latest();
+	qint64 now = timer.nsecsElapsed();
+	if (running && lastFrame >= 0)
+		frameTimes.record((now - lastFrame) / 1000);
+	lastFrame = now;
+
+	qint64 age = cgs.getTickAge();
+	if (age >= 0 && cgs.getTick() != clock.getTick())
+	{
+		bool predicted = clock.getTick() != 0;
+		// Ticks which were held up on the way are placed where they
+		// would have arrived on time.
+		qint64 late = clock.observe(cgs.getTick(), now - age - cgs.getTickDelay(), cgs.getTickRate());
+		if (predicted)
+			tickJitter.record(qAbs(late) / 1000);
+	}
+
+	renderGame(cgs, layer, hud, clock.progress(now), &painter, event);
+	if (overlay)
+		renderOverlay(cgs, frameTimes, tickJitter, clock, &painter, event->rect());
 	painter.end();
 }
 
@@ -54,11 +115,13 @@ void GameWidget::keyPressEvent(QKeyEvent *event)
 		ks = 0;
 	}
 
-	cgs.lockState();
-	int kiosk = cgs.kioskMode();
-	cgs.unlock();
+	if (event->key() == Qt::Key_F3)
+	{
+		overlay = !overlay;
+		update();
+	}
 
-	if (!kiosk)
+	if (!views.latest().kioskMode())
 	{
 		if (event->key() == Qt::Key_Up)
 			emit changeDirection(UP);
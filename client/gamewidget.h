@@ -1,21 +1,30 @@
 /*
  * This widget is responsible for drawing the game, although
  * it is basically jsuta  front end for render.h
+ *
+ * While a game is running it repaints once per frame of the display, in
+ * step with the swaps of its buffers, and goes idle once the view has
+ * caught up with the latest tick until the next one arrives. F3 shows
+ * the frame time and tick jitter statistics.
  */
 
 #ifndef GAMEWIDGET_H
 #define GAMEWIDGET_H
 
+#include <QElapsedTimer>
 #include <QOpenGLWidget>
 
-#include "clientgamestate.h"
+#include "framehistogram.h"
+#include "render.h"
+#include "tickclock.h"
+#include "viewbuffer.h"
 
 class GameWidget : public QOpenGLWidget
 {
 	Q_OBJECT
 
 public:
-	GameWidget(ClientGameState &cgs, QWidget *parent = Q_NULLPTR);
+	GameWidget(ViewBuffer &views, QWidget *parent = Q_NULLPTR);
 	bool isKiosk();
 
 signals:
@@ -23,14 +32,36 @@ signals:
 	void changeKiosk();
 
 public slots:
+	/* Starts and stops drawing frames continuously. */
+	void start();
+	void stop();
+
+	/* Draws a frame if one isn't on its way already. */
 	void animate();
 
 protected:
 	void paintEvent(QPaintEvent *event) override;
 	void keyPressEvent(QKeyEvent *event) override;
 
+private slots:
+	void scheduleFrame();
+
 private:
-	ClientGameState &cgs;
+	ViewBuffer &views;
+	BoardLayer layer;
+	HudLayer hud;
+
+	bool running;
+	bool overlay;
+
+	// All times are in nanoseconds on this timer.
+	QElapsedTimer timer;
+	TickClock clock;
+	// When the last frame was drawn, or -1 if the one before it wasn't
+	// drawn straight after it.
+	qint64 lastFrame;
+	FrameHistogram frameTimes;
+	FrameHistogram tickJitter;
 
 	int ks;
 };
@@ -3,27 +3,62 @@
  * is where the nitty gritty network details live.
  */
 
+#include <algorithm>
+#include <limits>
+
 #include "iohandler.h"
 #include "protocol.h"
+#include "tickcoder.h"
 
 // We initialize the socket here with this object as its parent.
 // That way, when moved to our own thread, the socket will be moved
 // with us. The QDataStream is not a QObject, so as long as we're
 // careful about which thread we use it from, we should be fine.
-IOHandler::IOHandler(ClientGameState &cg, QObject *parent)
+IOHandler::IOHandler(ClientGameState &cg, ViewBuffer *vb, QObject *parent)
 	: QObject(parent)
 	, socket(new QTcpSocket(this))
 	, keepAlive(new QTimer(this))
+	, helloTimeout(new QTimer(this))
 	, name(QLatin1String(""))
 	, cgs(cg)
+	, views(vb)
 	, ka()
+	, monotonic()
+	, sync()
+	, nextDelay(0)
+	, stats{0, 0, 0, 0}
+	, unread(0)
+	, repairing(false)
+	, udpWanted(false)
+	, udp(new UdpLink(this))
+	, udpToken(0)
+	, udpActive(false)
+	, capsKnown(false)
+	, capsServer(false)
+	, serverCaps(0)
+	, wantedCaps(CAPABILITIES)
+	, joinWanted(false)
+	, caps(0)
+	, spectate(false)
+	, spectateTarget(NULL_ID)
+	, playersTick(0)
 {
+	monotonic.start();
+	std::fill(delays, delays + DELAY_WINDOW, std::numeric_limits<qint64>::max());
+
 	str.setDevice(socket);
 	str.setVersion(QDataStream::Qt_5_0);
 
 	keepAlive->setInterval(5000);
 	connect(keepAlive, &QTimer::timeout, this, &IOHandler::kaTimeout);
 
+	helloTimeout->setInterval(3000);
+	helloTimeout->setSingleShot(true);
+	connect(helloTimeout, &QTimer::timeout, this, [this] {
+		if (!capsKnown)
+			learnCapabilities(false, 0);
+	});
+
 	typedef void (QAbstractSocket::*QAbstractSocketErrorSignal)(QAbstractSocket::SocketError);
 	connect(socket, static_cast<QAbstractSocketErrorSignal>(&QAbstractSocket::error),
 	        this, &IOHandler::ierror);
@@ -32,9 +67,18 @@ IOHandler::IOHandler(ClientGameState &cg, QObject *parent)
 	connect(socket, &QAbstractSocket::connected, this, [this] {
 		this->lastka = QDateTime::currentDateTime();
 	});
+	// Servers from before capabilities skip the empty hello, but would
+	// misread any other packet they don't know, so nothing else new is
+	// sent until the server has answered it; see learnCapabilities().
+	connect(socket, &QAbstractSocket::connected, this, [this] {
+		Packet::writePacket(str, PacketHello());
+	});
+	connect(socket, &QAbstractSocket::connected, helloTimeout, static_cast<void (QTimer::*)()>(&QTimer::start));
 	connect(socket, &QAbstractSocket::disconnected, this, &IOHandler::disconnected);
 	connect(socket, &QAbstractSocket::disconnected, keepAlive, &QTimer::stop);
+	connect(socket, &QAbstractSocket::disconnected, helloTimeout, &QTimer::stop);
 	connect(socket, &QIODevice::readyRead, this, &IOHandler::newData);
+	connect(udp, &UdpLink::readyRead, this, &IOHandler::udpData);
 }
 
 void IOHandler::connectToServer(const QString &host, quint16 port, const QString &nm)
@@ -42,14 +86,50 @@ void IOHandler::connectToServer(const QString &host, quint16 port, const QString
 	// The abort call is kind of overkill, but it's better to be safe than sorry
 	socket->abort();
 	socket->connectToHost(host, port);
+	unread = 0;
+
+	sync.reset();
+	std::fill(delays, delays + DELAY_WINDOW, std::numeric_limits<qint64>::max());
+
+	udp->setPeer(QHostAddress(), 0);
+	udpToken = 0;
+	udpActive = false;
+
+	capsKnown = false;
+	capsServer = false;
+	serverCaps = 0;
+	joinWanted = false;
+	caps = 0;
 
 	name = nm;
 }
 
+IOStatistics IOHandler::getStatistics() const
+{
+	return stats;
+}
+
+void IOHandler::setUdp(bool enabled)
+{
+	udpWanted = enabled;
+}
+
+void IOHandler::setCapabilities(quint32 cp)
+{
+	wantedCaps = cp & CAPABILITIES;
+}
+
+void IOHandler::setSpectate(bool enabled, plid_t target)
+{
+	spectate = enabled;
+	spectateTarget = target;
+}
+
 void IOHandler::abort()
 {
 	socket->abort();
 	keepAlive->stop();
+	helloTimeout->stop();
 }
 
 void IOHandler::disconnect()
@@ -64,19 +144,76 @@ void IOHandler::ierror(QAbstractSocket::SocketError err)
 
 void IOHandler::enterQueue()
 {
-	Packet::writePacket(str, PacketRequestJoin(name));
+	// Which join to send depends on whether the server knows capabilities,
+	// so wait until we know.
+	if (!capsKnown)
+	{
+		joinWanted = true;
+		return;
+	}
+	joinWanted = false;
+
+	if (spectate)
+	{
+		if (capsServer && (serverCaps & CAP_SPECTATE))
+			Packet::writePacket(str, PacketRequestSpectate(spectateTarget, serverCaps & wantedCaps, TickCoder::VERSION));
+		else
+			qWarning() << "The server doesn't take spectators.";
+		return;
+	}
+
+	if (capsServer)
+		Packet::writePacket(str, PacketRequestJoinCaps(name, serverCaps & wantedCaps, TickCoder::VERSION));
+	else
+		Packet::writePacket(str, PacketRequestJoin(name));
 }
 
 void IOHandler::changeDirection(Direction dir)
 {
+	if (spectate)
+		return;
+
 	Packet::writePacket(str, PacketUpdateDir(dir));
 }
 
 void IOHandler::requestResend()
 {
+	stats.resendRequests++;
 	Packet::writePacket(str, PacketRequestResend());
 }
 
+void IOHandler::requestTimeSync()
+{
+	// Older servers would misread it.
+	if (!capsServer)
+		return;
+
+	Packet::writePacket(str, PacketTimeSync(monotonic.nsecsElapsed()));
+}
+
+void IOHandler::requestCatchup()
+{
+	// The ticks which arrive in the meantime will fail too, but the catch
+	// up will take care of them.
+	if (repairing)
+		return;
+
+	repairing = true;
+	stats.resendRequests++;
+	Packet::writePacket(str, PacketRequestCatchup(cgs.goodTick));
+}
+
+void IOHandler::requestRows()
+{
+	// Send the hashes of our rows so the server can work out which ones
+	// are wrong without us waiting for its hashes first.
+	repairing = true;
+	stats.resendRequests++;
+	quint32 hashes[CLIENT_FRAME];
+	cgs.hashRows(hashes);
+	Packet::writePacket(str, PacketRequestRows(cgs.getTick(), hashes));
+}
+
 void IOHandler::kaTimeout()
 {
 	if (lastka.secsTo(QDateTime::currentDateTime()) > TIMEOUT_LEN)
@@ -86,33 +223,13 @@ void IOHandler::kaTimeout()
 		return;
 	}
 	Packet::writePacket(str, PacketKeepAlive());
+	requestTimeSync();
+	// Our hello may have been lost.
+	if (udp->hasPeer() && !udpActive)
+		udp->send(PacketUdpHello(udpToken));
 	qDebug() << "Sent keep alive!";
 }
 
-void IOHandler::updatePlayerPositions()
-{
-	foreach (ClientPlayer *pl, cgs.players)
-	{
-		if (!pl)
-			continue;
-		pl->setX(OUT_OF_VIEW);
-		pl->setY(OUT_OF_VIEW);
-	}
-
-	for (pos_t y = -(CLIENT_FRAME / 2); y < CLIENT_FRAME / 2; y++)
-	{
-		for (pos_t x = -(CLIENT_FRAME / 2); x < CLIENT_FRAME / 2; x++)
-		{
-			ClientPlayer *cp = cgs.lookupPlayer(cgs.getState(x,y).getOccupyingPlayerId());
-			if (!cp)
-				continue;
-
-			cp->setX(x);
-			cp->setY(y);
-		}
-	}
-}
-
 void IOHandler::processPlayersUpdate(const PacketPlayersUpdate &ppu, bool nested)
 {
 	if (!nested)
@@ -122,6 +239,7 @@ void IOHandler::processPlayersUpdate(const PacketPlayersUpdate &ppu, bool nested
 		qWarning() << "PPU Packet is on tick" << ppu.getTick() << ", but we're on tick" << cgs.getTick() << "!";
 
 	QHash<plid_t, QString> players = ppu.getPlayers();
+	playersTick = ppu.getTick();
 
 	qDebug() << "Players:";
 	for (auto iter = players.cbegin(); iter != players.cend(); ++iter)
@@ -131,8 +249,7 @@ void IOHandler::processPlayersUpdate(const PacketPlayersUpdate &ppu, bool nested
 	{
 		if (!players.contains(iter.key()) || (iter.value() && iter.value()->getName() != players.value(iter.key())))
 		{
-			delete iter.value();
-			iter = cgs.players.erase(iter);
+			iter = cgs.removePlayer(iter);
 		} else {
 			players.remove(iter.key());
 			iter++;
@@ -140,15 +257,62 @@ void IOHandler::processPlayersUpdate(const PacketPlayersUpdate &ppu, bool nested
 	}
 
 	for (auto iter = players.cbegin(); iter != players.cend(); iter++)
-		cgs.players.insert(iter.key(), new ClientPlayer(cgs, iter.key(), iter.value(), OUT_OF_VIEW, OUT_OF_VIEW));
+		cgs.addPlayer(iter.key(), iter.value());
 
 	if (!nested)
 	{
-		updatePlayerPositions();
+		cgs.updatePlayerPositions();
+		publish();
 		cgs.unlock();
 	}
 }
 
+void IOHandler::processPlayersDelta(const PacketPlayersDelta &ppd)
+{
+	cgs.lockState();
+
+	if (cgs.getTick() != ppd.getTick())
+		qWarning() << "PPD Packet is on tick" << ppd.getTick() << ", but we're on tick" << cgs.getTick() << "!";
+
+	// The players in our game join may already have these changes, so
+	// they can only be missing something after that.
+	bool covered = ppd.getTick() <= playersTick;
+	bool fits = true;
+
+	foreach (plid_t pid, ppd.getLeft())
+	{
+		auto iter = cgs.players.find(pid);
+		if (iter == cgs.players.end())
+			fits = false;
+		else
+			cgs.removePlayer(iter);
+	}
+
+	const QHash<plid_t, QString> &joined = ppd.getJoined();
+	for (auto iter = joined.cbegin(); iter != joined.cend(); ++iter)
+	{
+		auto old = cgs.players.find(iter.key());
+		if (old != cgs.players.end())
+		{
+			if (old.value() && old.value()->getName() == iter.value())
+				continue;
+			fits = false;
+			cgs.removePlayer(old);
+		}
+		cgs.addPlayer(iter.key(), iter.value());
+	}
+
+	if (!fits && !covered)
+	{
+		qWarning() << "PPD: Players changed on tick" << ppd.getTick() << "don't match ours. Requesting them all.";
+		Packet::writePacket(str, PacketRequestPlayers());
+	}
+
+	cgs.updatePlayerPositions();
+	publish();
+	cgs.unlock();
+}
+
 void IOHandler::processLeaderboardUpdate(const PacketLeaderboardUpdate &plu, bool nested)
 {
 	if (!nested)
@@ -176,7 +340,10 @@ void IOHandler::processLeaderboardUpdate(const PacketLeaderboardUpdate &plu, boo
 	}
 
 	if (!nested)
+	{
+		publish();
 		cgs.unlock();
+	}
 }
 
 void IOHandler::processFullBoard(const PacketResendBoard &prb, bool nested)
@@ -184,29 +351,37 @@ void IOHandler::processFullBoard(const PacketResendBoard &prb, bool nested)
 	if (!nested)
 		cgs.lockState();
 
-	if (cgs.getTick() != prb.getTick())
-		qWarning() << "PRB Packet is on tick" << prb.getTick() << ", but we're on tick" << cgs.getTick() << "!";
-
-	const state_t *const *board = prb.getBoard();
-	state_t *ptrs[CLIENT_FRAME];
-	for (int i = 0; i < CLIENT_FRAME; i++)
+	// When ticks come over UDP, a board sent over TCP can be ahead of
+	// them, or behind them. One which is behind would take our view back
+	// to an older tick than we'd then be marking good, so it is dropped;
+	// the next delta tick replaces a bad view anyway.
+	if (cgs.getTick() > prb.getTick())
 	{
-		std::copy(board[i], board[i] + CLIENT_FRAME, cgs.board[i]);
-		ptrs[i] = cgs.board[i];
+		qWarning() << "PRB Packet is on tick" << prb.getTick() << ", but we're on tick" << cgs.getTick() << "! Dropping it.";
+		if (!nested)
+			cgs.unlock();
+		return;
 	}
 
-	QByteArray chksum = hashBoard(ptrs);
+	cgs.tick = prb.getTick();
+	cgs.setBoard(prb.getBoard());
+
+	QByteArray chksum = cgs.hashView(boardHash());
 	if (chksum != prb.getChecksum())
 	{
-		qWarning() << "PRB Checksum:" << prb.getChecksum() << "disagrees with computed:" << chksum << "! Requesting resend...";
-		requestResend();
+		qWarning() << "PRB Checksum:" << prb.getChecksum() << "disagrees with computed:" << chksum << "! Requesting rows...";
+		stats.checksumFailures++;
+		requestRows();
 	} else {
 		qDebug() << "PRB Processed Successfully.";
+		cgs.markGood();
+		repairing = false;
 	}
 
 	if (!nested)
 	{
-		updatePlayerPositions();
+		cgs.updatePlayerPositions();
+		publish();
 		cgs.unlock();
 	}
 }
@@ -223,23 +398,28 @@ void IOHandler::processJoinGame(const PacketGameJoin &pgj)
 	qDebug() << "Total" << cgs.totalSquares;
 	cgs.tickRate = pgj.getTickRate();
 	qDebug() << "Tick Rate" << cgs.tickRate;
+	repairing = false;
 	cgs.lastTick = QDateTime::currentDateTime();
+	cgs.received.start();
 	
 	processPlayersUpdate(pgj.getPPU(), true);
 	processLeaderboardUpdate(pgj.getPLU(), true);
+	cgs.forgetGood();
 	processFullBoard(pgj.getPRB(), true);
-	updatePlayerPositions();
+	cgs.updatePlayerPositions();
 
 	if (!cgs.getClient())
 		qWarning() << "PGJ: No client player set up!";
 	else
 		cgs.getClient()->setScore(pgj.getScore());
 
+	publish();
 	cgs.unlock();
 }
 
 void IOHandler::processGameTick(const PacketGameTick &pgt)
 {
+	qint64 arrival = monotonic.nsecsElapsed();
 	cgs.lockState();
 
 	if (cgs.getTick() >= pgt.getTick())
@@ -250,105 +430,274 @@ void IOHandler::processGameTick(const PacketGameTick &pgt)
 		return;
 	}
 
-	cgs.tick = pgt.getTick();
-	cgs.lastTick = QDateTime::currentDateTime();
-	qDebug() << "Tick:" << cgs.getTick();
-	qDebug() << "Score:" << pgt.getScore();
+	advanceTick(pgt.getTick(), pgt.getScore(), pgt.getTimestamp(), arrival);
+	cgs.applyTick(pgt.getDirection(), pgt.getNewSection(), pgt.getDiff());
 
-	if (!cgs.getClient())
-		qWarning() << "PGT: No client player set up!";
-	else
-		cgs.getClient()->setScore(pgt.getScore());
-
-	// TODO We can use shifting indices in GameState to make this really fast.
-	// But I don't think it matters right now.
-	const state_t *news = pgt.getNewSection();
-	const state_t *const *diff = pgt.getDiff();
-	switch(pgt.getDirection())
-	{
-	case UP:
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Warray-bounds"
-		std::copy_backward(cgs.board[0], cgs.board[CLIENT_FRAME - 1], cgs.board[CLIENT_FRAME]);
-#pragma GCC diagnostic pop
-		std::copy(news, news + CLIENT_FRAME, &cgs.board[0][0]);
-		for (int i = 1; i < CLIENT_FRAME; i++)
-			for (int j = 0; j < CLIENT_FRAME; j++)
-				cgs.board[i][j] ^= diff[i][j];
-		break;
-	case DOWN:
-		// For some reason copy doesn't work with overlapping ranges. *shrug*
-		for (int i = 1; i < CLIENT_FRAME; ++i)
-			std::copy(cgs.board[i], cgs.board[i + 1], cgs.board[i - 1]);
-		std::copy(news, news + CLIENT_FRAME, cgs.board[CLIENT_FRAME - 1]);
-		for (int i = 0; i < CLIENT_FRAME - 1; i++)
-			for (int j = 0; j < CLIENT_FRAME; j++)
-				cgs.board[i][j] ^= diff[i][j];
-		break;
-	case LEFT:
-		for (int i = 0; i < CLIENT_FRAME; i++)
-		{
-			std::copy_backward(cgs.board[i], &cgs.board[i][CLIENT_FRAME - 1], cgs.board[i + 1]); 
-			cgs.board[i][0] = news[i];
-			for (int j = 1; j < CLIENT_FRAME; j++)
-				cgs.board[i][j] ^= diff[i][j];
-		}
-		break;
-	case RIGHT:
-		for (int i = 0; i < CLIENT_FRAME; i++)
-		{
-			std::copy(&cgs.board[i][1], cgs.board[i + 1], cgs.board[i]); 
-			cgs.board[i][CLIENT_FRAME - 1] = news[i];
-			for (int j = 0; j < CLIENT_FRAME - 1; j++)
-				cgs.board[i][j] ^= diff[i][j];
-		}
-		break;
-	case NONE:
-		for (int i = 0; i < CLIENT_FRAME; i++)
-		{
-			for (int j = 0; j < CLIENT_FRAME; j++)
-				cgs.board[i][j] ^= diff[i][j];
-		}
-		break;
-	}
-
-	state_t *ptrs[CLIENT_FRAME];
-	for (int i = 0; i < CLIENT_FRAME; i++)
-		ptrs[i] = cgs.board[i];
-
-	QByteArray chksum = hashBoard(ptrs);
+	QByteArray chksum = cgs.hashView(boardHash());
 	if (chksum != pgt.getChecksum())
 	{
-		qWarning() << "PGT Checksum:" << pgt.getChecksum() << "disagrees with computed:" << chksum << "! Requesting resend...";
-		requestResend();
+		qWarning() << "PGT Checksum:" << pgt.getChecksum() << "disagrees with computed:" << chksum << "! Requesting catch up...";
+		stats.checksumFailures++;
+		requestCatchup();
 		qDebug() << "Tick" << cgs.getTick() << "Board Received:";
 		QString msg;
 		for (int i = 0; i < CLIENT_FRAME; ++i)
 		{
 			for (int j = 0; j < CLIENT_FRAME; ++j)
-				msg += QString::number(cgs.board[i][j], 16) + " ";
+				msg += QString::number(cgs.square(j, i), 16) + " ";
 			msg += "\n";
 		}
 		qDebug() << qPrintable(msg);
+	} else if (!repairing) {
+		cgs.markGood();
+	}
+
+	finishTick();
+}
+
+void IOHandler::processDeltaTick(const PacketDeltaTick &pdt)
+{
+	qint64 arrival = monotonic.nsecsElapsed();
+	cgs.lockState();
+
+	if (!udpActive)
+		qDebug() << "Receiving ticks over UDP.";
+	udpActive = true;
+
+	// Datagrams can arrive late, twice or out of order. The tick doubles as
+	// the sequence number, so anything we've moved past is stale.
+	if (cgs.getTick() >= pdt.getTick())
+	{
+		qDebug() << "PDT: Dropping tick" << pdt.getTick() << "as we're on tick" << cgs.getTick();
+		cgs.unlock();
+		return;
+	}
+
+	// The server is behind on our acks, most likely because they were
+	// lost. Remind it of the newest view we have.
+	if (!cgs.hasGood(pdt.getFrom()))
+	{
+		qDebug() << "PDT: Tick" << pdt.getTick() << "is from tick" << pdt.getFrom() << "which we don't have.";
+		if (cgs.hasGood(cgs.goodTick))
+			udp->send(PacketTickAck(udpToken, cgs.goodTick));
+		cgs.unlock();
+		return;
+	}
+
+	advanceTick(pdt.getTick(), pdt.getScore(), pdt.getTimestamp(), arrival);
+	cgs.catchUp(pdt.getFrom(), pdt.getXOffset(), pdt.getYOffset(), pdt.getDiff());
+
+	// A bad tick is left alone. The next one is sent from the same view
+	// and replaces it.
+	QByteArray chksum = cgs.hashView(boardHash());
+	if (chksum != pdt.getChecksum())
+	{
+		qWarning() << "PDT Checksum:" << pdt.getChecksum() << "disagrees with computed:" << chksum << "!";
+		stats.checksumFailures++;
 	} else {
-		updatePlayerPositions();
+		cgs.markGood();
+		udp->send(PacketTickAck(udpToken, cgs.getTick()));
+	}
+
+	finishTick();
+}
+
+void IOHandler::processUdpOffer(const PacketUdpOffer &puo)
+{
+	if (!udp->localPort() && !udp->bind())
+	{
+		qWarning() << "Unable to open a UDP port:" << udp->errorString() << ". Staying on TCP.";
+		return;
+	}
+
+	qDebug() << "Server offered UDP port" << puo.getPort();
+	udpToken = puo.getToken();
+	udp->setPeer(socket->peerAddress(), puo.getPort());
+	udp->send(PacketUdpHello(udpToken));
+}
+
+void IOHandler::advanceTick(tick_t tick, score_t score, qint64 timestamp, qint64 arrival)
+{
+	cgs.tick = tick;
+	cgs.lastTick = QDateTime::currentDateTime();
+	cgs.received.start();
+	cgs.tickDelay = 0;
+	if (timestamp >= 0 && sync.isSynced())
+	{
+		qint64 delay = arrival - sync.toLocal(timestamp);
+		delays[nextDelay] = delay;
+		nextDelay = (nextDelay + 1) % DELAY_WINDOW;
+		cgs.tickDelay = delay - *std::min_element(delays, delays + DELAY_WINDOW);
 	}
+	stats.ticks++;
+	qDebug() << "Tick:" << cgs.getTick();
+	qDebug() << "Score:" << score;
 
-	if (cgs.kioskMode())
+	// Spectators watching the whole board don't have one.
+	if (cgs.getClient())
+		cgs.getClient()->setScore(score);
+	else if (!spectate)
+		qWarning() << "Tick: No client player set up!";
+}
+
+void IOHandler::finishTick()
+{
+	if (cgs.kioskMode() && !spectate)
 		QTimer::singleShot(10, this, [this] {
 			changeDirection(ka.tick(cgs));
 		} );
 
+	publish();
 	cgs.unlock();
 
 	emit gameTick();
+}
+
+void IOHandler::processTimeSync(const PacketTimeSync &pts)
+{
+	qint64 now = monotonic.nsecsElapsed();
+
+	if (pts.isRequest())
+	{
+		Packet::writePacket(str, pts.reply(now, monotonic.nsecsElapsed()));
+		return;
+	}
+
+	qint64 rtt = sync.sample(pts, now);
+	qDebug() << "Round trip" << rtt << "ns, offset" << sync.getOffset() << "ns";
+
+	cgs.lockState();
+	cgs.roundTrip = sync.getRoundTrip();
+	cgs.unlock();
+}
+
+void IOHandler::processCapabilities(const PacketCapabilities &pc)
+{
+	// We've already gone ahead as if the server didn't know them.
+	if (capsKnown)
+	{
+		qWarning() << "Capabilities arrived after we gave up waiting for them.";
+		return;
+	}
+
+	quint32 offered = pc.getCapabilities();
+	if (pc.getCodesVersion() != TickCoder::VERSION)
+	{
+		qDebug() << "Server has tick code tables version" << pc.getCodesVersion() << "instead of" << TickCoder::VERSION;
+		offered &= ~CAP_CODED_TICKS;
+	}
+	learnCapabilities(true, offered);
+}
 
+void IOHandler::learnCapabilities(bool server, quint32 offered)
+{
+	qDebug() << "Server capabilities:" << (server ? QString::number(offered) : QString("none"));
+	helloTimeout->stop();
+	capsKnown = true;
+	capsServer = server;
+	serverCaps = offered;
+
+	// Only a server which answered our hello is sure to know time syncs
+	// and UDP.
+	if (server)
+	{
+		requestTimeSync();
+		if (udpWanted && !spectate)
+			Packet::writePacket(str, PacketRequestUdp());
+	}
+
+	if (joinWanted)
+		enterQueue();
+}
+
+BoardHash IOHandler::boardHash() const
+{
+	return caps & CAP_FAST_HASH ? HASH_FNV64 : HASH_MD4;
+}
+
+void IOHandler::processCatchup(const PacketCatchup &pc)
+{
+	cgs.lockState();
+
+	if (!repairing)
+		qWarning() << "PCU: Received a catch up we didn't ask for.";
+	repairing = false;
+
+	if (!cgs.catchUp(pc.getFrom(), pc.getXOffset(), pc.getYOffset(), pc.getDiff()))
+	{
+		qWarning() << "PCU: Caught up from tick" << pc.getFrom() << ", which we no longer have! Requesting rows...";
+		requestRows();
+		cgs.unlock();
+		return;
+	}
+
+	// We may not have had the current tick yet, in which case it will be
+	// ignored when it comes.
+	cgs.tick = std::max(cgs.tick, pc.getTick());
+
+	QByteArray chksum = cgs.hashView(boardHash());
+	if (chksum != pc.getChecksum())
+	{
+		qWarning() << "PCU Checksum:" << pc.getChecksum() << "disagrees with computed:" << chksum << "! Requesting rows...";
+		stats.checksumFailures++;
+		requestRows();
+	} else {
+		qDebug() << "PCU: Caught up from tick" << pc.getFrom() << "to" << pc.getTick();
+		cgs.markGood();
+	}
+
+	publish();
+	cgs.unlock();
+}
+
+void IOHandler::processPartialBoard(const PacketPartialBoard &ppb)
+{
+	cgs.lockState();
+	repairing = false;
+
+	// The rows are only right for the tick they were sent on. If it hasn't
+	// reached us yet, there's nothing to do but start over.
+	if (ppb.getTick() != cgs.getTick())
+	{
+		qWarning() << "PPB Packet is on tick" << ppb.getTick() << ", but we're on tick" << cgs.getTick() << "! Requesting resend...";
+		requestResend();
+		cgs.unlock();
+		return;
+	}
+
+	for (int r = 0; r < CLIENT_FRAME; r++)
+		if (ppb.hasRow(r))
+			cgs.setRow(r, ppb.getRow(r));
+	cgs.updatePlayerPositions();
+
+	QByteArray chksum = cgs.hashView(boardHash());
+	if (chksum != ppb.getChecksum())
+	{
+		qWarning() << "PPB Checksum:" << ppb.getChecksum() << "disagrees with computed:" << chksum << "! Requesting resend...";
+		stats.checksumFailures++;
+		requestResend();
+	} else {
+		qDebug() << "PPB: Replaced" << ppb.getRowCount() << "rows on tick" << ppb.getTick();
+		cgs.markGood();
+	}
+
+	publish();
+	cgs.unlock();
+}
+
+void IOHandler::publish()
+{
+	if (views)
+		views->publish(cgs);
 }
 
 void IOHandler::newData()
 {
 	Packet *packet = NULL;
 
+	// Anything beyond what was left over from the last call is new.
+	stats.bytesReceived += socket->bytesAvailable() - unread;
+
 	// Read all available packets.
 	while (true)
 	{
@@ -358,6 +707,7 @@ void IOHandler::newData()
 		{
 			if (str.status() == QDataStream::ReadPastEnd)
 				str.resetStatus();
+			unread = socket->bytesAvailable();
 			return;
 		}
 		if (!packet)
@@ -374,26 +724,50 @@ void IOHandler::newData()
 		case PACKET_PLAYERS_UPDATE:
 			processPlayersUpdate(*static_cast<PacketPlayersUpdate *>(packet));
 			break;
+		case PACKET_PLAYERS_DELTA:
+			processPlayersDelta(*static_cast<PacketPlayersDelta *>(packet));
+			break;
 		case PACKET_LEADERBOARD_UPDATE:
 			processLeaderboardUpdate(*static_cast<PacketLeaderboardUpdate *>(packet));
 			break;
 		case PACKET_RESEND_BOARD:
+		case PACKET_PACKED_BOARD:
 			processFullBoard(*static_cast<PacketResendBoard *>(packet));
 			break;
 		case PACKET_GAME_JOIN:
+		case PACKET_GAME_JOIN_CAPS:
+			caps = 0;
+			if (packet->getId() == PACKET_GAME_JOIN_CAPS)
+				caps = static_cast<PacketGameJoinCaps *>(packet)->getCapabilities();
 			processJoinGame(*static_cast<PacketGameJoin *>(packet));
 			emit enteredGame();
 			break;
 		case PACKET_GAME_TICK:
 			processGameTick(*static_cast<PacketGameTick *>(packet));
 			break;
+		case PACKET_CATCHUP:
+			processCatchup(*static_cast<PacketCatchup *>(packet));
+			break;
+		case PACKET_TIME_SYNC:
+			processTimeSync(*static_cast<PacketTimeSync *>(packet));
+			break;
+		case PACKET_PARTIAL_BOARD:
+			processPartialBoard(*static_cast<PacketPartialBoard *>(packet));
+			break;
+		case PACKET_CAPABILITIES:
+			processCapabilities(*static_cast<PacketCapabilities *>(packet));
+			break;
+		case PACKET_UDP_OFFER:
+			processUdpOffer(*static_cast<PacketUdpOffer *>(packet));
+			break;
 		case PACKET_GAME_END:
 		{
 			cgs.lockState();
 			int kiosk = cgs.kioskMode();
 			cgs.unlock();
 
-			if (kiosk)
+			// Spectators go on to the next game.
+			if (kiosk || spectate)
 				enterQueue();
 			else
 				// N.B. We don't need to lock, because the only time this value
@@ -411,3 +785,21 @@ void IOHandler::newData()
 		delete packet;
 	}
 }
+
+void IOHandler::udpData()
+{
+	while (udp->hasPending())
+	{
+		stats.bytesReceived += std::max(udp->pendingSize(), qint64(0));
+		Packet *packet = udp->receive();
+		if (!packet)
+			continue;
+
+		if (packet->getId() == PACKET_DELTA_TICK && udp->hasPeer())
+			processDeltaTick(*static_cast<PacketDeltaTick *>(packet));
+		else
+			qDebug() << "Received unexpected UDP packet: " << packet->getId();
+
+		delete packet;
+	}
+}
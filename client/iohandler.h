@@ -9,19 +9,64 @@
 
 #include <QDataStream>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QTcpSocket>
 #include <QTimer>
 
 #include "clientgamestate.h"
 #include "kioskai.h"
 #include "types.h"
+#include "udplink.h"
+#include "viewbuffer.h"
+
+/*
+ * Running totals of the traffic an IOHandler has processed. These are
+ * only updated and read on the IOHandler's own thread.
+ */
+struct IOStatistics
+{
+	quint64 bytesReceived;
+	quint32 ticks;
+	quint32 checksumFailures;
+	// Whole board resends, catch ups and row repairs.
+	quint32 resendRequests;
+};
 
 class IOHandler : public QObject
 {
 	Q_OBJECT
 
 public:
-	IOHandler(ClientGameState &cgs, QObject *parent = Q_NULLPTR);
+	/*
+	 * If views is given, a copy of the state is published to it after
+	 * every packet which changes the state.
+	 */
+	IOHandler(ClientGameState &cgs, ViewBuffer *views = Q_NULLPTR, QObject *parent = Q_NULLPTR);
+
+	/*
+	 * WARNING: This must only be called from the thread the IOHandler
+	 * lives on.
+	 */
+	IOStatistics getStatistics() const;
+
+	/*
+	 * Whether to ask the server for ticks over UDP. Takes effect on the
+	 * next connection. Everything else stays on TCP.
+	 */
+	void setUdp(bool enabled);
+
+	/*
+	 * Limits the capabilities asked for when joining, for testing how
+	 * clients without them fare. Takes effect on the next join.
+	 */
+	void setCapabilities(quint32 caps);
+
+	/*
+	 * Whether to watch games rather than play them, following the given
+	 * player or, with NULL_ID, the whole board. Takes effect on the next
+	 * join. UDP isn't used while spectating.
+	 */
+	void setSpectate(bool enabled, plid_t target = NULL_ID);
 
 public slots:
 	void connectToServer(const QString &host, quint16 port, const QString &name);
@@ -31,6 +76,9 @@ public slots:
 	void enterQueue();
 	void changeDirection(Direction dir);
 	void requestResend();
+	void requestCatchup();
+	void requestRows();
+	void requestTimeSync();
 
 signals:
 	void connected();
@@ -46,6 +94,7 @@ private slots:
 	void ierror(QAbstractSocket::SocketError error);
 	void kaTimeout();
 	void newData();
+	void udpData();
 
 private:
 	QTcpSocket *socket;
@@ -54,21 +103,78 @@ private:
 	QTimer *keepAlive;
 	QDateTime lastka;
 
+	// If the server hasn't answered our hello by the time this fires, it
+	// doesn't know capabilities.
+	QTimer *helloTimeout;
+
 	QString name;
 	ClientGameState &cgs;
+	ViewBuffer *views;
 
 	KioskAI ka;
 
-	/*
-	 * WARNING: This function must be called within a lock.
-	 */
-	void updatePlayerPositions();
+	// Our clock for time syncs, in nanoseconds.
+	QElapsedTimer monotonic;
+	ClockSync sync;
+	// How long the recent timestamped ticks took to arrive. The quickest
+	// of them is taken as the usual delay.
+	static const int DELAY_WINDOW = 32;
+	qint64 delays[DELAY_WINDOW];
+	int nextDelay;
+
+	IOStatistics stats;
+	qint64 unread;
+
+	// Whether we've asked the server to fix our view, with a catch up or
+	// some rows, and are waiting for it.
+	bool repairing;
+
+	bool udpWanted;
+	UdpLink *udp;
+	quint32 udpToken;
+	// Set once a tick has come over UDP, after which we stop saying hello.
+	bool udpActive;
+
+	// What the server said it can do, once it has answered our hello or
+	// shown it doesn't know capabilities. Joins wait until then.
+	bool capsKnown;
+	bool capsServer;
+	quint32 serverCaps;
+	quint32 wantedCaps;
+	bool joinWanted;
+	// The capabilities agreed on for the current game.
+	quint32 caps;
+	bool spectate;
+	plid_t spectateTarget;
+	// The tick of the last full list of players, which may already have
+	// that tick's players delta in it.
+	tick_t playersTick;
 
 	void processPlayersUpdate(const PacketPlayersUpdate &ppu, bool nested = false);
+	void processPlayersDelta(const PacketPlayersDelta &ppd);
 	void processLeaderboardUpdate(const PacketLeaderboardUpdate &plu, bool nested = false);
 	void processFullBoard(const PacketResendBoard &prb, bool nested = false);
 	void processJoinGame(const PacketGameJoin &pgj);
 	void processGameTick(const PacketGameTick &pgt);
+	void processDeltaTick(const PacketDeltaTick &pdt);
+	void processUdpOffer(const PacketUdpOffer &puo);
+	void processTimeSync(const PacketTimeSync &pts);
+	void processCatchup(const PacketCatchup &pc);
+	void processPartialBoard(const PacketPartialBoard &ppb);
+	void processCapabilities(const PacketCapabilities &pc);
+
+	void learnCapabilities(bool server, quint32 offered);
+	BoardHash boardHash() const;
+
+	/*
+	 * The parts of a tick which don't depend on how it was sent. The first
+	 * must be called with the state locked, and the second unlocks it.
+	 */
+	void advanceTick(tick_t tick, score_t score, qint64 timestamp, qint64 arrival);
+	void finishTick();
+
+	/* Must be called with the state locked. */
+	void publish();
 };
 
 #endif // !IOHANDLER_H
@@ -1,12 +1,87 @@
 /*
- * This is a clone of the AI software which runs on the client while in
- * kiosk mode. In a perfect world the code would be reused...
+ * This is the AI which runs on the client while in kiosk mode. It is the
+ * same AI the server runs (see common/aiengine.h), only limited to what
+ * the client can see.
  */
 #ifndef KIOSKAI_H
 #define KIOSKAI_H
 
+#include "aiengine.h"
 #include "clientgamestate.h"
 
+/*
+ * The AIEngine's view of the client's board. Coordinates are relative to
+ * the client, as with ClientGameState, and the distance fields only cover
+ * the squares in view.
+ */
+class ClientBoardView
+{
+public:
+	ClientBoardView(const ClientGameState &cgs, const ClientPlayer &pl,
+	                const quint16 (&territory)[CLIENT_FRAME][CLIENT_FRAME],
+	                const quint16 (&heads)[CLIENT_FRAME][CLIENT_FRAME])
+		: cgs(cgs)
+		, pl(pl)
+		, territory(territory)
+		, heads(heads)
+	{
+	}
+
+	plid_t getId() const
+	{
+		return pl.getId();
+	}
+
+	pos_t getX() const
+	{
+		return pl.getX();
+	}
+
+	pos_t getY() const
+	{
+		return pl.getY();
+	}
+
+	Direction getDirection() const
+	{
+		return pl.getDirection();
+	}
+
+	state_t getState(pos_t x, pos_t y) const
+	{
+		int rx = x + CLIENT_FRAME / 2;
+		int ry = y + CLIENT_FRAME / 2;
+		if (rx < 0 || rx >= CLIENT_FRAME || ry < 0 || ry >= CLIENT_FRAME)
+			return OUT_OF_BOUNDS_STATE;
+		return cgs.square(rx, ry);
+	}
+
+	int getTerritoryDistance(pos_t x, pos_t y) const
+	{
+		return lookup(territory, x, y);
+	}
+
+	int getEnemyHeadDistance(pos_t x, pos_t y) const
+	{
+		return lookup(heads, x, y);
+	}
+
+private:
+	const ClientGameState &cgs;
+	const ClientPlayer &pl;
+	const quint16 (&territory)[CLIENT_FRAME][CLIENT_FRAME];
+	const quint16 (&heads)[CLIENT_FRAME][CLIENT_FRAME];
+
+	static int lookup(const quint16 (&field)[CLIENT_FRAME][CLIENT_FRAME], pos_t x, pos_t y)
+	{
+		int rx = x + CLIENT_FRAME / 2;
+		int ry = y + CLIENT_FRAME / 2;
+		if (rx < 0 || rx >= CLIENT_FRAME || ry < 0 || ry >= CLIENT_FRAME)
+			return AI_UNREACHABLE;
+		return field[ry][rx];
+	}
+};
+
 class KioskAI
 {
 public:
@@ -14,11 +89,12 @@ public:
 
 	Direction tick(const ClientGameState &gs);
 private:
-	int traillen;
-	int heur[CLIENT_FRAME][CLIENT_FRAME];
+	AIEngine<ClientBoardView> engine;
 
-	double assessDirection(const ClientGameState &pgs, Direction d, pos_t x, pos_t y, int traillen, int recurse = 5);
-	int computeDistance(const ClientGameState &cgs, pos_t x, pos_t y);
+	// Distances to our territory and to other players over the squares in
+	// view, recomputed every tick.
+	quint16 territory[CLIENT_FRAME][CLIENT_FRAME];
+	quint16 heads[CLIENT_FRAME][CLIENT_FRAME];
 };
 
 #endif // !KIOSKAI_H
@@ -2,7 +2,9 @@
  * This is the main entry point for the paper-io client. 
  */
 
+#include <limits>
 #include <QApplication>
+#include <QCommandLineParser>
 
 #include "client.h"
 #include "font.h"
@@ -18,6 +20,24 @@ int main(int argc, char *argv[])
 	QCoreApplication::setOrganizationDomain("dank.meeeeee.me");
 	QCoreApplication::setApplicationName("Arduino-IO");
 
+	QCommandLineParser parser;
+	parser.setApplicationDescription("The paper-io client.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{"udp", "Receive game ticks over UDP, falling back to TCP if the server doesn't offer it."},
+		{"spectate", "Watch games instead of playing, following this player, or with 0 the whole board.", "player"},
+	});
+	parser.process(app);
+
+	// Player ids are a byte.
+	bool ok = true;
+	uint target = parser.isSet("spectate") ? parser.value("spectate").toUInt(&ok) : 0;
+	if (!ok || target > std::numeric_limits<plid_t>::max())
+	{
+		qCritical() << "--spectate needs a player id from 0 to" << int(std::numeric_limits<plid_t>::max());
+		return 1;
+	}
+
 	// We need to do this so we can communicate errors across threads.
 	qRegisterMetaType<QAbstractSocket::SocketError>();
 	qRegisterMetaType<score_t>("score_t");
@@ -90,7 +110,7 @@ QLabel
 	app.setStyleSheet(style);
 	QApplication::setFont(getDejaVuFont());
 
-	Client client;
+	Client client(parser.isSet("udp"), parser.isSet("spectate"), plid_t(target));
 	client.show();
 
 	return app.exec();
@@ -109,4 +129,22 @@ void registerPackets()
 	Packet::registerPacket(PACKET_UPDATE_DIR, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUpdateDir>()));
 	Packet::registerPacket(PACKET_REQUEST_RESEND, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestResend>()));
 	Packet::registerPacket(PACKET_GAME_END, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameEnd>()));
+	Packet::registerPacket(PACKET_TIME_SYNC, std::unique_ptr<APacketFactory>(new PacketFactory<PacketTimeSync>()));
+	Packet::registerPacket(PACKET_REQUEST_CATCHUP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestCatchup>()));
+	Packet::registerPacket(PACKET_CATCHUP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketCatchup>()));
+	Packet::registerPacket(PACKET_REQUEST_UDP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestUdp>()));
+	Packet::registerPacket(PACKET_UDP_OFFER, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUdpOffer>()));
+	Packet::registerPacket(PACKET_UDP_HELLO, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUdpHello>()));
+	Packet::registerPacket(PACKET_TICK_ACK, std::unique_ptr<APacketFactory>(new PacketFactory<PacketTickAck>()));
+	Packet::registerPacket(PACKET_DELTA_TICK, std::unique_ptr<APacketFactory>(new PacketFactory<PacketDeltaTick>()));
+	Packet::registerPacket(PACKET_REQUEST_ROWS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestRows>()));
+	Packet::registerPacket(PACKET_PARTIAL_BOARD, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPartialBoard>()));
+	Packet::registerPacket(PACKET_HELLO, std::unique_ptr<APacketFactory>(new PacketFactory<PacketHello>()));
+	Packet::registerPacket(PACKET_CAPABILITIES, std::unique_ptr<APacketFactory>(new PacketFactory<PacketCapabilities>()));
+	Packet::registerPacket(PACKET_PACKED_BOARD, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPackedBoard>()));
+	Packet::registerPacket(PACKET_REQUEST_JOIN_CAPS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestJoinCaps>()));
+	Packet::registerPacket(PACKET_GAME_JOIN_CAPS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameJoinCaps>()));
+	Packet::registerPacket(PACKET_PLAYERS_DELTA, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPlayersDelta>()));
+	Packet::registerPacket(PACKET_REQUEST_PLAYERS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestPlayers>()));
+	Packet::registerPacket(PACKET_REQUEST_SPECTATE, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestSpectate>()));
 }
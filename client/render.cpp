@@ -11,32 +11,6 @@
 #include "launcher.h"
 #include "render.h"
 
-static int getXOff(Direction dir)
-{
-    switch (dir)
-    {
-    case LEFT:
-        return -1;
-    case RIGHT:
-        return 1;
-    default:
-        return 0;
-    }
-}
-
-static int getYOff(Direction dir)
-{
-    switch (dir)
-    {
-    case UP:
-        return -1;
-    case DOWN:
-        return 1;
-    default:
-        return 0;
-    }
-}
-
 static QStaticText &getTitleString()
 {
 	static QStaticText text;
@@ -91,56 +65,390 @@ static QColor playerColors[10][3] = { {QColor(0xFF99CC), QColor(0xE481C3), QColo
                                       {QColor(0xFF9999), QColor(0xFF6666), QColor(0xFFCCCC)}}; // Salmon
 
 static QColor outOfBoundsColor = QColor(100,100,100);
-const int NUM_COLORS = sizeof(playerColors);
+const int NUM_COLORS = sizeof(playerColors) / sizeof(playerColors[0]);
+
+/*
+ * Which of the colors each player is drawn in. Players keep their color
+ * for as long as they're in the game; players beyond the number of colors
+ * share the first one.
+ */
+class ColorMap
+{
+public:
+	ColorMap()
+		: generation(0)
+	{
+		std::fill(colors, colors + 256, -1);
+		std::fill(used, used + NUM_COLORS, false);
+	}
+
+	int value(plid_t id) const
+	{
+		return std::max(colors[id], 0);
+	}
+
+	/*
+	 * Assigns colors to new players and frees those of players who left.
+	 * Returns a number which changes whenever any player's color does.
+	 */
+	quint32 update(const QList<const ClientPlayer *> &players)
+	{
+		bool present[256] = {};
+		foreach (const ClientPlayer *pl, players)
+			present[pl->getId()] = true;
+
+		bool changed = false;
+		for (int id = 0; id < 256; ++id)
+		{
+			if (colors[id] < 0 || present[id])
+				continue;
+			used[colors[id]] = false;
+			colors[id] = -1;
+			changed = true;
+		}
+
+		int next = 0;
+		foreach (const ClientPlayer *pl, players)
+		{
+			if (colors[pl->getId()] >= 0)
+				continue;
+
+			while (next < NUM_COLORS && used[next])
+				++next;
+			if (next == NUM_COLORS)
+			{
+				qCritical() << "Error: Could not assign a color to all players!";
+				break;
+			}
+
+			colors[pl->getId()] = next;
+			used[next] = true;
+			changed = true;
+		}
+
+		if (changed)
+			++generation;
+		return generation;
+	}
 
-QHash<plid_t, int> colorMap;
+private:
+	quint32 generation;
+	int colors[256];
+	bool used[NUM_COLORS];
+};
 
-static void updateColorMap(QList<const ClientPlayer *> players)
+static ColorMap colorMap;
+
+static quint32 updateColorMap(const QList<const ClientPlayer *> &players)
 {
-    //return;
-    for (auto iter = colorMap.begin(); iter != colorMap.end(); )
-    {
-        for (auto pter = players.begin(); pter < players.end(); ++pter)
-        {
-            if (iter.key() == (*pter)->getId())
-            {
-                players.erase(pter);
-                ++iter;
-                goto first_loop_continue;
-            }
-        }
-       //this statement only executes if a player is assigned a color, but has lost
-        iter = colorMap.erase(iter);
+	return colorMap.update(players);
+}
 
-    first_loop_continue: ;
-    }
-    //any player left in players is a new player, not assigned a color but in game
-    if (players.empty())
-        return;
+const int TRAIL_ALPHA = 128;
 
-    auto pter = players.cbegin();
+BoardLayer::BoardLayer()
+	: image()
+	, squareSize(0)
+	, colors(0)
+	, valid(false)
+{
+}
 
-    for (int i = 0; i < NUM_COLORS; ++i)
-    {
-        for (auto iter = colorMap.cbegin(); iter != colorMap.cend(); ++iter)
-        {
-            if (i == iter.value())
-               goto second_loop_continue;
-        }
+void BoardLayer::draw(const ClientGameState &cgs, QPainter *painter, int left, int top,
+                      int size, quint32 cl)
+{
+	if (size != squareSize)
+	{
+		squareSize = size;
+		image = QImage(CLIENT_FRAME * size, CLIENT_FRAME * size, QImage::Format_ARGB32_Premultiplied);
+		valid = false;
+	}
+	if (cl != colors)
+	{
+		colors = cl;
+		valid = false;
+	}
+
+	// Repaint whatever changed since the last frame. Comparing the whole
+	// board is far cheaper than painting any of it.
+	QPainter ip;
+	for (int py = 0; py < CLIENT_FRAME; ++py)
+	{
+		for (int px = 0; px < CLIENT_FRAME; ++px)
+		{
+			state_t state = cgs.board[py][px];
+			if (valid && painted[py][px] == state)
+				continue;
+
+			if (!ip.isActive())
+			{
+				ip.begin(&image);
+				ip.setRenderHint(QPainter::Antialiasing);
+			}
+			paintSquare(ip, px, py, state);
+			painted[py][px] = state;
+		}
+	}
+	if (ip.isActive())
+		ip.end();
+	valid = true;
+
+	// The image is stored the same way as the board, so the view starts at
+	// the origin and wraps around. Draw it in up to four pieces.
+	const int sx[2] = { cgs.originX * size, 0 };
+	const int sw[2] = { (CLIENT_FRAME - cgs.originX) * size, cgs.originX * size };
+	const int sy[2] = { cgs.originY * size, 0 };
+	const int sh[2] = { (CLIENT_FRAME - cgs.originY) * size, cgs.originY * size };
+	for (int j = 0; j < 2; ++j)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			if (!sw[i] || !sh[j])
+				continue;
+			painter->drawImage(left + (i ? sw[0] : 0), top + (j ? sh[0] : 0), image, sx[i], sy[j], sw[i], sh[j]);
+		}
+	}
+}
 
-        colorMap.insert((*pter)->getId(), i);
+void BoardLayer::paintSquare(QPainter &painter, int px, int py, state_t state)
+{
+	const int x = px * squareSize;
+	const int y = py * squareSize;
+	const plid_t owner = static_cast<plid_t>((state & 0xFF000000) >> 24);
+	const plid_t trail = static_cast<plid_t>((state & 0xFF00) >> 8);
 
-        if (++pter >= players.cend())
-            return;
+	painter.setClipRect(x, y, squareSize, squareSize);
 
-    second_loop_continue: ;
-    }
+	if (owner == OUT_OF_BOUNDS)
+	{
+		painter.fillRect(x, y, squareSize, squareSize, outOfBoundsColor);
+		return;
+	}
+
+	painter.fillRect(x, y, squareSize, squareSize, background);
+	if (owner != UNOCCUPIED)
+		painter.fillRect(x, y, squareSize, squareSize, playerColors[colorMap.value(owner)][1]);
+
+	if (TrailType(state & 0x07) == NOTRAIL)
+		return;
+
+	QColor trailColor = playerColors[colorMap.value(trail)][0];
+	trailColor.setAlpha(TRAIL_ALPHA);
+
+	// Each diagonal trail is a triangle given by the corners it covers.
+	QPoint tl(x, y), tr(x + squareSize, y), bl(x, y + squareSize), br(x + squareSize, y + squareSize);
+	QPolygon triangle;
+	switch (TrailType(state & 0x07))
+	{
+	case EASTTOWEST:
+	case NORTHTOSOUTH:
+		painter.fillRect(x, y, squareSize, squareSize, trailColor.lighter(125));
+		return;
+	case NORTHTOEAST:
+		triangle << bl << tr << br;
+		break;
+	case NORTHTOWEST:
+		triangle << bl << tl << br;
+		break;
+	case SOUTHTOEAST:
+		triangle << br << tr << tl;
+		break;
+	case SOUTHTOWEST:
+		triangle << bl << tl << tr;
+		break;
+	default:
+		return;
+	}
+
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(trailColor);
+	painter.drawPolygon(triangle);
+}
+
+/*
+ * Our best score, which is loaded once and saved whenever we beat it.
+ */
+static double updateBestScore(double percent)
+{
+	static double best = -1;
+	if (best < 0)
+	{
+		QSettings settings;
+		best = qBound(0.0, settings.value("best_score", 0).toDouble(), 1.0);
+	}
+
+	if (percent > best)
+	{
+		best = percent;
+		QSettings settings;
+		settings.setValue("best_score", best);
+	}
+	return best;
+}
+
+static QString formatPercent(double percent)
+{
+	return QString::number(100 * percent, 'f', (percent >= .1 ? 1 : 2));
+}
+
+HudLayer::HudLayer()
+	: squareSize(0)
+	, nameFont()
+	, nameAscent(0)
+	, panelFont()
+	, names()
+	, leaderboardImage()
+	, scoreImage()
+	, score(0)
+	, best(-1)
+	, colors(0)
+{
+	std::fill(leaderboard, leaderboard + 5, std::make_pair(NULL_ID, 0));
+}
+
+void HudLayer::setSquareSize(int size)
+{
+	if (size == squareSize)
+		return;
+
+	squareSize = size;
+	nameFont.setPixelSize(size / 2);
+	nameAscent = QFontMetrics(nameFont).ascent();
+	panelFont.setPixelSize(size * 0.75 * 0.70);
+
+	// Everything has to be laid out again.
+	names.clear();
+	leaderboardImage = QImage();
+	scoreImage = QImage();
+}
+
+void HudLayer::drawName(QPainter *painter, const ClientPlayer &player, int x, int y, const QColor &color)
+{
+	auto iter = names.find(player.getId());
+	if (iter == names.end() || iter->text() != player.getName())
+	{
+		QStaticText text(player.getName());
+		text.setTextFormat(Qt::PlainText);
+		text.prepare(QTransform(), nameFont);
+		iter = names.insert(player.getId(), text);
+	}
+
+	// The text is positioned by its top, so lift it by the ascent to keep the
+	// baseline 10 pixels above the square.
+	painter->setFont(nameFont);
+	painter->setPen(QPen(color));
+	painter->drawStaticText(x + squareSize / 2 - iter->size().width() / 2,
+	                        y - 10 - nameAscent, *iter);
+}
+
+void HudLayer::drawPanels(const ClientGameState &cgs, QPainter *painter, const QRect &rect, quint32 cl)
+{
+	if (cl != colors)
+	{
+		colors = cl;
+		leaderboardImage = QImage();
+		scoreImage = QImage();
+	}
+
+	const std::pair<plid_t, score_t> *lb = cgs.getLeaderboard();
+	if (leaderboardImage.isNull() || !std::equal(lb, lb + 5, leaderboard))
+	{
+		std::copy(lb, lb + 5, leaderboard);
+		drawLeaderboard(cgs);
+	}
+
+	const ClientPlayer *client = cgs.getClient();
+	score_t sc = client ? client->getScore() : 0;
+	double nbest = updateBestScore(sc / static_cast<double>(cgs.getTotalSquares()));
+	if (scoreImage.isNull() || sc != score || nbest != best)
+	{
+		score = sc;
+		best = nbest;
+		drawScore(cgs);
+	}
+
+	painter->drawImage(rect.x() + rect.width() - leaderboardImage.width(), rect.y(), leaderboardImage);
+	painter->drawImage(rect.x(), rect.y(), scoreImage);
+}
 
-    qCritical() << "Error: Could not assign a color to all players!";
+void HudLayer::drawLeaderboard(const ClientGameState &cgs)
+{
+	const int LEADERBOARD_HEIGHT = squareSize * 0.75;
+
+	// Each bar is as wide as the score is large, and they all hang off the
+	// right edge of the screen.
+	double widths[5];
+	int maxWidth = 1;
+	for (int i = 0; i < 5; ++i)
+	{
+		double percent = leaderboard[i].second / static_cast<double>(cgs.getTotalSquares());
+		double width = 2 * (log(20 * percent + 0.5) - log(0.5));
+		widths[i] = squareSize * (2.5 + width);
+		if (cgs.lookupPlayer(leaderboard[i].first))
+			maxWidth = std::max(maxWidth, static_cast<int>(ceil(widths[i])));
+	}
+
+	leaderboardImage = QImage(maxWidth, 5 * LEADERBOARD_HEIGHT, QImage::Format_ARGB32_Premultiplied);
+	leaderboardImage.fill(Qt::transparent);
 
+	QPainter painter(&leaderboardImage);
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setFont(panelFont);
+	for (int i = 0; i < 5; ++i)
+	{
+		const ClientPlayer *player = cgs.lookupPlayer(leaderboard[i].first);
+		if (!player)
+			continue;
+
+		double percent = leaderboard[i].second / static_cast<double>(cgs.getTotalSquares());
+		int x = maxWidth - widths[i];
+		int y = i * LEADERBOARD_HEIGHT;
+		painter.fillRect(x, y, widths[i], LEADERBOARD_HEIGHT, playerColors[colorMap.value(leaderboard[i].first)][1]);
+
+		painter.setPen(QPen(playerColors[colorMap.value(leaderboard[i].first)][2]));
+		painter.drawText(x + 0.25 * LEADERBOARD_HEIGHT,
+		                 y + 0.75 * LEADERBOARD_HEIGHT,
+		                 QString("%1 - %2% %3").arg(QString::number(i + 1), formatPercent(percent), player->getName()));
+	}
+}
+
+void HudLayer::drawScore(const ClientGameState &cgs)
+{
+	const int LEADERBOARD_HEIGHT = squareSize * 0.75;
+	QFontMetrics fm(panelFont);
+
+	double percent = score / static_cast<double>(cgs.getTotalSquares());
+	double width = 2 * (log(20 * percent + 0.5) - log(0.5));
+	width = squareSize * (2.0 + width);
+	QString tscore = QString("%1%").arg(formatPercent(percent));
+	double twidth = fm.width(tscore);
+	QString best_score = GameOver::tr("Best Score: %2%").arg(QString::number(100 * best, 'f', (percent >= .1 ? 1 : 2)));
+
+	scoreImage = QImage(std::max(static_cast<int>(ceil(width)), fm.width(best_score) + LEADERBOARD_HEIGHT),
+	                    2 * LEADERBOARD_HEIGHT, QImage::Format_ARGB32_Premultiplied);
+	scoreImage.fill(Qt::transparent);
+
+	QPainter painter(&scoreImage);
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setFont(panelFont);
+	painter.fillRect(0, 0, width, LEADERBOARD_HEIGHT, playerColors[colorMap.value(cgs.getClientId())][1]);
+
+	painter.setPen(QPen(playerColors[colorMap.value(cgs.getClientId())][2]));
+	painter.drawText(width - 0.25 * LEADERBOARD_HEIGHT - twidth,
+	                 0.75 * LEADERBOARD_HEIGHT,
+	                 tscore);
+	painter.setPen(QColor(0,0,0,85));
+	painter.drawText(0.25 * LEADERBOARD_HEIGHT + 1,
+	                 1.75 * LEADERBOARD_HEIGHT + 1,
+	                 best_score);
+	painter.setPen(QColor(0xFFFFFF));
+	painter.drawText(0.25 * LEADERBOARD_HEIGHT,
+	                 1.75 * LEADERBOARD_HEIGHT,
+	                 best_score);
 }
 
-void renderGame(const ClientGameState &cgs, QPainter *painter, QPaintEvent *event)
+void renderGame(const ClientGameState &cgs, BoardLayer &layer, HudLayer &hud, double progress,
+                QPainter *painter, QPaintEvent *event)
 {
     painter->setTransform(QTransform());
 
@@ -151,199 +459,46 @@ void renderGame(const ClientGameState &cgs, QPainter *painter, QPaintEvent *even
     const int SQUARE_SIZE = std::max(std::max(ceil(rect.height()/static_cast<double>(CLIENT_FRAME - 2)),
                                               ceil(rect.width()/static_cast<double>(CLIENT_FRAME - 2))), 25.0);
 
-    int offset = SQUARE_SIZE * ((cgs.getLastTick().msecsTo(QDateTime::currentDateTime()))
-                / static_cast<double>(cgs.getTickRate() + 10));
-    offset = std::min(offset - SQUARE_SIZE, 0);
+    // The view trails the latest tick by up to a square and catches up as
+    // the next one comes due.
+    int offset = SQUARE_SIZE * (progress - 1);
 
-    const int CTOP_X = CENTER_X - 0.5 * SQUARE_SIZE - offset * getXOff(cgs.getClient()->getDirection());
-    const int CTOP_Y = CENTER_Y - 0.5 * SQUARE_SIZE - offset * getYOff(cgs.getClient()->getDirection());
-    const int TRAIL_ALPHA = 128;
+    // Spectators watching the whole board have no player and the view never moves.
+    const Direction moving = cgs.getClient() ? cgs.getClient()->getDirection() : NONE;
+    const int CTOP_X = CENTER_X - 0.5 * SQUARE_SIZE - offset * getXOff(moving);
+    const int CTOP_Y = CENTER_Y - 0.5 * SQUARE_SIZE - offset * getYOff(moving);
 
-    QFont font;
-    font.setPixelSize(SQUARE_SIZE / 2);
-    QFontMetrics fm(font);
-    painter->setFont(font);
-    updateColorMap(cgs.getPlayers());
+    quint32 colors = updateColorMap(cgs.getPlayers());
+    hud.setSquareSize(SQUARE_SIZE);
 
     //printing background
     painter->fillRect(event->rect(), background);
 
-    //define center point (player is always centered, so this will always execute with fixed points)
-    QPoint CenterPt;
-    CenterPt.setX(CENTER_X);
-    CenterPt.setY(CENTER_Y);
-
-    //rendering square by square
-    for (int x = -(CLIENT_FRAME / 2); x <= (CLIENT_FRAME / 2); ++x)
-    {
-        for (int y = -(CLIENT_FRAME / 2); y <= (CLIENT_FRAME / 2); ++y)
-        {
-            ClientSquareState state = cgs.getState(x, y);
-            if (state.getOwningPlayerId() == OUT_OF_BOUNDS)
-            {
-                painter->fillRect(CTOP_X + x * SQUARE_SIZE,
-                                  CTOP_Y + y * SQUARE_SIZE,
-                                  SQUARE_SIZE,
-                                  SQUARE_SIZE,
-                                  outOfBoundsColor);
-                continue;
-            }
-            if(state.isOwned())
-            {
-                painter->fillRect(CTOP_X + x * SQUARE_SIZE,
-                                  CTOP_Y + y * SQUARE_SIZE,
-                                  SQUARE_SIZE,
-                                  SQUARE_SIZE,
-                                  playerColors[colorMap.value(state.getOwningPlayerId())][1]);
-            }
-
-            if(state.hasTrail())
-            {
-                QColor trailColor = playerColors[colorMap.value(state.getTrailPlayerId())][0];
-                trailColor.setAlpha(TRAIL_ALPHA);
-
-                QPainterPath triangle;
-                int triX = CTOP_X + x * SQUARE_SIZE;
-                int triY = CTOP_Y + y * SQUARE_SIZE;
-
-                switch (state.getTrailType())
-                {
-                case EASTTOWEST:
-                case NORTHTOSOUTH:
-                    painter->fillRect(CTOP_X + x * SQUARE_SIZE,
-                                    CTOP_Y + y * SQUARE_SIZE,
-                                    SQUARE_SIZE,
-                                    SQUARE_SIZE,
-                                    trailColor.lighter(125));
-                    break;
-
-                case NORTHTOEAST:
-                    triangle.moveTo(triX, triY + SQUARE_SIZE);
-                    triangle.lineTo(triX + SQUARE_SIZE, triY);
-                    triangle.lineTo(triX + SQUARE_SIZE, triY + SQUARE_SIZE);
-                    triangle.lineTo(triX, triY + SQUARE_SIZE);
-                    painter->fillPath(triangle, trailColor);
-                    break;
-
-                case NORTHTOWEST:
-                    triangle.moveTo(triX, triY + SQUARE_SIZE);
-                    triangle.lineTo(triX, triY);
-                    triangle.lineTo(triX + SQUARE_SIZE, triY + SQUARE_SIZE);
-                    triangle.lineTo(triX, triY + SQUARE_SIZE);
-                    painter->fillPath(triangle, trailColor);
-                    break;
-
-                case SOUTHTOEAST:
-                    triangle.moveTo(triX + SQUARE_SIZE, triY + SQUARE_SIZE);
-                    triangle.lineTo(triX + SQUARE_SIZE, triY);
-                    triangle.lineTo(triX, triY);
-                    triangle.lineTo(triX + SQUARE_SIZE, triY + SQUARE_SIZE);
-                    painter->fillPath(triangle, trailColor);
-                    break;
-
-                case SOUTHTOWEST:
-                    triangle.moveTo(triX, triY + SQUARE_SIZE);
-                    triangle.lineTo(triX, triY);
-                    triangle.lineTo(triX + SQUARE_SIZE, triY);
-                    triangle.lineTo(triX, triY + SQUARE_SIZE);
-                    painter->fillPath(triangle, trailColor);
-                    break;
-
-                default:
-                    break;
-
-                }
-            }
-        }
-    }
-    for (int x = -(CLIENT_FRAME / 2); x <= (CLIENT_FRAME / 2); ++x)
-    {
-        for (int y = -(CLIENT_FRAME / 2); y <= (CLIENT_FRAME / 2); ++y)
-        {
-            ClientSquareState state = cgs.getState(x, y);
-
-            if(state.isOccupied() && state.getOccupyingPlayer())
-            {
-                Direction squarePlayer = state.getOccupyingPlayer()->getDirection();
-                int playerX = CTOP_X + x * SQUARE_SIZE + offset * getXOff(squarePlayer);
-                int playerY = CTOP_Y + y * SQUARE_SIZE + offset * getYOff(squarePlayer);
-
-                int textX = playerX + SQUARE_SIZE / 2 - fm.width(state.getOccupyingPlayer()->getName()) / 2;
-
-                painter->fillRect(playerX,
-                                  playerY,
-                                  SQUARE_SIZE,
-                                  SQUARE_SIZE,
-                                  playerColors[colorMap.value(state.getOccupyingPlayerId())][0]);
-
-                painter->setPen(QPen(playerColors[colorMap.value(state.getOccupyingPlayerId())][0]));
-                painter->drawText(textX, playerY - 10, state.getOccupyingPlayer()->getName());
-            }
-        }
-    }
-
-    // Leaderboard
-    const std::pair<plid_t, score_t> *leaderboard = cgs.getLeaderboard();
-    const int LEADERBOARD_HEIGHT = SQUARE_SIZE * 0.75;
-
-    font.setPixelSize(LEADERBOARD_HEIGHT * 0.70);
-    fm = QFontMetrics(font);
-    painter->setFont(font);
+    // The board squares come from the cache, scrolled by the offset.
+    layer.draw(cgs, painter, CTOP_X - (CLIENT_FRAME / 2) * SQUARE_SIZE, CTOP_Y - (CLIENT_FRAME / 2) * SQUARE_SIZE,
+               SQUARE_SIZE, colors);
 
-    for (int i = 0; i < 5; ++i)
+    // Players go on top of the board.
+    foreach (const ClientPlayer *player, cgs.getPlayers())
     {
-        const ClientPlayer *player = cgs.lookupPlayer(leaderboard[i].first);
-        if (!player)
+        if (!player->isVisible())
             continue;
 
-        double percent = leaderboard[i].second / static_cast<double>(cgs.getTotalSquares());
-        double width = 2 * (log(20 * percent + 0.5) - log(0.5));
-        width = SQUARE_SIZE * (2.5 + width);
-        int x = rect.x() + rect.width() - width;
-        int y = rect.y() + i * LEADERBOARD_HEIGHT;
-        painter->fillRect(x, y, width + 10, LEADERBOARD_HEIGHT, playerColors[colorMap.value(leaderboard[i].first)][1]);
-
-        painter->setPen(QPen(playerColors[colorMap.value(leaderboard[i].first)][2]));
-        painter->drawText(x + 0.25 * LEADERBOARD_HEIGHT,
-                          y + 0.75 * LEADERBOARD_HEIGHT,
-                          QString("%1 - %2% %3").arg(QString::number(i + 1), QString::number(100 * percent, 'f', (percent >= .1 ? 1 : 2)), player->getName()));
-
+        Direction squarePlayer = player->getDirection();
+        int playerX = CTOP_X + player->getX() * SQUARE_SIZE + offset * getXOff(squarePlayer);
+        int playerY = CTOP_Y + player->getY() * SQUARE_SIZE + offset * getYOff(squarePlayer);
+        const QColor &color = playerColors[colorMap.value(player->getId())][0];
+
+        painter->fillRect(playerX,
+                          playerY,
+                          SQUARE_SIZE,
+                          SQUARE_SIZE,
+                          color);
+        hud.drawName(painter, *player, playerX, playerY, color);
     }
 
-
-    // Player's score
-    double percent = cgs.getClient()->getScore() / static_cast<double>(cgs.getTotalSquares());
-    double width = 2 * (log(20 * percent + 0.5) - log(0.5));
-    QString tscore = QString("%1%").arg(QString::number(100 * percent, 'f', (percent >= .1 ? 1 : 2)));
-    double twidth = fm.width(tscore);
-    width = SQUARE_SIZE * (2.0 + width);
-    painter->fillRect(rect.x() - 10, rect.y(), width + 10, LEADERBOARD_HEIGHT, playerColors[colorMap.value(cgs.getClientId())][1]);
-
-    // Player's best score
-    // N.B. This is probably better to do at GameOver, but is just so much simpler to do here.
-    QSettings settings;
-    double best_percent = settings.value("best_score", 0).toDouble();
-    if (best_percent > 1) best_percent = 1;
-    else if (best_percent < 0) best_percent = 0;
-    else if (best_percent < percent)
-    {
-        best_percent = percent;
-        settings.setValue("best_score", best_percent);
-    }
-    QString best_score = GameOver::tr("Best Score: %2%").arg(QString::number(100 * best_percent, 'f', (percent >= .1 ? 1 : 2)));
-
-    painter->setPen(QPen(playerColors[colorMap.value(cgs.getClientId())][2]));
-    painter->drawText(rect.x() + width - 0.25 * LEADERBOARD_HEIGHT - twidth,
-                      rect.y() + 0.75 * LEADERBOARD_HEIGHT,
-                      tscore);
-    painter->setPen(QColor(0,0,0,85));
-    painter->drawText(rect.x() + 0.25 * LEADERBOARD_HEIGHT + 1,
-                      rect.y() + 1.75 * LEADERBOARD_HEIGHT + 1,
-                      best_score);
-    painter->setPen(QColor(0xFFFFFF));
-    painter->drawText(rect.x() + 0.25 * LEADERBOARD_HEIGHT,
-                      rect.y() + 1.75 * LEADERBOARD_HEIGHT,
-                      best_score);
+    // Leaderboard and score
+    hud.drawPanels(cgs, painter, rect, colors);
 
 	// Kiosk mode 2 watermark
 	if (cgs.kioskMode() != 2)
@@ -353,16 +508,17 @@ void renderGame(const ClientGameState &cgs, QPainter *painter, QPaintEvent *even
                       
 	static int kfs = -1;
 	int nkfs = SQUARE_SIZE * 3;
-	font = getFreshmanFont();
+	QFont font = getFreshmanFont();
 	font.setPixelSize(nkfs);
 	painter->setFont(font);
 	
-	QStaticText text = getTitleString();
-	QStaticText shadow = getTitleShadow();
+	QStaticText &text = getTitleString();
+	QStaticText &shadow = getTitleShadow();
 	if (nkfs != kfs)
 	{
 		text.prepare(painter->transform(), font);
 		shadow.prepare(painter->transform(), font);
+		kfs = nkfs;
 	}
 
 	painter->setPen(QColor(0, 0, 0, 85));
@@ -371,6 +527,68 @@ void renderGame(const ClientGameState &cgs, QPainter *painter, QPaintEvent *even
 }
 
 
+static QString formatHistogram(const char *name, const FrameHistogram &hist)
+{
+	return QString("%1  avg %2  p50 %3  p95 %4  p99 %5  max %6 ms")
+	       .arg(name)
+	       .arg(hist.getMean() / 1000.0, 5, 'f', 1)
+	       .arg(hist.getQuantile(0.5) / 1000.0, 5, 'f', 1)
+	       .arg(hist.getQuantile(0.95) / 1000.0, 5, 'f', 1)
+	       .arg(hist.getQuantile(0.99) / 1000.0, 5, 'f', 1)
+	       .arg(hist.getMax() / 1000.0, 5, 'f', 1);
+}
+
+void renderOverlay(const ClientGameState &cgs, const FrameHistogram &frames, const FrameHistogram &jitter, const TickClock &clock,
+                   QPainter *painter, const QRect &rect)
+{
+	const int LINE = 16;
+	const int PAD = 8;
+	const int GRAPH = 60;
+	const int BAR = 4;
+
+	QFont font = getDejaVuFont();
+	font.setPixelSize(12);
+	painter->setFont(font);
+
+	double fps = frames.getMean() ? 1e6 / frames.getMean() : 0;
+	QStringList lines;
+	lines << QString("%1 fps over %2 frames, tick period %3 ms")
+	         .arg(fps, 0, 'f', 1).arg(frames.getCount()).arg(clock.getPeriod() / 1e6, 0, 'f', 1);
+	lines << formatHistogram("frame ", frames);
+	lines << formatHistogram("jitter", jitter);
+	if (cgs.getRoundTrip() >= 0)
+		lines << QString("round trip %1 ms").arg(cgs.getRoundTrip() / 1e6, 0, 'f', 1);
+
+	const int width = FrameHistogram::BUCKETS * BAR + 2 * PAD;
+	const int height = lines.size() * LINE + GRAPH + 3 * PAD;
+	const int left = rect.x() + PAD;
+	const int top = rect.y() + rect.height() - height - PAD;
+	painter->fillRect(left, top, width, height, QColor(0, 0, 0, 170));
+
+	painter->setPen(QColor(0xFFFFFF));
+	for (int i = 0; i < lines.size(); ++i)
+		painter->drawText(left + PAD, top + PAD + (i + 1) * LINE - 4, lines[i]);
+
+	// The frame time histogram, scaled to its tallest bucket, with a mark at
+	// each multiple of a 60 Hz frame.
+	const int base = top + height - PAD;
+	quint32 tallest = 1;
+	for (int i = 0; i < FrameHistogram::BUCKETS; ++i)
+		tallest = std::max(tallest, frames.getBucket(i));
+	for (int i = 0; i < FrameHistogram::BUCKETS; ++i)
+	{
+		int h = GRAPH * frames.getBucket(i) / tallest;
+		if (h)
+			painter->fillRect(left + PAD + i * BAR, base - h, BAR - 1, h, QColor(0x66DD66));
+	}
+	painter->setPen(QColor(255, 255, 255, 100));
+	for (int us = 16667; us < FrameHistogram::BUCKETS * FrameHistogram::BUCKET_USECS; us += 16667)
+	{
+		int x = left + PAD + us * BAR / FrameHistogram::BUCKET_USECS;
+		painter->drawLine(x, base - GRAPH, x, base);
+	}
+}
+
 const uint8_t ARDUINO_COLORS[10][3] = { {207, 175,  90},   // Magenta
                                         {196, 174,  52},   // Red
                                         { 46, 120,  22},   // Green
@@ -395,8 +613,9 @@ void renderGameArduino(const ClientGameState &cgs, BufferGFX &gfx)
 	offset = std::min(offset - 1, 0);
 
 	const ClientPlayer *client = cgs.getClient();
-	int xoff = -1 * offset * getXOff(client->getDirection());
-	int yoff = -1 * offset * getYOff(client->getDirection());
+	Direction moving = client ? client->getDirection() : NONE;
+	int xoff = -1 * offset * getXOff(moving);
+	int yoff = -1 * offset * getYOff(moving);
 
 	for (int x = -9; x <= 9; ++x)
 	{
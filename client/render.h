@@ -5,13 +5,103 @@
 #ifndef RENDER_H
 #define RENDER_H
 
+#include <QFont>
+#include <QHash>
+#include <QImage>
 #include <QPainter>
 #include <QPaintEvent>
+#include <QStaticText>
 
 #include "buffergfx.h"
 #include "clientgamestate.h"
+#include "framehistogram.h"
+#include "tickclock.h"
 
-void renderGame(const ClientGameState &cgs, QPainter *painter, QPaintEvent *event);
+/*
+ * A cached image of the board squares, so a frame only has to repaint the
+ * squares which changed since the last one. The image is laid out like the
+ * ClientGameState's ring, so when the view moves only the new edge is
+ * repainted and the image is drawn in up to four pieces to unwrap it.
+ */
+class BoardLayer
+{
+public:
+	BoardLayer();
+
+	/*
+	 * Brings the image up to date and draws it with the top left square of
+	 * the view at (left, top). Colors is the color map's generation; when it
+	 * changes every square is repainted.
+	 */
+	void draw(const ClientGameState &cgs, QPainter *painter, int left, int top,
+	          int squareSize, quint32 colors);
+
+private:
+	QImage image;
+	int squareSize;
+	quint32 colors;
+	bool valid;
+	// What each square of the image currently shows, by board position.
+	state_t painted[CLIENT_FRAME][CLIENT_FRAME];
+
+	void paintSquare(QPainter &painter, int px, int py, state_t state);
+};
+
+/*
+ * Caches the text and the HUD. Player names are prepared once per name
+ * and size, and the leaderboard and score panels are drawn into images
+ * which are only redrawn when what they show changes.
+ */
+class HudLayer
+{
+public:
+	HudLayer();
+
+	/* Draws a player's name centered above the given square. */
+	void drawName(QPainter *painter, const ClientPlayer &player, int x, int y, const QColor &color);
+
+	/*
+	 * Draws the leaderboard and our score. Colors is the color map's
+	 * generation, as for BoardLayer::draw().
+	 */
+	void drawPanels(const ClientGameState &cgs, QPainter *painter, const QRect &rect, quint32 colors);
+
+	/* Must be called before anything else is drawn in a frame. */
+	void setSquareSize(int size);
+
+private:
+	int squareSize;
+	QFont nameFont;
+	int nameAscent;
+	QFont panelFont;
+	QHash<plid_t, QStaticText> names;
+
+	QImage leaderboardImage;
+	std::pair<plid_t, score_t> leaderboard[5];
+
+	QImage scoreImage;
+	score_t score;
+	double best;
+
+	quint32 colors;
+
+	void drawLeaderboard(const ClientGameState &cgs);
+	void drawScore(const ClientGameState &cgs);
+};
+
+/*
+ * Progress is how far the view is from the previous tick to the current
+ * one, from 0 to 1 (see TickClock::progress()).
+ */
+void renderGame(const ClientGameState &cgs, BoardLayer &layer, HudLayer &hud, double progress,
+                QPainter *painter, QPaintEvent *event);
+
+/*
+ * Draws the frame time and tick jitter statistics, and the round trip to
+ * the server, over the game.
+ */
+void renderOverlay(const ClientGameState &cgs, const FrameHistogram &frames, const FrameHistogram &jitter, const TickClock &clock,
+                   QPainter *painter, const QRect &rect);
 
 void renderGameArduino(const ClientGameState &cgs, BufferGFX &gfx);
 
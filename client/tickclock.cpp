@@ -0,0 +1,80 @@
+/*
+ * Implements TickClock
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "tickclock.h"
+
+// How much of each error is taken into the phase and into the period.
+// The period needs to move much more slowly than the phase, or the
+// network's jitter ends up in it.
+static const double PHASE_GAIN = 0.15;
+static const double PERIOD_GAIN = 0.01;
+
+// If we're this many ticks behind, something stalled and the old phase
+// means nothing any more.
+static const tick_t MAX_GAP = 8;
+
+TickClock::TickClock()
+{
+	reset();
+}
+
+void TickClock::reset()
+{
+	tick = 0;
+	locked = false;
+	start = 0;
+	period = 0;
+}
+
+qint64 TickClock::observe(tick_t nt, qint64 arrival, quint16 tickRate)
+{
+	// The server's tick rate is the length of a tick in milliseconds.
+	double nominal = std::max<quint16>(tickRate, 1) * 1e6;
+
+	if (!locked || nt <= tick || nt - tick > MAX_GAP)
+	{
+		tick = nt;
+		locked = true;
+		start = arrival;
+		period = nominal;
+		return 0;
+	}
+
+	tick_t gap = nt - tick;
+	double predicted = start + gap * period;
+	double error = arrival - predicted;
+	tick = nt;
+
+	// A tick more than a period off is a hiccup rather than drift, so
+	// take its phase as it is and leave the period alone.
+	if (std::abs(error) > period)
+	{
+		start = arrival;
+		return error;
+	}
+
+	start = predicted + PHASE_GAIN * error;
+	period = qBound(0.5 * nominal, period + PERIOD_GAIN * error / gap, 1.5 * nominal);
+	return error;
+}
+
+double TickClock::progress(qint64 now) const
+{
+	if (!locked)
+		return 1;
+	return qBound(0.0, (now - start) / period, 1.0);
+}
+
+tick_t TickClock::getTick() const
+{
+	return tick;
+}
+
+qint64 TickClock::getPeriod() const
+{
+	return period;
+}
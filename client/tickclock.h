@@ -0,0 +1,55 @@
+/*
+ * The clock the client interpolates movement against.
+ */
+
+#ifndef TICKCLOCK_H
+#define TICKCLOCK_H
+
+#include <QtGlobal>
+
+#include "types.h"
+
+/*
+ * Estimates when each tick started on the server from when the ticks
+ * arrive. Ticks arrive with whatever jitter the network adds, so rather
+ * than trusting each arrival the clock predicts the next one from the
+ * measured period and only nudges its phase and period towards where
+ * the tick actually showed up, like a phase-locked loop. Times are in
+ * nanoseconds on any monotonic timeline the caller likes.
+ */
+class TickClock
+{
+public:
+	TickClock();
+
+	/* Forgets everything, so the next tick observed starts the clock afresh. */
+	void reset();
+
+	/*
+	 * Tells the clock the given tick arrived at the given time. Returns
+	 * how much later than predicted it was, which is negative if it was
+	 * early and 0 if there was nothing to predict it from.
+	 */
+	qint64 observe(tick_t tick, qint64 arrival, quint16 tickRate);
+
+	/*
+	 * How far the display should be from the last observed tick to the
+	 * next one at the given time, from 0 to 1.
+	 */
+	double progress(qint64 now) const;
+
+	/* The last tick observed, or 0 if there hasn't been one. */
+	tick_t getTick() const;
+
+	/* The estimated tick period in nanoseconds. */
+	qint64 getPeriod() const;
+
+private:
+	tick_t tick;
+	bool locked;
+	// When the last observed tick is estimated to have arrived.
+	double start;
+	double period;
+};
+
+#endif // !TICKCLOCK_H
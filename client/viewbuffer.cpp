@@ -0,0 +1,27 @@
+/*
+ * Implements ViewBuffer
+ */
+
+#include "viewbuffer.h"
+
+ViewBuffer::ViewBuffer()
+	: back(0)
+	, front(1)
+	, middle(2)
+{
+}
+
+void ViewBuffer::publish(const ClientGameState &cgs)
+{
+	states[back].copyFrom(cgs);
+	// Whatever was in the middle is either stale or already drawn, so it
+	// becomes the next back copy.
+	back = middle.fetchAndStoreOrdered(back | FRESH) & ~FRESH;
+}
+
+const ClientGameState &ViewBuffer::latest()
+{
+	if (middle.loadAcquire() & FRESH)
+		front = middle.fetchAndStoreOrdered(front) & ~FRESH;
+	return states[front];
+}
@@ -0,0 +1,48 @@
+/*
+ * This hands copies of the game state from the IOHandler's thread to the
+ * renderers without either side waiting on the other.
+ */
+
+#ifndef VIEWBUFFER_H
+#define VIEWBUFFER_H
+
+#include <QAtomicInt>
+
+#include "clientgamestate.h"
+
+/*
+ * A triple buffer of ClientGameStates. The IOHandler copies the state into
+ * the back copy and swaps it with the middle one, while the renderers swap
+ * the middle copy with the front one whenever a newer state has been
+ * published. Neither side ever takes a lock, and the front copy is never
+ * touched by the IOHandler, so it can be drawn for as long as it takes.
+ */
+class ViewBuffer
+{
+public:
+	ViewBuffer();
+
+	/*
+	 * Publishes a copy of the given state. Must only be called from one
+	 * thread, with the state locked if anything else can change it.
+	 */
+	void publish(const ClientGameState &cgs);
+
+	/*
+	 * Returns the most recently published state. It stays valid and
+	 * unchanged until the next call to latest(), which must be made from
+	 * the same thread.
+	 */
+	const ClientGameState &latest();
+
+private:
+	// Set in middle when it holds a state the renderers haven't seen.
+	static const int FRESH = 4;
+
+	ClientGameState states[3];
+	int back;
+	int front;
+	QAtomicInt middle;
+};
+
+#endif // !VIEWBUFFER_H
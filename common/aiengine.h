@@ -0,0 +1,462 @@
+/*
+ * The AI shared by the server's AI players and the client's kiosk mode.
+ * It is a template over a board view so that it can read the server's
+ * GameState and the client's ClientGameState directly without any virtual
+ * calls or square objects in the way. A board view must provide:
+ *
+ *   plid_t getId() const;
+ *       The player we are steering.
+ *   pos_t getX() const;
+ *   pos_t getY() const;
+ *   Direction getDirection() const;
+ *       Where that player is and which way it is moving.
+ *   state_t getState(pos_t x, pos_t y) const;
+ *       The raw state of a square, or OUT_OF_BOUNDS_STATE if the square is
+ *       out of bounds (or out of view).
+ *   int getTerritoryDistance(pos_t x, pos_t y) const;
+ *       Moves from the square to our territory (see AI_UNREACHABLE).
+ *   int getEnemyHeadDistance(pos_t x, pos_t y) const;
+ *       Moves from the square to the nearest other player.
+ *
+ * Everything here is header only so that the board reads inline.
+ */
+
+#ifndef AIENGINE_H
+#define AIENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <QElapsedTimer>
+#include <QtCore>
+
+#include "protocol.h"
+#include "types.h"
+
+/* The distance reported when there is nothing to be found. */
+const int AI_UNREACHABLE = 0xFFFF;
+
+/*
+ * How much effort an AI puts into its next move. AI_FULL runs the search;
+ * AI_CHEAP follows a few simple rules, which is fine for AIs nobody is
+ * watching.
+ */
+enum AIDetail {
+	AI_FULL,
+	AI_CHEAP,
+};
+
+/*
+ * Inline accessors for the fields packed into a state_t. These match the
+ * layout SquareState and ClientSquareState decode.
+ */
+inline TrailType getStateTrailType(state_t s)
+{
+	return TrailType(s & 0x07);
+}
+
+inline plid_t getStateTrailPlayer(state_t s)
+{
+	return static_cast<plid_t>((s & 0xFF00) >> 8);
+}
+
+inline plid_t getStateOccupyingPlayer(state_t s)
+{
+	return static_cast<plid_t>((s & 0xFF0000) >> 16);
+}
+
+inline plid_t getStateOwningPlayer(state_t s)
+{
+	return static_cast<plid_t>((s & 0xFF000000) >> 24);
+}
+
+/*
+ * Computes the taxicab distance from every square of a width by height
+ * grid to the nearest square for which isSource(x, y) is true, capped at
+ * AI_UNREACHABLE. This is two raster passes: the first sweeps top-left to
+ * bottom-right pulling from the left and upper neighbours, the second
+ * sweeps back pulling from the right and lower neighbours. Every shortest
+ * path on the grid can be reordered into moves the two passes follow, so
+ * this is exact while only ever walking memory in order.
+ */
+template <class IsSource>
+void aiDistanceTransform(quint16 *field, int width, int height, IsSource isSource)
+{
+	for (int y = 0; y < height; ++y)
+	{
+		quint16 *out = field + y * width;
+		for (int x = 0; x < width; ++x)
+		{
+			int d = isSource(x, y) ? 0 : AI_UNREACHABLE;
+			if (x > 0)
+				d = std::min(d, out[x - 1] + 1);
+			if (y > 0)
+				d = std::min(d, out[x - width] + 1);
+			out[x] = quint16(std::min(d, AI_UNREACHABLE));
+		}
+	}
+
+	for (int y = height - 1; y >= 0; --y)
+	{
+		quint16 *out = field + y * width;
+		for (int x = width - 1; x >= 0; --x)
+		{
+			int d = out[x];
+			if (x < width - 1)
+				d = std::min(d, out[x + 1] + 1);
+			if (y < height - 1)
+				d = std::min(d, out[x + width] + 1);
+			out[x] = quint16(std::min(d, AI_UNREACHABLE));
+		}
+	}
+}
+
+/*
+ * Search parameters. Without a time budget we always search to
+ * AI_DEFAULT_DEPTH moves past the first. With one, we deepen from
+ * AI_MIN_DEPTH (which is always finished) for as long as the budget
+ * allows.
+ */
+const int AI_DEFAULT_DEPTH = 6;
+const int AI_MIN_DEPTH = 2;
+const int AI_MAX_DEPTH = 8;
+// The furthest square from us the search can reach, and the window of
+// squares around us it can reach.
+const int AI_SEARCH_REACH = AI_MAX_DEPTH + 1;
+const int AI_SEARCH_WINDOW = 2 * AI_SEARCH_REACH + 1;
+// How many squares we assess between looking at the clock.
+const int AI_CLOCK_INTERVAL = 128;
+// Territory further than this is treated as being this far away.
+const int AI_HORIZON = 2 * CLIENT_FRAME;
+// The cheap policy heads home once its trail is this long, and otherwise
+// turns left every so many moves so that it draws small loops.
+const int AI_CHEAP_TRAIL = 12;
+const int AI_CHEAP_SIDE = 4;
+
+/*
+ * Scratch space for the search, shared by every AI which runs on a
+ * thread so that we never allocate during a move.
+ *
+ * assessDirection() only depends on its arguments (the board is fixed
+ * while we decide), which lets us remember its results. Entries are keyed
+ * by remaining depth, trail length relative to the trail length at the
+ * start of the move, direction, and position relative to us. Since the key
+ * is the remaining depth, each round of deepening reuses what the previous
+ * rounds worked out. An entry is valid if its stamp matches the current
+ * generation, so starting a new search is just a matter of bumping the
+ * generation.
+ */
+struct AIScratch
+{
+	quint32 generation;
+	quint32 stamp[AI_MAX_DEPTH + 1][AI_MAX_DEPTH + 1][4][AI_SEARCH_WINDOW][AI_SEARCH_WINDOW];
+	double value[AI_MAX_DEPTH + 1][AI_MAX_DEPTH + 1][4][AI_SEARCH_WINDOW][AI_SEARCH_WINDOW];
+
+	static AIScratch &get()
+	{
+		static thread_local std::unique_ptr<AIScratch> scratch;
+		if (!scratch)
+		{
+			scratch.reset(new AIScratch);
+			scratch->generation = 0;
+			scratch->clear();
+		}
+		return *scratch;
+	}
+
+	void nextGeneration()
+	{
+		if (++generation == 0)
+		{
+			clear();
+			generation = 1;
+		}
+	}
+
+	void clear()
+	{
+		std::fill(&stamp[0][0][0][0][0], &stamp[0][0][0][0][0] + sizeof(stamp) / sizeof(quint32), 0);
+	}
+};
+
+template <class BoardView>
+class AIEngine
+{
+public:
+	AIEngine()
+		: traillen(0)
+		, lastDepth(0)
+		, detail(AI_FULL)
+		, view(Q_NULLPTR)
+		, scratch(Q_NULLPTR)
+		, id(NULL_ID)
+		, ox(0)
+		, oy(0)
+		, clock()
+		, deadline(0)
+		, nodes(0)
+		, outOfTime(false)
+	{
+	}
+
+	void setDetail(AIDetail dt)
+	{
+		detail = dt;
+	}
+
+	/* How many moves ahead the last call to tick() looked. */
+	int getLastDepth() const
+	{
+		return lastDepth;
+	}
+
+	/*
+	 * Picks our next move. This must be called once per tick, as it keeps
+	 * track of how long our trail is.
+	 *
+	 * If budget (in nanoseconds) is positive, the search deepens for as
+	 * long as the budget allows and returns the move from the deepest
+	 * search it finished. A shallow search is always finished, so the
+	 * budget can be overrun slightly. Otherwise it searches to a fixed
+	 * depth.
+	 */
+	Direction tick(const BoardView &bv, qint64 budget = 0)
+	{
+		Direction d = bv.getDirection();
+		if (d == Direction::NONE)
+			return Direction::NONE;
+
+		view = &bv;
+		id = bv.getId();
+		ox = bv.getX();
+		oy = bv.getY();
+
+		if (getStateOwningPlayer(bv.getState(ox, oy)) == id)
+			traillen = 0;
+		else
+			++traillen;
+
+		Direction best = detail == AI_CHEAP ? tickCheap(d) : search(d, budget);
+		view = Q_NULLPTR;
+		return best;
+	}
+
+private:
+	// Persistent state.
+	int traillen;
+	int lastDepth;
+	AIDetail detail;
+
+	// Only valid during tick().
+	const BoardView *view;
+	AIScratch *scratch;
+	plid_t id;
+	pos_t ox;
+	pos_t oy;
+
+	// Search budget bookkeeping. A deadline of 0 means no limit.
+	QElapsedTimer clock;
+	qint64 deadline;
+	int nodes;
+	bool outOfTime;
+
+	Direction search(Direction d, qint64 budget)
+	{
+		if (budget > 0)
+			clock.start();
+		nodes = 0;
+		outOfTime = false;
+		// The first round always runs to completion.
+		deadline = 0;
+		scratch = &AIScratch::get();
+		scratch->nextGeneration();
+
+		Direction ld = Direction((d % 4) + 1);
+		Direction rd = Direction(((d + 2) % 4) + 1);
+		Direction best = d;
+
+		for (int depth = budget > 0 ? AI_MIN_DEPTH : AI_DEFAULT_DEPTH; depth <= AI_MAX_DEPTH; ++depth)
+		{
+			double straight = assessDirection(d, ox + getXOff(d), oy + getYOff(d), traillen, depth);
+			double left = assessDirection(ld, ox + getXOff(ld), oy + getYOff(ld), traillen, depth);
+			double right = assessDirection(rd, ox + getXOff(rd), oy + getYOff(rd), traillen, depth);
+
+			// An unfinished round can't be trusted, so stick with the last one.
+			if (outOfTime)
+				break;
+
+			if (straight >= left && straight >= right)
+				best = d;
+			else if (left >= straight && left >= right)
+				best = ld;
+			else
+				best = rd;
+			lastDepth = depth;
+
+			if (budget <= 0)
+				break;
+			deadline = budget;
+		}
+
+		scratch = Q_NULLPTR;
+		return best;
+	}
+
+	double assessDirection(Direction d, pos_t x, pos_t y, int tl, int recurse)
+	{
+		// Every square is reached by many different paths, so look up
+		// whether we've already assessed it in this state.
+		int rx = x - ox + AI_SEARCH_REACH;
+		int ry = y - oy + AI_SEARCH_REACH;
+		int rtl = tl - traillen;
+		quint32 *stamp = Q_NULLPTR;
+		double *memo = Q_NULLPTR;
+		if (0 <= recurse && recurse <= AI_MAX_DEPTH && 0 <= rtl && rtl <= AI_MAX_DEPTH
+		                 && 0 <= rx && rx < AI_SEARCH_WINDOW && 0 <= ry && ry < AI_SEARCH_WINDOW && d != NONE)
+		{
+			stamp = &scratch->stamp[recurse][rtl][d - 1][ry][rx];
+			memo = &scratch->value[recurse][rtl][d - 1][ry][rx];
+			if (*stamp == scratch->generation)
+				return *memo;
+		}
+
+		// Once we're out of time the result doesn't matter, we just need to
+		// get out of here quickly.
+		if (outOfTime)
+			return 0;
+		if (deadline && ++nodes % AI_CLOCK_INTERVAL == 0 && clock.nsecsElapsed() > deadline)
+		{
+			outOfTime = true;
+			return 0;
+		}
+
+		double ret = assessSquare(d, x, y, tl, recurse);
+		if (stamp && !outOfTime)
+		{
+			*stamp = scratch->generation;
+			*memo = ret;
+		}
+		return ret;
+	}
+
+	double assessSquare(Direction d, pos_t x, pos_t y, int tl, int recurse)
+	{
+		state_t state = view->getState(x, y);
+		plid_t owner = getStateOwningPlayer(state);
+		plid_t trail = getStateTrailPlayer(state);
+		plid_t occupant = getStateOccupyingPlayer(state);
+
+		// Penalize dangerous actions
+		if (owner == OUT_OF_BOUNDS)
+			return 0;
+		if (trail == id)
+			return 0;
+		if (occupant != UNOCCUPIED && occupant != id)
+			return 0;
+
+		// The distance must be clamped: with no territory left it is
+		// AI_UNREACHABLE, and exp() of that is infinite, which would make
+		// every safe square score worse than dying. The old search gave up
+		// 15 squares out and then scored the square as if it were home, so
+		// the pull home vanished just when we needed it most; the fields
+		// see the whole board, so we let it keep growing to AI_HORIZON.
+		int dist = std::min(view->getTerritoryDistance(x, y), AI_HORIZON);
+		double ret = 10 - exp(dist / 8);
+
+		// Assess the trail probability. This is either a good or bad
+		// thing depending on how aggressibe we are.
+		if (getStateTrailType(state) != NOTRAIL && trail != id)
+			ret += 1000;
+
+		// We like to complete trails of length 10, so return a value
+		// which gets large quickly around 10 and then tapers off.
+		if (owner == id)
+		{
+			// Double our aggressiveness twoards players in our territory.
+			ret *= 2;
+
+			if (tl > 0)
+			{
+				const int FALLOFF = 10;
+				double xp = tl > FALLOFF ? tl - FALLOFF : 4 * (tl - FALLOFF);
+				if (traillen > 1.5 * FALLOFF)
+					xp = tl - traillen;
+				double coef = exp(-(xp * xp));
+				return ret + coef * 1000;
+			}
+		} else {
+			++tl;
+
+			// Incentive to leave our territory.
+			ret += exp(-(tl - 2) * (tl - 2)) * 750;
+
+			// This square becomes part of our trail, so we're in danger if an
+			// enemy can reach it before we can get back home.
+			int threat = view->getEnemyHeadDistance(x, y);
+			if (threat <= dist)
+				ret -= 500.0 / (threat + 1);
+		}
+
+		// At this point, we recurse to assess the surrounding state.
+		if (recurse > 0)
+		{
+			// Check ahead.
+			ret += 0.2 * assessDirection(d, x + getXOff(d), y + getYOff(d), tl, recurse - 1);
+			// Check left.
+			Direction nd = Direction ((d % 4) + 1);
+			ret += 0.15 * assessDirection(nd, x + getXOff(nd), y + getYOff(nd), tl, recurse - 1);
+
+			// Check right.
+			nd = Direction (((d + 2) % 4) + 1);
+			ret += 0.15 * assessDirection(nd, x + getXOff(nd), y + getYOff(nd), tl, recurse - 1);
+		}
+
+		return ret;
+	}
+
+	Direction tickCheap(Direction d)
+	{
+		lastDepth = 0;
+
+		Direction options[3] = { d, Direction((d % 4) + 1), Direction(((d + 2) % 4) + 1) };
+		bool goHome = traillen >= AI_CHEAP_TRAIL
+		           || (traillen > 0 && view->getEnemyHeadDistance(ox, oy) <= view->getTerritoryDistance(ox, oy) + 2);
+		bool turn = traillen % AI_CHEAP_SIDE == AI_CHEAP_SIDE - 1;
+
+		Direction best = d;
+		int bestScore = std::numeric_limits<int>::min();
+		for (Direction o : options)
+		{
+			pos_t nx = ox + getXOff(o);
+			pos_t ny = oy + getYOff(o);
+			state_t state = view->getState(nx, ny);
+			plid_t occupant = getStateOccupyingPlayer(state);
+			if (getStateOwningPlayer(state) == OUT_OF_BOUNDS || getStateTrailPlayer(state) == id
+			                                                 || (occupant != UNOCCUPIED && occupant != id))
+				continue;
+
+			int home = std::min(view->getTerritoryDistance(nx, ny), AI_HORIZON);
+			int score = 0;
+			if (goHome)
+				score -= 4 * home;
+			else if (o == (turn ? options[1] : d))
+				score += 2;
+
+			if (getStateTrailType(state) != NOTRAIL)
+				score += 10;
+			if (home && view->getEnemyHeadDistance(nx, ny) <= home)
+				score -= 3;
+
+			if (score > bestScore)
+			{
+				bestScore = score;
+				best = o;
+			}
+		}
+
+		return best;
+	}
+};
+
+#endif // !AIENGINE_H
@@ -0,0 +1,49 @@
+/*
+ * Hello packet. Asks the server which capabilities it has. It is empty, so servers which
+ * predate capabilities skip it.
+ *
+ * Spec: <PACKET_HELLO>
+ * Direction: Client to Server
+ *
+ * Capabilities packet. The answer to a PACKET_HELLO: the capabilities the server can use
+ * and the version of its TickCoder tables.
+ *
+ * Spec: <PACKET_CAPABILITIES> <quint32: capabilities> <quint16: TickCoder::VERSION>
+ * Direction: Server to Client
+ */
+
+#include "protocol.h"
+
+PacketCapabilities::PacketCapabilities()
+	: Packet(PACKET_CAPABILITIES)
+	, caps(0)
+	, codesVersion(0)
+{
+}
+
+PacketCapabilities::PacketCapabilities(quint32 cp, quint16 cv)
+	: Packet(PACKET_CAPABILITIES)
+	, caps(cp)
+	, codesVersion(cv)
+{
+}
+
+quint32 PacketCapabilities::getCapabilities() const
+{
+	return caps;
+}
+
+quint16 PacketCapabilities::getCodesVersion() const
+{
+	return codesVersion;
+}
+
+void PacketCapabilities::read(QDataStream &str)
+{
+	str >> caps >> codesVersion;
+}
+
+void PacketCapabilities::write(QDataStream &str) const
+{
+	str << caps << codesVersion;
+}
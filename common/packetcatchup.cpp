@@ -0,0 +1,149 @@
+/*
+ * Request Catchup packet. Asks the server to bring the client's board up to date from the
+ * last tick whose checksum matched, after a checksum failure. The server answers with a
+ * PACKET_CATCHUP, or with a PACKET_RESEND_BOARD if it no longer has the ticks since then.
+ *
+ * Spec: <PACKET_REQUEST_CATCHUP> <tick_t: last good tick>
+ * Direction: Client to Server
+ *
+ * Catchup packet. The difference between the client's board as of the tick it asked to be
+ * caught up from and the board now. The client first moves its view by the given offset;
+ * the squares this brings into view start out as 0. The diff is then XORed in as with
+ * PACKET_GAME_TICK.
+ *
+ * Spec: <PACKET_CATCHUP> <tick_t: current tick> <tick_t: caught up from>
+ *       <qint8: x offset> <qint8: y offset>
+ *       {<quint8>}[RLE encoded XOR difference of the moved board, L to R, T to B]
+ *       <quint64: a 64 bit crc of the new board state>
+ * Direction: Server to Client
+ */
+
+#include "protocol.h"
+
+PacketRequestCatchup::PacketRequestCatchup()
+	: Packet(PACKET_REQUEST_CATCHUP)
+	, tick(0)
+{
+}
+
+PacketRequestCatchup::PacketRequestCatchup(tick_t tck)
+	: Packet(PACKET_REQUEST_CATCHUP)
+	, tick(tck)
+{
+}
+
+tick_t PacketRequestCatchup::getTick() const
+{
+	return tick;
+}
+
+void PacketRequestCatchup::setTick(tick_t tck)
+{
+	tick = tck;
+}
+
+void PacketRequestCatchup::read(QDataStream &str)
+{
+	str >> tick;
+}
+
+void PacketRequestCatchup::write(QDataStream &str) const
+{
+	str << tick;
+}
+
+PacketCatchup::PacketCatchup()
+	: PacketCatchup(0, 0, 0, 0)
+{
+}
+
+PacketCatchup::PacketCatchup(packet_t pid)
+	: Packet(pid)
+	, tick(0)
+	, from(0)
+	, dx(0)
+	, dy(0)
+{
+	std::fill(data[0], data[0] + CLIENT_FRAME * CLIENT_FRAME, 0);
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		rows[i] = data[i];
+}
+
+PacketCatchup::PacketCatchup(tick_t tck, tick_t frm, qint8 x, qint8 y)
+	: PacketCatchup(PACKET_CATCHUP)
+{
+	tick = tck;
+	from = frm;
+	dx = x;
+	dy = y;
+}
+
+tick_t PacketCatchup::getTick() const
+{
+	return tick;
+}
+
+void PacketCatchup::setTick(tick_t tck)
+{
+	tick = tck;
+}
+
+tick_t PacketCatchup::getFrom() const
+{
+	return from;
+}
+
+void PacketCatchup::setFrom(tick_t frm)
+{
+	from = frm;
+}
+
+qint8 PacketCatchup::getXOffset() const
+{
+	return dx;
+}
+
+qint8 PacketCatchup::getYOffset() const
+{
+	return dy;
+}
+
+void PacketCatchup::setOffset(qint8 x, qint8 y)
+{
+	dx = x;
+	dy = y;
+}
+
+const state_t *const *PacketCatchup::getDiff() const
+{
+	return rows;
+}
+
+state_t *const *PacketCatchup::getDiff()
+{
+	return rows;
+}
+
+QByteArray PacketCatchup::getChecksum() const
+{
+	return chksum;
+}
+
+void PacketCatchup::setChecksum(const QByteArray &chk)
+{
+	chksum = chk;
+}
+
+void PacketCatchup::read(QDataStream &str)
+{
+	str >> tick >> from >> dx >> dy;
+	readDiff(str, rows);
+	str >> chksum;
+}
+
+void PacketCatchup::write(QDataStream &str) const
+{
+	str << tick << from << dx << dy;
+	writeDiff(str, rows);
+	str << chksum;
+}
@@ -9,12 +9,31 @@
  *       <contents of PACKET_LEADERBOARD_UPDATE>
  *       <contents of PACKET_RESEND_BOARD>
  * Direction: Server to Client
+ *
+ * Game Join With Capabilities packet. The same with the capabilities the server picked
+ * in front, for clients which sent a PACKET_REQUEST_JOIN_CAPS. With CAP_PACKED_BOARDS, the
+ * updates are compressed by qCompress() and the board is packed.
+ *
+ * Spec: <PACKET_GAME_JOIN_CAPS> <quint32: capabilities> <quint8: id> <quint8: score>
+ *       <contents of PACKET_PLAYERS_UPDATE>
+ *       <contents of PACKET_LEADERBOARD_UPDATE>
+ *       <contents of PACKET_RESEND_BOARD>
+ *     or with CAP_PACKED_BOARDS:
+ *       <QByteArray: qCompress()ed <contents of PACKET_PLAYERS_UPDATE> <contents of PACKET_LEADERBOARD_UPDATE>>
+ *       <contents of PACKET_PACKED_BOARD>
+ * Direction: Server to Client
  */
 
+#include <QtCore>
 #include "protocol.h"
 
 PacketGameJoin::PacketGameJoin()
-	: Packet(PACKET_GAME_JOIN)
+	: PacketGameJoin(PACKET_GAME_JOIN)
+{
+}
+
+PacketGameJoin::PacketGameJoin(packet_t pid)
+	: Packet(pid)
 	, plid(NULL_ID)
 	, score(0)
 	, total(0)
@@ -24,6 +43,18 @@ PacketGameJoin::PacketGameJoin()
 {
 }
 
+PacketGameJoin::PacketGameJoin(packet_t pid, const PacketGameJoin &other)
+	: Packet(pid)
+	, plid(other.plid)
+	, score(other.score)
+	, total(other.total)
+	, tickRate(other.tickRate)
+	, ppu(other.ppu)
+	, plu(other.plu)
+	, prb(other.prb)
+{
+}
+
 PacketGameJoin::PacketGameJoin(plid_t id, score_t sc, quint16 ts, quint16 tr, const PacketPlayersUpdate &ppuc, const PacketLeaderboardUpdate &pluc, const PacketResendBoard &prbc)
 	: Packet(PACKET_GAME_JOIN)
 	, plid(id)
@@ -115,3 +146,72 @@ void PacketGameJoin::write(QDataStream &str) const
 {
 	str << plid << score << total << tickRate << ppu << plu << prb;
 }
+
+void PacketGameJoin::readPacked(QDataStream &str)
+{
+	QByteArray packed;
+	PacketPackedBoard ppb;
+	str >> plid >> score >> total >> tickRate >> packed >> ppb;
+	if (str.status() != QDataStream::Ok)
+		return;
+	prb = ppb;
+
+	// Don't fail the stream over this. The players and leaderboard are
+	// only empty until their next updates.
+	QByteArray updates = qUncompress(packed);
+	QDataStream ustr(updates);
+	ustr.setVersion(str.version());
+	ustr >> ppu >> plu;
+	if (ustr.status() != QDataStream::Ok)
+	{
+		qWarning() << "Game join updates did not unpack";
+		ppu = PacketPlayersUpdate();
+		plu = PacketLeaderboardUpdate();
+	}
+}
+
+void PacketGameJoin::writePacked(QDataStream &str) const
+{
+	QByteArray updates;
+	QDataStream ustr(&updates, QIODevice::WriteOnly);
+	ustr.setVersion(str.version());
+	ustr << ppu << plu;
+
+	// The fastest level still gets most of the names.
+	str << plid << score << total << tickRate << qCompress(updates, 1) << PacketPackedBoard(prb);
+}
+
+PacketGameJoinCaps::PacketGameJoinCaps()
+	: PacketGameJoin(PACKET_GAME_JOIN_CAPS)
+	, caps(0)
+{
+}
+
+PacketGameJoinCaps::PacketGameJoinCaps(quint32 cp, const PacketGameJoin &pgj)
+	: PacketGameJoin(PACKET_GAME_JOIN_CAPS, pgj)
+	, caps(cp)
+{
+}
+
+quint32 PacketGameJoinCaps::getCapabilities() const
+{
+	return caps;
+}
+
+void PacketGameJoinCaps::read(QDataStream &str)
+{
+	str >> caps;
+	if (caps & CAP_PACKED_BOARDS)
+		readPacked(str);
+	else
+		PacketGameJoin::read(str);
+}
+
+void PacketGameJoinCaps::write(QDataStream &str) const
+{
+	str << caps;
+	if (caps & CAP_PACKED_BOARDS)
+		writePacked(str);
+	else
+		PacketGameJoin::write(str);
+}
@@ -1,21 +1,34 @@
 /*
  * Game Tick packet. Informs the client of a server tick and change in board state.
  *
+ * If the high bit of direction_moved is set (TICK_TIMESTAMPED), the server's monotonic
+ * clock in nanoseconds when it sent the tick follows the score. The server only sets it for
+ * clients which have sent a PACKET_TIME_SYNC.
+ *
+ * If TICK_CODED is set, the new row and the difference are coded together by TickCoder
+ * instead, for clients the server agreed CAP_CODED_TICKS with. A coding which doesn't decode
+ * leaves the board unchanged and the checksum empty, so the client asks for repairs.
+ *
  * Spec: <PACKET_GAME_TICK> <tick_t: current tick> <quint8: direction_moved> <quint8: score>
+ *       [<qint64: timestamp>]
  *       {<quint32: board_state>}[CLIENT_FRAME times, the new row visible either L to R or T to B depending on direction]
  *       {<quint8>}[RLE encoded XOR difference of existing board, L to R, T to B]
+ *         or, if coded, <quint16: length> {<quint8>}[length times, the coded row and difference]
  *       <quint64: a 64 bit crc of the new board state>
  * Direction: Server to Client
  */
 
 #include <QtCore>
 #include "protocol.h"
+#include "tickcoder.h"
 
 PacketGameTick::PacketGameTick()
 	: Packet(PACKET_GAME_TICK)
 	, tick(0)
 	, dir(0)
 	, score(0)
+	, timestamp(-1)
+	, coded(false)
 	, alloc(true)
 	, chksum(0)
 {
@@ -29,6 +42,8 @@ PacketGameTick::PacketGameTick(tick_t tck, Direction dr, score_t sc, const state
 	, tick(tck)
 	, dir(dr)
 	, score(sc)
+	, timestamp(-1)
+	, coded(false)
 	, alloc(false)
 	, chksum(chk)
 {
@@ -41,6 +56,8 @@ PacketGameTick::PacketGameTick(const PacketGameTick &other)
 	, tick(other.tick)
 	, dir(other.dir)
 	, score(other.score)
+	, timestamp(other.timestamp)
+	, coded(other.coded)
 	, alloc(other.alloc)
 	, chksum(other.chksum)
 {
@@ -68,6 +85,8 @@ PacketGameTick &PacketGameTick::operator =(const PacketGameTick &other)
 	tick = other.tick;
 	dir = other.dir;
 	score = other.score;
+	timestamp = other.timestamp;
+	coded = other.coded;
 
 	chksum = other.chksum;
 
@@ -130,6 +149,16 @@ void PacketGameTick::setScore(score_t sc)
 	score = sc;
 }
 
+qint64 PacketGameTick::getTimestamp() const
+{
+	return timestamp;
+}
+
+void PacketGameTick::setTimestamp(qint64 ts)
+{
+	timestamp = ts;
+}
+
 const state_t *PacketGameTick::getNewSection() const
 {
 	return news;
@@ -175,59 +204,81 @@ QByteArray PacketGameTick::getChecksum() const
 	return chksum;
 }
 
-/*
- * The diffs are RLE encoded. This means we write a byte
- * indicating "quantity" and then a quint32 which will be
- * repeated "quantity" times.
- */
+bool PacketGameTick::isCoded() const
+{
+	return coded;
+}
+
+void PacketGameTick::setCoded(bool cd)
+{
+	coded = cd;
+}
+
 void PacketGameTick::read(QDataStream &str)
 {
 	str >> tick >> dir >> score;
 
-	for (int i = 0; i < CLIENT_FRAME; ++i)
-		str >> news[i];
+	timestamp = -1;
+	if (dir & TICK_TIMESTAMPED)
+	{
+		str >> timestamp;
+		dir &= ~TICK_TIMESTAMPED;
+	}
 
-	quint8 count = 0;
-	state_t cv = 0;
-	for (int i = 0; i < CLIENT_FRAME; ++i)
+	coded = dir & TICK_CODED;
+	dir &= ~TICK_CODED;
+
+	if (!coded)
 	{
-		for (int j = 0; j < CLIENT_FRAME; ++j)
-		{
-			if (count == 0)
-				str >> count >> cv;
+		for (int i = 0; i < CLIENT_FRAME; ++i)
+			str >> news[i];
 
-			diff[i][j] = cv;
-			count--;
-		}
+		readDiff(str, diff);
+
+		str >> chksum;
+		return;
 	}
 
+	quint16 len;
+	str >> len;
+	QByteArray data(len, 0);
+	if (str.readRawData(data.data(), len) != len)
+	{
+		str.setStatus(QDataStream::ReadPastEnd);
+		return;
+	}
 	str >> chksum;
+
+	// Don't fail the stream over this; the checksum tells the client
+	// something is wrong and it recovers as it would from any bad tick.
+	if (str.status() == QDataStream::Ok && !TickCoder::decode(data, news, CLIENT_FRAME, diff))
+	{
+		qWarning() << "Tick" << tick << "did not decode";
+		std::fill(news, news + CLIENT_FRAME, 0);
+		for (int i = 0; i < CLIENT_FRAME; i++)
+			std::fill(diff[i], diff[i] + CLIENT_FRAME, 0);
+		chksum.clear();
+	}
 }
 
 void PacketGameTick::write(QDataStream &str) const
 {
-	str << tick << dir << score;
-	for (int i = 0; i < CLIENT_FRAME; ++i)
-		str << news[i];
+	quint8 flags = (timestamp >= 0 ? TICK_TIMESTAMPED : 0) | (coded ? TICK_CODED : 0);
+	str << tick << static_cast<quint8>(dir | flags) << score;
+	if (timestamp >= 0)
+		str << timestamp;
 
-	quint8 count = 0;
-	state_t cv = diff[0][0];
-	for (int i = 0; i < CLIENT_FRAME; ++i)
+	if (coded)
 	{
-		for (int j = 0; j < CLIENT_FRAME; ++j)
-		{
-			if (diff[i][j] != cv || count >= static_cast<quint8>(count + 1))
-			{
-				str << count << cv;
-
-				count = 0;
-				cv = diff[i][j];
-			}
+		QByteArray data = TickCoder::encode(news, CLIENT_FRAME, diff);
+		str << static_cast<quint16>(data.size());
+		str.writeRawData(data.constData(), data.size());
+	} else {
+		for (int i = 0; i < CLIENT_FRAME; ++i)
+			str << news[i];
 
-			++count;
-		}
+		writeDiff(str, diff);
 	}
-	str << count << cv;
 
 	str << chksum;
 }
@@ -0,0 +1,130 @@
+/*
+ * Request Rows packet. Sent instead of asking for the whole board when the client's
+ * checksum disagrees with the server's. Carries a hashRow() of each row of the client's
+ * view, so the server can send only the rows which are wrong.
+ *
+ * Spec: <PACKET_REQUEST_ROWS> <tick_t: the client's tick>
+ *       {<quint32: row hash>}[CLIENT_FRAME times, T to B]
+ * Direction: Client to Server
+ *
+ * Partial Board packet. The rows of the client's view which disagreed with the server,
+ * as of the current tick. Every tick since the one the hashes were from has moved the
+ * same wrong squares, so these are the rows they are in now. Answered with a
+ * PACKET_RESEND_BOARD instead if the server can't tell which rows are wrong.
+ *
+ * Spec: <PACKET_PARTIAL_BOARD> <tick_t: current tick> <quint32: bit i set if row i is sent>
+ *       {<state_t: board state>}[CLIENT_FRAME times for each row sent, L to R, T to B]
+ *       <quint64: a 64 bit crc of the whole board state>
+ * Direction: Server to Client
+ */
+
+#include "protocol.h"
+
+PacketRequestRows::PacketRequestRows()
+	: Packet(PACKET_REQUEST_ROWS)
+	, tick(0)
+{
+	std::fill(hashes, hashes + CLIENT_FRAME, 0);
+}
+
+PacketRequestRows::PacketRequestRows(tick_t tck, const quint32 *hsh)
+	: Packet(PACKET_REQUEST_ROWS)
+	, tick(tck)
+{
+	std::copy(hsh, hsh + CLIENT_FRAME, hashes);
+}
+
+tick_t PacketRequestRows::getTick() const
+{
+	return tick;
+}
+
+const quint32 *PacketRequestRows::getHashes() const
+{
+	return hashes;
+}
+
+void PacketRequestRows::read(QDataStream &str)
+{
+	str >> tick;
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		str >> hashes[i];
+}
+
+void PacketRequestRows::write(QDataStream &str) const
+{
+	str << tick;
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		str << hashes[i];
+}
+
+PacketPartialBoard::PacketPartialBoard()
+	: PacketPartialBoard(0)
+{
+}
+
+PacketPartialBoard::PacketPartialBoard(tick_t tck)
+	: Packet(PACKET_PARTIAL_BOARD)
+	, tick(tck)
+	, mask(0)
+{
+}
+
+tick_t PacketPartialBoard::getTick() const
+{
+	return tick;
+}
+
+bool PacketPartialBoard::hasRow(int r) const
+{
+	return mask & (1u << r);
+}
+
+const state_t *PacketPartialBoard::getRow(int r) const
+{
+	return rows[r];
+}
+
+void PacketPartialBoard::setRow(int r, const state_t *row)
+{
+	std::copy(row, row + CLIENT_FRAME, rows[r]);
+	mask |= 1u << r;
+}
+
+int PacketPartialBoard::getRowCount() const
+{
+	int count = 0;
+	for (int r = 0; r < CLIENT_FRAME; r++)
+		count += hasRow(r);
+	return count;
+}
+
+QByteArray PacketPartialBoard::getChecksum() const
+{
+	return chksum;
+}
+
+void PacketPartialBoard::setChecksum(const QByteArray &checksum)
+{
+	chksum = checksum;
+}
+
+void PacketPartialBoard::read(QDataStream &str)
+{
+	str >> tick >> mask;
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		if (hasRow(i))
+			for (int j = 0; j < CLIENT_FRAME; j++)
+				str >> rows[i][j];
+	str >> chksum;
+}
+
+void PacketPartialBoard::write(QDataStream &str) const
+{
+	str << tick << mask;
+	for (int i = 0; i < CLIENT_FRAME; i++)
+		if (hasRow(i))
+			for (int j = 0; j < CLIENT_FRAME; j++)
+				str << rows[i][j];
+	str << chksum;
+}
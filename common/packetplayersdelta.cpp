@@ -0,0 +1,52 @@
+/*
+ * Players Delta packet. Informs the client which players left and joined during a tick,
+ * for clients with CAP_PLAYER_DELTAS. Those who left are removed before those who joined
+ * are added.
+ *
+ * Spec: <PACKET_PLAYERS_DELTA> <tick_t: current tick> <QVector<plid_t>: ids which left>
+ *       <QHash<plid_t, QString>: id/player map of those who joined>
+ * Direction: Server to Client
+ */
+
+#include "protocol.h"
+
+PacketPlayersDelta::PacketPlayersDelta()
+	: Packet(PACKET_PLAYERS_DELTA)
+	, tick(0)
+	, left()
+	, joined()
+{
+}
+
+PacketPlayersDelta::PacketPlayersDelta(tick_t tck, const QVector<plid_t> &lft, const QHash<plid_t, QString> &jnd)
+	: Packet(PACKET_PLAYERS_DELTA)
+	, tick(tck)
+	, left(lft)
+	, joined(jnd)
+{
+}
+
+tick_t PacketPlayersDelta::getTick() const
+{
+	return tick;
+}
+
+const QVector<plid_t> &PacketPlayersDelta::getLeft() const
+{
+	return left;
+}
+
+const QHash<plid_t, QString> &PacketPlayersDelta::getJoined() const
+{
+	return joined;
+}
+
+void PacketPlayersDelta::read(QDataStream &str)
+{
+	str >> tick >> left >> joined;
+}
+
+void PacketPlayersDelta::write(QDataStream &str) const
+{
+	str << tick << left << joined;
+}
@@ -7,6 +7,13 @@
  *
  * Spec: <PACKET_REQUEST_JOIN> <QString: name> 
  * Direction: Client to Server
+ *
+ * Request Join With Capabilities packet. The same, along with the capabilities the client
+ * wants out of those the server said it has.
+ *
+ * Spec: <PACKET_REQUEST_JOIN_CAPS> <QString: name> <quint32: capabilities>
+ *       <quint16: TickCoder::VERSION>
+ * Direction: Client to Server
  */
 
 #include "protocol.h"
@@ -18,7 +25,12 @@ PacketRequestJoin::PacketRequestJoin()
 }
 
 PacketRequestJoin::PacketRequestJoin(const QString &nm)
-	: Packet(PACKET_REQUEST_JOIN)
+	: PacketRequestJoin(PACKET_REQUEST_JOIN, nm)
+{
+}
+
+PacketRequestJoin::PacketRequestJoin(packet_t id, const QString &nm)
+	: Packet(id)
 	, name(nm)
 {
 }
@@ -43,3 +55,38 @@ void PacketRequestJoin::write(QDataStream &str) const
 	str << name;
 }
 
+PacketRequestJoinCaps::PacketRequestJoinCaps()
+	: PacketRequestJoin(PACKET_REQUEST_JOIN_CAPS, QString())
+	, caps(0)
+	, codesVersion(0)
+{
+}
+
+PacketRequestJoinCaps::PacketRequestJoinCaps(const QString &nm, quint32 cp, quint16 cv)
+	: PacketRequestJoin(PACKET_REQUEST_JOIN_CAPS, nm)
+	, caps(cp)
+	, codesVersion(cv)
+{
+}
+
+quint32 PacketRequestJoinCaps::getCapabilities() const
+{
+	return caps;
+}
+
+quint16 PacketRequestJoinCaps::getCodesVersion() const
+{
+	return codesVersion;
+}
+
+void PacketRequestJoinCaps::read(QDataStream &str)
+{
+	PacketRequestJoin::read(str);
+	str >> caps >> codesVersion;
+}
+
+void PacketRequestJoinCaps::write(QDataStream &str) const
+{
+	PacketRequestJoin::write(str);
+	str << caps << codesVersion;
+}
@@ -0,0 +1,51 @@
+/*
+ * Request Spectate packet. Asks to watch a game rather than play, following a player or
+ * the whole board scaled down.
+ *
+ * Spec: <PACKET_REQUEST_SPECTATE> <plid_t: player to follow, or NULL_ID for the whole board>
+ *       <quint32: capabilities> <quint16: TickCoder::VERSION>
+ * Direction: Client to Server
+ */
+
+#include "protocol.h"
+
+PacketRequestSpectate::PacketRequestSpectate()
+	: Packet(PACKET_REQUEST_SPECTATE)
+	, player(NULL_ID)
+	, caps(0)
+	, codesVersion(0)
+{
+}
+
+PacketRequestSpectate::PacketRequestSpectate(plid_t pl, quint32 cp, quint16 cv)
+	: Packet(PACKET_REQUEST_SPECTATE)
+	, player(pl)
+	, caps(cp)
+	, codesVersion(cv)
+{
+}
+
+plid_t PacketRequestSpectate::getPlayer() const
+{
+	return player;
+}
+
+quint32 PacketRequestSpectate::getCapabilities() const
+{
+	return caps;
+}
+
+quint16 PacketRequestSpectate::getCodesVersion() const
+{
+	return codesVersion;
+}
+
+void PacketRequestSpectate::read(QDataStream &str)
+{
+	str >> player >> caps >> codesVersion;
+}
+
+void PacketRequestSpectate::write(QDataStream &str) const
+{
+	str << player << caps << codesVersion;
+}
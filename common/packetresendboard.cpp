@@ -3,43 +3,55 @@
  *
  * Spec: <PACKET_RESEND_BOARD> <tick_t: current tick> {<state_t: board state>}[CLIENT_FRAME^2 times, populating the local board state, L to R, T to B] <quint64: 64 bit crc>
  * Direction: Server to Client
+ *
+ * Packed Board packet. The same, with the board packed by writePackedBoard() for clients
+ * with CAP_PACKED_BOARDS.
+ *
+ * Spec: <PACKET_PACKED_BOARD> <tick_t: current tick> <packed board> <quint64: 64 bit crc>
+ * Direction: Server to Client
  */
 
+#include <QtCore>
 #include "protocol.h"
 
 PacketResendBoard::PacketResendBoard()
-	: Packet(PACKET_RESEND_BOARD)
-	, tick(0)
-	, alloc(true)
+	: PacketResendBoard(PACKET_RESEND_BOARD, NULL)
 {
-	allocBoard();
-	std::fill(board[0], board[0] + (CLIENT_FRAME * CLIENT_FRAME), 0);
-
-	chksum = hashBoard(board);
 }
 
-PacketResendBoard::PacketResendBoard(tick_t tck, state_t *brd[CLIENT_FRAME])
+PacketResendBoard::PacketResendBoard(tick_t tck, state_t *brd[CLIENT_FRAME], BoardHash alg)
 	: Packet(PACKET_RESEND_BOARD)
 	, tick(tck)
 	, alloc(false)
+	, algorithm(alg)
 {
 	std::copy(brd, brd + CLIENT_FRAME, board);
 
-	chksum = hashBoard(board);
+	chksum = hashBoard(board, 0, algorithm);
 }
 
 PacketResendBoard::PacketResendBoard(const PacketResendBoard &other)
-	: Packet(PACKET_RESEND_BOARD)
-	, tick(other.tick)
-	, alloc(other.alloc)
-	, chksum(other.chksum)
+	: PacketResendBoard(PACKET_RESEND_BOARD, &other)
 {
-	if (alloc)
+}
+
+PacketResendBoard::PacketResendBoard(packet_t id, const PacketResendBoard *other)
+	: Packet(id)
+	, tick(other ? other->tick : 0)
+	, alloc(other ? other->alloc : true)
+	, algorithm(other ? other->algorithm : HASH_MD4)
+	, chksum(other ? other->chksum : QByteArray())
+{
+	if (!other)
 	{
 		allocBoard();
-		std::copy(other.board[0], other.board[0] + (CLIENT_FRAME * CLIENT_FRAME), board[0]);
+		std::fill(board[0], board[0] + (CLIENT_FRAME * CLIENT_FRAME), 0);
+		chksum = hashBoard(board);
+	} else if (alloc) {
+		allocBoard();
+		std::copy(other->board[0], other->board[0] + (CLIENT_FRAME * CLIENT_FRAME), board[0]);
 	} else {
-		std::copy(other.board, other.board + CLIENT_FRAME, board);
+		std::copy(other->board, other->board + CLIENT_FRAME, board);
 	}
 }
 
@@ -55,6 +67,7 @@ PacketResendBoard &PacketResendBoard::operator =(const PacketResendBoard &other)
 		return *this;
 
 	tick = other.tick;
+	algorithm = other.algorithm;
 	chksum = other.chksum;
 
 	if (other.alloc)
@@ -106,7 +119,7 @@ void PacketResendBoard::setBoardPointer(state_t *brd[CLIENT_FRAME])
 	alloc = false;
 
 	std::copy(brd, brd + CLIENT_FRAME, board);
-	chksum = hashBoard(board);
+	chksum = hashBoard(board, 0, algorithm);
 }
 
 void PacketResendBoard::setBoardCopy(state_t const *brd[CLIENT_FRAME])
@@ -117,12 +130,24 @@ void PacketResendBoard::setBoardCopy(state_t const *brd[CLIENT_FRAME])
 
 	for (int i = 0; i < CLIENT_FRAME; i++)
 		std::copy(brd[i], brd[i] + CLIENT_FRAME, board[i]);
-	chksum = hashBoard(board);
+	chksum = hashBoard(board, 0, algorithm);
 }
 
 void PacketResendBoard::read(QDataStream &str)
 {
 	str >> tick;
+	if (getId() == PACKET_PACKED_BOARD)
+	{
+		bool ok = readPackedBoard(str, board);
+		str >> chksum;
+		if (!ok && str.status() == QDataStream::Ok)
+		{
+			qWarning() << "Board for tick" << tick << "did not unpack";
+			chksum.clear();
+		}
+		return;
+	}
+
 	for (int i = 0; i < CLIENT_FRAME; i++)
 		for (int j = 0; j < CLIENT_FRAME; j++)
 			str >> board[i][j];
@@ -132,6 +157,13 @@ void PacketResendBoard::read(QDataStream &str)
 void PacketResendBoard::write(QDataStream &str) const
 {
 	str << tick;
+	if (getId() == PACKET_PACKED_BOARD)
+	{
+		writePackedBoard(str, board);
+		str << chksum;
+		return;
+	}
+
 	for (int i = 0; i < CLIENT_FRAME; i++)
 		for (int j = 0; j < CLIENT_FRAME; j++)
 			str << board[i][j];
@@ -142,3 +174,13 @@ QByteArray PacketResendBoard::getChecksum() const
 {
 	return chksum;
 }
+
+PacketPackedBoard::PacketPackedBoard()
+	: PacketResendBoard(PACKET_PACKED_BOARD, NULL)
+{
+}
+
+PacketPackedBoard::PacketPackedBoard(const PacketResendBoard &prb)
+	: PacketResendBoard(PACKET_PACKED_BOARD, &prb)
+{
+}
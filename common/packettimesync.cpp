@@ -0,0 +1,130 @@
+/*
+ * Time Sync packet. Measures the round trip time and the offset between the two sides'
+ * clocks, NTP style. The sender fills in only the originate time, leaving the others at -1,
+ * and the receiver echoes it back with when it received the request and when it sent the
+ * reply. Each time is on the clock of whoever took it, in nanoseconds on a monotonic clock.
+ * The client starts the exchange; the server only sends these to clients which have.
+ *
+ * Spec: <PACKET_TIME_SYNC> <qint64: originate> <qint64: receive> <qint64: transmit>
+ * Direction: Both ways
+ *
+ * ClockSync, which makes sense of the replies, is implemented here too.
+ */
+
+#include <algorithm>
+
+#include "protocol.h"
+
+PacketTimeSync::PacketTimeSync()
+	: Packet(PACKET_TIME_SYNC)
+	, originate(-1)
+	, receive(-1)
+	, transmit(-1)
+{
+}
+
+PacketTimeSync::PacketTimeSync(qint64 orig)
+	: Packet(PACKET_TIME_SYNC)
+	, originate(orig)
+	, receive(-1)
+	, transmit(-1)
+{
+}
+
+PacketTimeSync::PacketTimeSync(qint64 orig, qint64 recv, qint64 trans)
+	: Packet(PACKET_TIME_SYNC)
+	, originate(orig)
+	, receive(recv)
+	, transmit(trans)
+{
+}
+
+bool PacketTimeSync::isRequest() const
+{
+	return receive < 0 || transmit < 0;
+}
+
+qint64 PacketTimeSync::getOriginate() const
+{
+	return originate;
+}
+
+qint64 PacketTimeSync::getReceive() const
+{
+	return receive;
+}
+
+qint64 PacketTimeSync::getTransmit() const
+{
+	return transmit;
+}
+
+PacketTimeSync PacketTimeSync::reply(qint64 recv, qint64 trans) const
+{
+	return PacketTimeSync(originate, recv, trans);
+}
+
+void PacketTimeSync::read(QDataStream &str)
+{
+	str >> originate >> receive >> transmit;
+}
+
+void PacketTimeSync::write(QDataStream &str) const
+{
+	str << originate << receive << transmit;
+}
+
+ClockSync::ClockSync()
+{
+	reset();
+}
+
+void ClockSync::reset()
+{
+	std::fill(roundTrips, roundTrips + SAMPLES, 0);
+	std::fill(offsets, offsets + SAMPLES, 0);
+	next = 0;
+	count = 0;
+	best = 0;
+}
+
+qint64 ClockSync::sample(const PacketTimeSync &reply, qint64 arrival)
+{
+	// The time the other side spent holding on to the request doesn't
+	// count towards the round trip.
+	qint64 rtt = (arrival - reply.getOriginate()) - (reply.getTransmit() - reply.getReceive());
+	qint64 offset = ((reply.getReceive() - reply.getOriginate()) + (reply.getTransmit() - arrival)) / 2;
+	rtt = std::max<qint64>(rtt, 0);
+
+	roundTrips[next] = rtt;
+	offsets[next] = offset;
+	next = (next + 1) % SAMPLES;
+	count = std::min(count + 1, SAMPLES);
+
+	best = 0;
+	for (int i = 1; i < count; ++i)
+		if (roundTrips[i] < roundTrips[best])
+			best = i;
+
+	return rtt;
+}
+
+bool ClockSync::isSynced() const
+{
+	return count > 0;
+}
+
+qint64 ClockSync::getOffset() const
+{
+	return offsets[best];
+}
+
+qint64 ClockSync::getRoundTrip() const
+{
+	return roundTrips[best];
+}
+
+qint64 ClockSync::toLocal(qint64 remote) const
+{
+	return remote - offsets[best];
+}
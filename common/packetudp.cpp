@@ -0,0 +1,172 @@
+/*
+ * The packets which set up and carry game ticks over UDP.
+ *
+ * Request UDP packet. Asks the server to send game ticks over UDP instead of this
+ * connection. Everything else stays on this connection.
+ *
+ * Spec: <PACKET_REQUEST_UDP>
+ * Direction: Client to Server
+ *
+ * UDP Offer packet. Tells the client which UDP port to send a PACKET_UDP_HELLO to and the
+ * token which identifies it. Ticks keep coming over this connection until the hello arrives.
+ *
+ * Spec: <PACKET_UDP_OFFER> <quint16: port> <quint32: token>
+ * Direction: Server to Client
+ *
+ * UDP Hello packet. Sent in a datagram to the offered port, so the server knows where to
+ * send ticks. Resent until ticks arrive over UDP.
+ *
+ * Spec: <PACKET_UDP_HELLO> <quint32: token>
+ * Direction: Client to Server, over UDP
+ *
+ * Tick Ack packet. Tells the server the client has applied the given tick and its checksum
+ * matched, so later ticks can be sent as a delta from it.
+ *
+ * Spec: <PACKET_TICK_ACK> <quint32: token> <tick_t: tick>
+ * Direction: Client to Server, over UDP
+ *
+ * Delta Tick packet. A game tick sent over UDP. It is a PACKET_CATCHUP from the last tick
+ * the client acknowledged, so it can be applied no matter which ticks before it were lost.
+ * Its tick doubles as its sequence number; anything not newer than what the client has is
+ * dropped.
+ *
+ * Spec: <PACKET_DELTA_TICK> <contents of PACKET_CATCHUP> <score_t: score>
+ *       <qint64: timestamp, as in PACKET_GAME_TICK, or -1>
+ * Direction: Server to Client, over UDP
+ */
+
+#include "protocol.h"
+
+PacketUdpOffer::PacketUdpOffer()
+	: Packet(PACKET_UDP_OFFER)
+	, port(0)
+	, token(0)
+{
+}
+
+PacketUdpOffer::PacketUdpOffer(quint16 prt, quint32 tkn)
+	: Packet(PACKET_UDP_OFFER)
+	, port(prt)
+	, token(tkn)
+{
+}
+
+quint16 PacketUdpOffer::getPort() const
+{
+	return port;
+}
+
+quint32 PacketUdpOffer::getToken() const
+{
+	return token;
+}
+
+void PacketUdpOffer::read(QDataStream &str)
+{
+	str >> port >> token;
+}
+
+void PacketUdpOffer::write(QDataStream &str) const
+{
+	str << port << token;
+}
+
+PacketUdpHello::PacketUdpHello()
+	: Packet(PACKET_UDP_HELLO)
+	, token(0)
+{
+}
+
+PacketUdpHello::PacketUdpHello(quint32 tkn)
+	: Packet(PACKET_UDP_HELLO)
+	, token(tkn)
+{
+}
+
+quint32 PacketUdpHello::getToken() const
+{
+	return token;
+}
+
+void PacketUdpHello::read(QDataStream &str)
+{
+	str >> token;
+}
+
+void PacketUdpHello::write(QDataStream &str) const
+{
+	str << token;
+}
+
+PacketTickAck::PacketTickAck()
+	: Packet(PACKET_TICK_ACK)
+	, token(0)
+	, tick(0)
+{
+}
+
+PacketTickAck::PacketTickAck(quint32 tkn, tick_t tck)
+	: Packet(PACKET_TICK_ACK)
+	, token(tkn)
+	, tick(tck)
+{
+}
+
+quint32 PacketTickAck::getToken() const
+{
+	return token;
+}
+
+tick_t PacketTickAck::getTick() const
+{
+	return tick;
+}
+
+void PacketTickAck::read(QDataStream &str)
+{
+	str >> token >> tick;
+}
+
+void PacketTickAck::write(QDataStream &str) const
+{
+	str << token << tick;
+}
+
+PacketDeltaTick::PacketDeltaTick()
+	: PacketCatchup(PACKET_DELTA_TICK)
+	, score(0)
+	, timestamp(-1)
+{
+}
+
+score_t PacketDeltaTick::getScore() const
+{
+	return score;
+}
+
+void PacketDeltaTick::setScore(score_t sc)
+{
+	score = sc;
+}
+
+qint64 PacketDeltaTick::getTimestamp() const
+{
+	return timestamp;
+}
+
+void PacketDeltaTick::setTimestamp(qint64 ts)
+{
+	timestamp = ts;
+}
+
+void PacketDeltaTick::read(QDataStream &str)
+{
+	PacketCatchup::read(str);
+	str >> score >> timestamp;
+}
+
+void PacketDeltaTick::write(QDataStream &str) const
+{
+	PacketCatchup::write(str);
+	str << score << timestamp;
+}
@@ -4,17 +4,176 @@
 
 #include <QCryptographicHash>
 #include <QtCore>
+#include <algorithm>
+#include <vector>
 
 #include "protocol.h"
 
-QByteArray hashBoard(state_t const* const* board)
+QByteArray hashBoard(state_t const* const* board, int origin, BoardHash algorithm)
 {
+	if (algorithm == HASH_FNV64)
+	{
+		quint64 hash = 14695981039346656037ull;
+		for (int i = 0; i < CLIENT_FRAME; i++)
+		{
+			for (int j = 0; j < CLIENT_FRAME; j++)
+			{
+				hash ^= board[i][(j + origin) % CLIENT_FRAME];
+				hash *= 1099511628211ull;
+			}
+		}
+
+		QByteArray ret(sizeof(hash), 0);
+		qToBigEndian(hash, reinterpret_cast<uchar *>(ret.data()));
+		return ret;
+	}
+
+	// The hash only sees a stream of bytes, so feeding a wrapped row in two
+	// pieces gives the same result as feeding the unwrapped row.
 	QCryptographicHash hash(QCryptographicHash::Algorithm::Md4);
 	for (int i = 0; i < CLIENT_FRAME; i++)
-		hash.addData(reinterpret_cast<const char *>(board[i]), CLIENT_FRAME * sizeof(state_t) / sizeof(char));
+	{
+		hash.addData(reinterpret_cast<const char *>(board[i] + origin), (CLIENT_FRAME - origin) * sizeof(state_t) / sizeof(char));
+		if (origin)
+			hash.addData(reinterpret_cast<const char *>(board[i]), origin * sizeof(state_t) / sizeof(char));
+	}
 	return hash.result();
 }
 
+quint32 hashRow(const state_t *row, int origin)
+{
+	// FNV-1a over whole squares. It only has to tell rows apart; the
+	// board checksum still checks the result.
+	quint32 hash = 2166136261u;
+	for (int i = 0; i < CLIENT_FRAME; i++)
+	{
+		hash ^= row[(i + origin) % CLIENT_FRAME];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * The diffs are RLE encoded. This means we write a byte
+ * indicating "quantity" and then a quint32 which will be
+ * repeated "quantity" times.
+ */
+void writeDiff(QDataStream &str, state_t const* const* diff)
+{
+	quint8 count = 0;
+	state_t cv = diff[0][0];
+	for (int i = 0; i < CLIENT_FRAME; ++i)
+	{
+		for (int j = 0; j < CLIENT_FRAME; ++j)
+		{
+			if (diff[i][j] != cv || count >= static_cast<quint8>(count + 1))
+			{
+				str << count << cv;
+
+				count = 0;
+				cv = diff[i][j];
+			}
+
+			++count;
+		}
+	}
+	str << count << cv;
+}
+
+void readDiff(QDataStream &str, state_t *const *diff)
+{
+	quint8 count = 0;
+	state_t cv = 0;
+	for (int i = 0; i < CLIENT_FRAME; ++i)
+	{
+		for (int j = 0; j < CLIENT_FRAME; ++j)
+		{
+			if (count == 0)
+				str >> count >> cv;
+
+			diff[i][j] = cv;
+			count--;
+		}
+	}
+}
+
+/*
+ * Boards are mostly territory, so they hold a handful of states in long
+ * runs. Each run is written as an entry in a palette of those states.
+ */
+void writePackedBoard(QDataStream &str, state_t const* const* board)
+{
+	std::vector<state_t> palette;
+	std::vector<std::pair<quint16, quint8>> runs;
+	for (int i = 0; i < CLIENT_FRAME; ++i)
+	{
+		for (int j = 0; j < CLIENT_FRAME; ++j)
+		{
+			state_t cv = board[i][j];
+			if (!runs.empty() && palette[runs.back().first] == cv && runs.back().second < 255)
+			{
+				runs.back().second++;
+				continue;
+			}
+
+			auto entry = std::find(palette.begin(), palette.end(), cv);
+			if (entry == palette.end())
+				entry = palette.insert(entry, cv);
+			runs.emplace_back(entry - palette.begin(), 0);
+		}
+	}
+
+	str << static_cast<quint16>(palette.size());
+	for (state_t cv : palette)
+		str << cv;
+
+	bool wide = palette.size() > 256;
+	for (const auto &run : runs)
+	{
+		if (wide)
+			str << run.first;
+		else
+			str << static_cast<quint8>(run.first);
+		str << run.second;
+	}
+}
+
+bool readPackedBoard(QDataStream &str, state_t *const *board)
+{
+	quint16 size;
+	str >> size;
+	std::vector<state_t> palette(size);
+	for (state_t &cv : palette)
+		str >> cv;
+
+	bool wide = size > 256;
+	bool ok = true;
+	int n = 0;
+	while (ok && n < CLIENT_FRAME * CLIENT_FRAME && str.status() == QDataStream::Ok)
+	{
+		quint16 entry;
+		quint8 count;
+		if (wide)
+		{
+			str >> entry;
+		} else {
+			quint8 narrow;
+			str >> narrow;
+			entry = narrow;
+		}
+		str >> count;
+
+		ok = entry < size && n + count < CLIENT_FRAME * CLIENT_FRAME;
+		for (int k = 0; ok && k <= count; ++k, ++n)
+			board[n / CLIENT_FRAME][n % CLIENT_FRAME] = palette[entry];
+	}
+
+	if (!ok)
+		for (int i = 0; i < CLIENT_FRAME; ++i)
+			std::fill(board[i], board[i] + CLIENT_FRAME, 0);
+	return ok;
+}
+
 std::unordered_map<packet_t, std::unique_ptr<APacketFactory>> Packet::map;
 
 void Packet::registerPacket(packet_t id, std::unique_ptr<APacketFactory> fact)
@@ -9,6 +9,7 @@
 #include <QByteArray>
 #include <QDataStream>
 #include <QHash>
+#include <QVector>
 #include <unordered_map>
 
 #include "types.h"
@@ -84,9 +85,18 @@ const packet_t PACKET_GAME_JOIN = 6;
 /*
  * Game Tick packet. Informs the client of a server tick and change in board state.
  *
+ * If the high bit of direction_moved is set (TICK_TIMESTAMPED), the server's monotonic
+ * clock in nanoseconds when it sent the tick follows the score. The server only sets it for
+ * clients which have sent a PACKET_TIME_SYNC.
+ *
+ * If TICK_CODED is set, the new row and the difference are replaced by a TickCoder
+ * coding of them. The server only sets it for clients it agreed CAP_CODED_TICKS with.
+ *
  * Spec: <PACKET_GAME_TICK> <tick_t: current tick> <quint8: direction_moved> <score_t: score>
+ *       [<qint64: timestamp>]
  *       {<quint32: board_state>}[CLIENT_FRAME times, the new row visible either L to R or T to B depending on direction]
  *       {<quint8>}[RLE encoded XOR difference of existing board, L to R, T to B]
+ *         or, if coded, <quint16: length> {<quint8>}[length times, the coded row and difference]
  *       <quint64: a 64 bit crc of the new board state>
  * Direction: Server to Client
  */
@@ -116,12 +126,253 @@ const packet_t PACKET_REQUEST_RESEND = 9;
  * Direction: Serber to Client
  */
 const packet_t PACKET_GAME_END = 10;
+/*
+ * Time Sync packet. Measures the round trip time and the offset between the two sides'
+ * clocks, NTP style. The sender fills in only the originate time, leaving the others at -1,
+ * and the receiver echoes it back with when it received the request and when it sent the
+ * reply. Each time is on the clock of whoever took it, in nanoseconds on a monotonic clock.
+ * The client starts the exchange; the server only sends these to clients which have.
+ *
+ * Spec: <PACKET_TIME_SYNC> <qint64: originate> <qint64: receive> <qint64: transmit>
+ * Direction: Both ways
+ */
+const packet_t PACKET_TIME_SYNC = 11;
 
 /*
- * Computes an md4 hash of the linked board for
- * client/server verification.
+ * Request Catchup packet. Asks the server to bring the client's board up to date from the
+ * last tick whose checksum matched, after a checksum failure. The server answers with a
+ * PACKET_CATCHUP, or with a PACKET_RESEND_BOARD if it no longer has the ticks since then.
+ *
+ * Spec: <PACKET_REQUEST_CATCHUP> <tick_t: last good tick>
+ * Direction: Client to Server
+ */
+const packet_t PACKET_REQUEST_CATCHUP = 12;
+/*
+ * Catchup packet. The difference between the client's board as of the tick it asked to be
+ * caught up from and the board now. The client first moves its view by the given offset;
+ * the squares this brings into view start out as 0. The diff is then XORed in as with
+ * PACKET_GAME_TICK.
+ *
+ * Spec: <PACKET_CATCHUP> <tick_t: current tick> <tick_t: caught up from>
+ *       <qint8: x offset> <qint8: y offset>
+ *       {<quint8>}[RLE encoded XOR difference of the moved board, L to R, T to B]
+ *       <quint64: a 64 bit crc of the new board state>
+ * Direction: Server to Client
+ */
+const packet_t PACKET_CATCHUP = 13;
+/*
+ * Request UDP packet. Asks the server to send game ticks over UDP instead of this
+ * connection. Everything else stays on this connection.
+ *
+ * Spec: <PACKET_REQUEST_UDP>
+ * Direction: Client to Server
  */
-QByteArray hashBoard(state_t const* const* board);
+const packet_t PACKET_REQUEST_UDP = 14;
+/*
+ * UDP Offer packet. Tells the client which UDP port to send a PACKET_UDP_HELLO to and the
+ * token which identifies it. Ticks keep coming over this connection until the hello arrives.
+ *
+ * Spec: <PACKET_UDP_OFFER> <quint16: port> <quint32: token>
+ * Direction: Server to Client
+ */
+const packet_t PACKET_UDP_OFFER = 15;
+/*
+ * UDP Hello packet. Sent in a datagram to the offered port, so the server knows where to
+ * send ticks. Resent until ticks arrive over UDP.
+ *
+ * Spec: <PACKET_UDP_HELLO> <quint32: token>
+ * Direction: Client to Server, over UDP
+ */
+const packet_t PACKET_UDP_HELLO = 16;
+/*
+ * Tick Ack packet. Tells the server the client has applied the given tick and its checksum
+ * matched, so later ticks can be sent as a delta from it.
+ *
+ * Spec: <PACKET_TICK_ACK> <quint32: token> <tick_t: tick>
+ * Direction: Client to Server, over UDP
+ */
+const packet_t PACKET_TICK_ACK = 17;
+/*
+ * Delta Tick packet. A game tick sent over UDP. It is a PACKET_CATCHUP from the last tick
+ * the client acknowledged, so it can be applied no matter which ticks before it were lost.
+ * Its tick doubles as its sequence number; anything not newer than what the client has is
+ * dropped.
+ *
+ * Spec: <PACKET_DELTA_TICK> <contents of PACKET_CATCHUP> <score_t: score>
+ *       <qint64: timestamp, as in PACKET_GAME_TICK, or -1>
+ * Direction: Server to Client, over UDP
+ */
+const packet_t PACKET_DELTA_TICK = 18;
+/*
+ * Request Rows packet. Sent instead of asking for the whole board when the client's
+ * checksum disagrees with the server's. Carries a hashRow() of each row of the client's
+ * view, so the server can send only the rows which are wrong.
+ *
+ * Spec: <PACKET_REQUEST_ROWS> <tick_t: the client's tick>
+ *       {<quint32: row hash>}[CLIENT_FRAME times, T to B]
+ * Direction: Client to Server
+ */
+const packet_t PACKET_REQUEST_ROWS = 19;
+/*
+ * Partial Board packet. The rows of the client's view which disagreed with the server,
+ * as of the current tick. Every tick since the one the hashes were from has moved the
+ * same wrong squares, so these are the rows they are in now. Answered with a
+ * PACKET_RESEND_BOARD instead if the server can't tell which rows are wrong.
+ *
+ * Spec: <PACKET_PARTIAL_BOARD> <tick_t: current tick> <quint32: bit i set if row i is sent>
+ *       {<state_t: board state>}[CLIENT_FRAME times for each row sent, L to R, T to B]
+ *       <quint64: a 64 bit crc of the whole board state>
+ * Direction: Server to Client
+ */
+const packet_t PACKET_PARTIAL_BOARD = 20;
+/*
+ * Hello packet. Asks the server which capabilities it has, which it answers with a
+ * PACKET_CAPABILITIES. Servers which predate capabilities skip it, since it is empty, so a
+ * client which hasn't had an answer after a few seconds takes it that there are none. Until
+ * then the client sends no packets the oldest servers wouldn't know.
+ *
+ * Spec: <PACKET_HELLO>
+ * Direction: Client to Server
+ */
+const packet_t PACKET_HELLO = 21;
+/*
+ * Capabilities packet. The capabilities the server can use, and the version of its
+ * TickCoder tables. Only sent in answer to a PACKET_HELLO.
+ *
+ * Spec: <PACKET_CAPABILITIES> <quint32: capabilities> <quint16: TickCoder::VERSION>
+ * Direction: Server to Client
+ */
+const packet_t PACKET_CAPABILITIES = 22;
+/*
+ * Packed Board packet. A PACKET_RESEND_BOARD with the board as a palette of the states in
+ * it and runs of palette entries, for clients with CAP_PACKED_BOARDS. A board which
+ * doesn't unpack is left zeroed with an empty checksum, so the client asks for it again.
+ *
+ * Spec: <PACKET_PACKED_BOARD> <tick_t: current tick> <packed board> <quint64: 64 bit crc>
+ * Packed board: <quint16: palette size> {<state_t: board state>}[palette size times]
+ *       {<quint8 or, for palettes over 256, quint16: palette entry> <quint8: run length - 1>}
+ *       [until CLIENT_FRAME^2 squares are filled, L to R, T to B]
+ * Direction: Server to Client
+ */
+const packet_t PACKET_PACKED_BOARD = 23;
+/*
+ * Request Join With Capabilities packet. A PACKET_REQUEST_JOIN which also says which of
+ * the server's capabilities the client wants. Only sent to servers which have sent a
+ * PACKET_CAPABILITIES.
+ *
+ * Spec: <PACKET_REQUEST_JOIN_CAPS> <contents of PACKET_REQUEST_JOIN>
+ *       <quint32: capabilities> <quint16: TickCoder::VERSION>
+ * Direction: Client to Server
+ */
+const packet_t PACKET_REQUEST_JOIN_CAPS = 24;
+/*
+ * Game Join With Capabilities packet. The answer to a PACKET_REQUEST_JOIN_CAPS, with the
+ * capabilities the server picked for the game. With CAP_PACKED_BOARDS, the player and
+ * leaderboard updates are compressed with qCompress() and the board is packed as in
+ * PACKET_PACKED_BOARD.
+ *
+ * Spec: <PACKET_GAME_JOIN_CAPS> <quint32: capabilities>
+ *       <plid_t: id> <score_t: score> <quint16: total squares> <quint16: tickRate>
+ *       <contents of PACKET_PLAYERS_UPDATE>
+ *       <contents of PACKET_LEADERBOARD_UPDATE>
+ *       <contents of PACKET_RESEND_BOARD>
+ *     or with CAP_PACKED_BOARDS:
+ *       <QByteArray: qCompress()ed <contents of PACKET_PLAYERS_UPDATE> <contents of PACKET_LEADERBOARD_UPDATE>>
+ *       <contents of PACKET_PACKED_BOARD>
+ * Direction: Server to Client
+ */
+const packet_t PACKET_GAME_JOIN_CAPS = 25;
+/*
+ * Players Delta packet. The players who left and joined during a tick, for clients with
+ * CAP_PLAYER_DELTAS, which are sent this instead of a PACKET_PLAYERS_UPDATE. Those who
+ * left are removed before those who joined are added, as an id can be reused in the
+ * same tick.
+ *
+ * Spec: <PACKET_PLAYERS_DELTA> <tick_t: current tick> <QVector<plid_t>: ids which left>
+ *       <QHash<plid_t, QString>: id/player map of those who joined>
+ * Direction: Server to Client
+ */
+const packet_t PACKET_PLAYERS_DELTA = 26;
+/*
+ * Request Players packet. Asks for a PACKET_PLAYERS_UPDATE, when a PACKET_PLAYERS_DELTA
+ * didn't fit the players the client has.
+ *
+ * Spec: <PACKET_REQUEST_PLAYERS>
+ * Direction: Client to Server
+ */
+const packet_t PACKET_REQUEST_PLAYERS = 27;
+/*
+ * Request Spectate packet. Asks to watch a game rather than play, following the given
+ * player or, with NULL_ID, the whole board scaled down to CLIENT_FRAME squares. Each
+ * square of the scaled down board stands for a block of squares, and shows a player in
+ * it if there is one, else a trail, else the block's middle square. Only sent to servers
+ * with CAP_SPECTATE. The server answers with a PACKET_GAME_JOIN_CAPS whose id is the
+ * player followed, or PACKET_QUEUED if no game is running yet. Another PACKET_GAME_JOIN_CAPS
+ * follows whenever the player followed leaves, and a PACKET_GAME_END when the game does.
+ * The ticks are sent as to a player, except that the whole board never moves.
+ *
+ * Spec: <PACKET_REQUEST_SPECTATE> <plid_t: player to follow, or NULL_ID for the whole board>
+ *       <quint32: capabilities> <quint16: TickCoder::VERSION>
+ * Direction: Client to Server
+ */
+const packet_t PACKET_REQUEST_SPECTATE = 28;
+
+/*
+ * Capabilities are optional encodings both ends have to agree on before they
+ * are used. Without them, everything is sent as described above.
+ */
+/* Game ticks are coded with TickCoder, if both have the same tables. */
+const quint32 CAP_CODED_TICKS = 0x1;
+/* Whole boards and game joins are packed. */
+const quint32 CAP_PACKED_BOARDS = 0x2;
+/* Board checksums are hashBoard()'s HASH_FNV64 instead of md4. */
+const quint32 CAP_FAST_HASH = 0x4;
+/* Changes to the players are sent as PACKET_PLAYERS_DELTA. */
+const quint32 CAP_PLAYER_DELTAS = 0x8;
+/* The server takes PACKET_REQUEST_SPECTATE. Only the server's offer matters. */
+const quint32 CAP_SPECTATE = 0x10;
+/* Everything this build can do. */
+const quint32 CAPABILITIES = CAP_CODED_TICKS | CAP_PACKED_BOARDS | CAP_FAST_HASH | CAP_PLAYER_DELTAS
+                           | CAP_SPECTATE;
+
+/* Set in a PACKET_GAME_TICK's direction when it carries a timestamp. */
+const quint8 TICK_TIMESTAMPED = 0x80;
+/* Set in a PACKET_GAME_TICK's direction when its board is coded with TickCoder. */
+const quint8 TICK_CODED = 0x40;
+
+enum BoardHash
+{
+	HASH_MD4,
+	// 64 bit FNV-1a over whole squares, which is much cheaper.
+	HASH_FNV64,
+};
+
+/*
+ * Computes a hash of the linked board for
+ * client/server verification. If origin is given, each row is taken to
+ * start at that column and wrap around to the beginning of the row.
+ */
+QByteArray hashBoard(state_t const* const* board, int origin = 0, BoardHash algorithm = HASH_MD4);
+
+/*
+ * A quick hash of a single row, for finding the rows which differ. Origin
+ * works as for hashBoard().
+ */
+quint32 hashRow(const state_t *row, int origin = 0);
+
+/*
+ * Write and read a CLIENT_FRAME^2 XOR difference of the board, run length
+ * encoded as {<quint8: count> <state_t: value>}, L to R, T to B.
+ */
+void writeDiff(QDataStream &str, state_t const* const* diff);
+void readDiff(QDataStream &str, state_t *const *diff);
+
+/*
+ * Write and read a CLIENT_FRAME^2 board packed as in PACKET_PACKED_BOARD.
+ * Returns false if the board doesn't unpack, leaving it zeroed.
+ */
+void writePackedBoard(QDataStream &str, state_t const* const* board);
+bool readPackedBoard(QDataStream &str, state_t *const *board);
 
 class Packet;
 
@@ -206,6 +457,8 @@ public:
 	void setName(const QString &name);
 
 protected:
+	PacketRequestJoin(packet_t id, const QString &str);
+
 	void read(QDataStream &str) override;
 	void write(QDataStream &str) const override;
 
@@ -282,9 +535,9 @@ public:
 	PacketResendBoard();
 	/*
 	 * Initializes a new PacketResendBoard holding pointers to
-	 * the board state.
+	 * the board state, with its checksum made by the given hash.
 	 */
-	PacketResendBoard(tick_t tick, state_t *board[CLIENT_FRAME]);
+	PacketResendBoard(tick_t tick, state_t *board[CLIENT_FRAME], BoardHash algorithm = HASH_MD4);
 	/*
 	 * Copy constructor.
 	 */
@@ -309,6 +562,12 @@ public:
 	QByteArray getChecksum() const;
 
 protected:
+	/*
+	 * For packets which are written like this one, as with the copy
+	 * constructor or the default one if other is NULL.
+	 */
+	PacketResendBoard(packet_t id, const PacketResendBoard *other);
+
 	void read(QDataStream &str) override;
 	void write(QDataStream &str) const override;
 
@@ -318,6 +577,7 @@ private:
 	bool alloc;
 	state_t *board[CLIENT_FRAME];
 
+	BoardHash algorithm;
 	QByteArray chksum;
 
 	void allocBoard();
@@ -358,8 +618,14 @@ public:
 	void setPRB(const PacketResendBoard &prb);
 
 protected:
+	PacketGameJoin(packet_t id);
+	PacketGameJoin(packet_t id, const PacketGameJoin &other);
+
 	void read(QDataStream &str) override;
 	void write(QDataStream &str) const override;
+	/* As read() and write(), with the contents packed. */
+	void readPacked(QDataStream &str);
+	void writePacked(QDataStream &str) const;
 
 private:
 	plid_t plid;
@@ -403,6 +669,13 @@ public:
 	score_t getScore() const;
 	void setScore(score_t sc);
 
+	/*
+	 * When the server sent the tick on its own clock, or -1 if it didn't
+	 * say.
+	 */
+	qint64 getTimestamp() const;
+	void setTimestamp(qint64 ts);
+
 	const state_t *getNewSection() const;
 	void setNewSection(const state_t[CLIENT_FRAME]);
 
@@ -418,6 +691,12 @@ public:
 
 	QByteArray getChecksum() const;
 
+	/*
+	 * Whether the board is written coded with TickCoder.
+	 */
+	bool isCoded() const;
+	void setCoded(bool coded);
+
 protected:
 	void read(QDataStream &str) override;
 	void write(QDataStream &str) const override;
@@ -426,6 +705,8 @@ private:
 	tick_t tick;
 	quint8 dir;
 	score_t score;
+	qint64 timestamp;
+	bool coded;
 
 	state_t news[CLIENT_FRAME];
 
@@ -480,4 +761,391 @@ private:
 	score_t score;
 };
 
+class PacketTimeSync : public Packet
+{
+public:
+	PacketTimeSync();
+	/* Makes a request sent at the given time. */
+	PacketTimeSync(qint64 originate);
+	PacketTimeSync(qint64 originate, qint64 receive, qint64 transmit);
+
+	/* Whether this is a request to be echoed rather than a reply. */
+	bool isRequest() const;
+
+	qint64 getOriginate() const;
+	qint64 getReceive() const;
+	qint64 getTransmit() const;
+
+	/*
+	 * The reply to this request, received at the given time and sent
+	 * at transmit.
+	 */
+	PacketTimeSync reply(qint64 receive, qint64 transmit) const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	qint64 originate;
+	qint64 receive;
+	qint64 transmit;
+};
+
+/*
+ * Estimates the round trip time and the offset of the other side's clock
+ * from replies to PACKET_TIME_SYNC requests. As in NTP, the offset is taken
+ * from the recent sample with the shortest round trip, since that one had
+ * the least room for the two directions to take different amounts of time.
+ */
+class ClockSync
+{
+public:
+	ClockSync();
+
+	/* Forgets every sample. */
+	void reset();
+
+	/*
+	 * Takes in a reply which arrived at the given time on our clock and
+	 * returns its round trip time.
+	 */
+	qint64 sample(const PacketTimeSync &reply, qint64 arrival);
+
+	bool isSynced() const;
+
+	/* How far the other clock is ahead of ours. */
+	qint64 getOffset() const;
+
+	/* The round trip of the sample the offset came from. */
+	qint64 getRoundTrip() const;
+
+	/* Converts a time on the other clock to ours. */
+	qint64 toLocal(qint64 remote) const;
+
+private:
+	static const int SAMPLES = 8;
+
+	qint64 roundTrips[SAMPLES];
+	qint64 offsets[SAMPLES];
+	int next;
+	int count;
+	int best;
+};
+
+class PacketRequestCatchup : public Packet
+{
+public:
+	PacketRequestCatchup();
+	PacketRequestCatchup(tick_t tick);
+
+	tick_t getTick() const;
+	void setTick(tick_t tick);
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	tick_t tick;
+};
+
+/*
+ * Unlike PacketGameTick, this always holds its own copy of the diff, as
+ * the server builds it from several ticks.
+ */
+class PacketCatchup : public Packet
+{
+public:
+	PacketCatchup();
+	PacketCatchup(tick_t tick, tick_t from, qint8 dx, qint8 dy);
+
+	tick_t getTick() const;
+	void setTick(tick_t tick);
+
+	tick_t getFrom() const;
+	void setFrom(tick_t from);
+
+	qint8 getXOffset() const;
+	qint8 getYOffset() const;
+	void setOffset(qint8 dx, qint8 dy);
+
+	const state_t *const *getDiff() const;
+	state_t *const *getDiff();
+
+	QByteArray getChecksum() const;
+	void setChecksum(const QByteArray &checksum);
+
+protected:
+	PacketCatchup(packet_t id);
+
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	tick_t tick;
+	tick_t from;
+	qint8 dx;
+	qint8 dy;
+
+	state_t data[CLIENT_FRAME][CLIENT_FRAME];
+	state_t *rows[CLIENT_FRAME];
+
+	QByteArray chksum;
+
+	PacketCatchup(const PacketCatchup &other) = delete;
+};
+
+class PacketRequestUdp : public Packet
+{
+public:
+	PacketRequestUdp()
+		: Packet(PACKET_REQUEST_UDP)
+	{
+	}
+};
+
+class PacketUdpOffer : public Packet
+{
+public:
+	PacketUdpOffer();
+	PacketUdpOffer(quint16 port, quint32 token);
+
+	quint16 getPort() const;
+	quint32 getToken() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	quint16 port;
+	quint32 token;
+};
+
+class PacketUdpHello : public Packet
+{
+public:
+	PacketUdpHello();
+	PacketUdpHello(quint32 token);
+
+	quint32 getToken() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	quint32 token;
+};
+
+class PacketTickAck : public Packet
+{
+public:
+	PacketTickAck();
+	PacketTickAck(quint32 token, tick_t tick);
+
+	quint32 getToken() const;
+	tick_t getTick() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	quint32 token;
+	tick_t tick;
+};
+
+class PacketDeltaTick : public PacketCatchup
+{
+public:
+	PacketDeltaTick();
+
+	score_t getScore() const;
+	void setScore(score_t score);
+
+	qint64 getTimestamp() const;
+	void setTimestamp(qint64 ts);
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	score_t score;
+	qint64 timestamp;
+};
+
+class PacketRequestRows : public Packet
+{
+public:
+	PacketRequestRows();
+	PacketRequestRows(tick_t tick, const quint32 *hashes);
+
+	tick_t getTick() const;
+	const quint32 *getHashes() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	tick_t tick;
+	quint32 hashes[CLIENT_FRAME];
+};
+
+class PacketPartialBoard : public Packet
+{
+public:
+	PacketPartialBoard();
+	PacketPartialBoard(tick_t tick);
+
+	tick_t getTick() const;
+
+	bool hasRow(int r) const;
+	const state_t *getRow(int r) const;
+	/* Copies the given row into the packet. */
+	void setRow(int r, const state_t *row);
+	int getRowCount() const;
+
+	QByteArray getChecksum() const;
+	void setChecksum(const QByteArray &checksum);
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	tick_t tick;
+	quint32 mask;
+	state_t rows[CLIENT_FRAME][CLIENT_FRAME];
+	QByteArray chksum;
+};
+
+class PacketHello : public Packet
+{
+public:
+	PacketHello()
+		: Packet(PACKET_HELLO)
+	{
+	}
+};
+
+class PacketCapabilities : public Packet
+{
+public:
+	PacketCapabilities();
+	PacketCapabilities(quint32 caps, quint16 codesVersion);
+
+	quint32 getCapabilities() const;
+	quint16 getCodesVersion() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	quint32 caps;
+	quint16 codesVersion;
+};
+
+/*
+ * A PacketResendBoard which is sent packed. The board is read and written
+ * as in PacketResendBoard otherwise.
+ */
+class PacketPackedBoard : public PacketResendBoard
+{
+public:
+	PacketPackedBoard();
+	/*
+	 * Packs the given board, holding pointers to it if prb does.
+	 */
+	PacketPackedBoard(const PacketResendBoard &prb);
+};
+
+class PacketRequestJoinCaps : public PacketRequestJoin
+{
+public:
+	PacketRequestJoinCaps();
+	PacketRequestJoinCaps(const QString &name, quint32 caps, quint16 codesVersion);
+
+	quint32 getCapabilities() const;
+	quint16 getCodesVersion() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	quint32 caps;
+	quint16 codesVersion;
+};
+
+class PacketGameJoinCaps : public PacketGameJoin
+{
+public:
+	PacketGameJoinCaps();
+	PacketGameJoinCaps(quint32 caps, const PacketGameJoin &pgj);
+
+	quint32 getCapabilities() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	quint32 caps;
+};
+
+class PacketPlayersDelta : public Packet
+{
+public:
+	PacketPlayersDelta();
+	PacketPlayersDelta(tick_t tick, const QVector<plid_t> &left, const QHash<plid_t, QString> &joined);
+
+	tick_t getTick() const;
+
+	const QVector<plid_t> &getLeft() const;
+	const QHash<plid_t, QString> &getJoined() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	tick_t tick;
+	QVector<plid_t> left;
+	QHash<plid_t, QString> joined;
+};
+
+class PacketRequestPlayers : public Packet
+{
+public:
+	PacketRequestPlayers()
+		: Packet(PACKET_REQUEST_PLAYERS)
+	{
+	}
+};
+
+class PacketRequestSpectate : public Packet
+{
+public:
+	PacketRequestSpectate();
+	PacketRequestSpectate(plid_t player, quint32 caps, quint16 codesVersion);
+
+	plid_t getPlayer() const;
+	quint32 getCapabilities() const;
+	quint16 getCodesVersion() const;
+
+protected:
+	void read(QDataStream &str) override;
+	void write(QDataStream &str) const override;
+
+private:
+	plid_t player;
+	quint32 caps;
+	quint16 codesVersion;
+};
+
 #endif // !PROTOCOL_H
@@ -0,0 +1,567 @@
+/*
+ * Implements TickCoder. The codes are canonical Huffman codes of at most
+ * MAX_BITS bits, so decoding a symbol is a single table lookup.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <vector>
+
+#include "tickcoder.h"
+
+namespace {
+
+const int MAX_BITS = 12;
+// The largest view the coder handles.
+const int MAX_SIZE = 32;
+const int PALETTE_SIZE = 8;
+
+enum Table
+{
+	ZERO_RUN,
+	REPEAT_RUN,
+	TYPE,
+	FIRST_ID,
+	TABLES = FIRST_ID + TickCoder::ID_FIELDS,
+};
+
+class BitWriter
+{
+public:
+	BitWriter(QByteArray &out)
+		: out(out)
+		, acc(0)
+		, bits(0)
+	{
+	}
+
+	void write(quint32 value, int n)
+	{
+		acc = (acc << n) | value;
+		bits += n;
+		while (bits >= 8)
+		{
+			bits -= 8;
+			out.append(static_cast<char>(acc >> bits));
+		}
+	}
+
+	void flush()
+	{
+		if (bits)
+			out.append(static_cast<char>(acc << (8 - bits)));
+		bits = 0;
+	}
+
+private:
+	QByteArray &out;
+	quint64 acc;
+	int bits;
+};
+
+/* Reads past the end as zeros, and remembers that it did. */
+class BitReader
+{
+public:
+	BitReader(const QByteArray &in)
+		: data(reinterpret_cast<const uchar *>(in.constData()))
+		, size(in.size())
+		, pos(0)
+		, acc(0)
+		, bits(0)
+		, used(0)
+	{
+	}
+
+	quint32 peek(int n)
+	{
+		while (bits < n)
+		{
+			acc = (acc << 8) | (pos < size ? data[pos] : 0);
+			pos++;
+			bits += 8;
+		}
+		return (acc >> (bits - n)) & ((1u << n) - 1);
+	}
+
+	void skip(int n)
+	{
+		bits -= n;
+		used += n;
+	}
+
+	quint32 read(int n)
+	{
+		quint32 value = peek(n);
+		skip(n);
+		return value;
+	}
+
+	bool overrun() const
+	{
+		return used > qint64(size) * 8;
+	}
+
+private:
+	const uchar *data;
+	int size;
+	int pos;
+	quint64 acc;
+	int bits;
+	qint64 used;
+};
+
+/* A canonical Huffman code for one alphabet. */
+class Code
+{
+public:
+	Code(const quint32 *counts, int n)
+		: codes(n)
+		, lengths(n)
+		, table(1 << MAX_BITS)
+	{
+		// Every symbol gets a code, however rare. Flatten the counts until
+		// no code is too long.
+		std::vector<quint64> weights(counts, counts + n);
+		for (quint64 &w : weights)
+			w++;
+		while (!buildLengths(weights))
+			for (quint64 &w : weights)
+				w = (w >> 1) | 1;
+
+		std::vector<int> order(n);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+			return lengths[a] < lengths[b];
+		});
+
+		quint32 code = 0;
+		int len = lengths[order[0]];
+		for (int s : order)
+		{
+			code <<= lengths[s] - len;
+			len = lengths[s];
+			codes[s] = code++;
+
+			int shift = MAX_BITS - len;
+			std::fill(table.begin() + (codes[s] << shift), table.begin() + ((codes[s] + 1) << shift),
+			          static_cast<quint16>((s << 4) | len));
+		}
+	}
+
+	void put(BitWriter &w, int sym) const
+	{
+		w.write(codes[sym], lengths[sym]);
+	}
+
+	int get(BitReader &r) const
+	{
+		quint16 entry = table[r.peek(MAX_BITS)];
+		r.skip(entry & 0xF);
+		return entry >> 4;
+	}
+
+private:
+	std::vector<quint16> codes;
+	std::vector<quint8> lengths;
+	// (symbol << 4) | length, by the next MAX_BITS bits.
+	std::vector<quint16> table;
+
+	bool buildLengths(const std::vector<quint64> &weights)
+	{
+		int n = weights.size();
+		std::vector<int> parent(2 * n - 1, -1);
+		typedef std::pair<quint64, int> Node;
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+		for (int i = 0; i < n; i++)
+			queue.push(Node(weights[i], i));
+
+		int next = n;
+		while (queue.size() > 1)
+		{
+			Node a = queue.top();
+			queue.pop();
+			Node b = queue.top();
+			queue.pop();
+			parent[a.second] = parent[b.second] = next;
+			queue.push(Node(a.first + b.first, next++));
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			int len = 0;
+			for (int p = parent[i]; p >= 0; p = parent[p])
+				len++;
+			if (len > MAX_BITS)
+				return false;
+			lengths[i] = len;
+		}
+		return true;
+	}
+};
+
+/* The ids used recently in a tick, most recent first. */
+class Palette
+{
+public:
+	Palette()
+		: size(0)
+	{
+	}
+
+	int find(quint8 id) const
+	{
+		for (int i = 0; i < size; i++)
+			if (ids[i] == id)
+				return i;
+		return -1;
+	}
+
+	bool has(int pos) const
+	{
+		return pos < size;
+	}
+
+	quint8 at(int pos) const
+	{
+		return ids[pos];
+	}
+
+	/* Moves the id at pos to the front, or adds it if pos is -1. */
+	void use(quint8 id, int pos)
+	{
+		if (pos < 0)
+		{
+			pos = std::min(size, PALETTE_SIZE - 1);
+			size = std::min(size + 1, PALETTE_SIZE);
+		}
+		std::move_backward(ids, ids + pos, ids + pos + 1);
+		ids[0] = id;
+	}
+
+private:
+	quint8 ids[PALETTE_SIZE];
+	int size;
+};
+
+/*
+ * Runs of up to 15 have their own symbol. Longer ones are a symbol for the
+ * power of 2 below them followed by the rest in raw bits.
+ */
+template<class Sink>
+void putRun(Sink &sink, int table, int n)
+{
+	if (n < 16)
+	{
+		sink.put(table, n);
+		return;
+	}
+
+	int k = 0;
+	while ((32 << k) <= n)
+		k++;
+	sink.put(table, 16 + k);
+	sink.raw(n - (16 << k), k + 4);
+}
+
+int getRun(BitReader &r, const Code &code)
+{
+	int sym = code.get(r);
+	if (sym < 16)
+		return sym;
+	int k = sym - 16;
+	return (16 << k) + r.read(k + 4);
+}
+
+template<class Sink>
+void putSection(Sink &sink, Palette &palette, const state_t *cells, int n)
+{
+	int i = 0;
+	while (i < n)
+	{
+		int zeros = 0;
+		while (i + zeros < n && !cells[i + zeros])
+			zeros++;
+		putRun(sink, ZERO_RUN, zeros);
+		i += zeros;
+		if (i == n)
+			break;
+
+		state_t value = cells[i];
+		quint8 type = value & 0xFF;
+		if (type < TickCoder::TYPE_SYMBOLS - 1)
+		{
+			sink.put(TYPE, type);
+		} else {
+			sink.put(TYPE, TickCoder::TYPE_SYMBOLS - 1);
+			sink.raw(type, 8);
+		}
+
+		for (int f = 0; f < TickCoder::ID_FIELDS; f++)
+		{
+			quint8 id = value >> (8 * (f + 1));
+			if (!id)
+			{
+				sink.put(FIRST_ID + f, 0);
+				continue;
+			}
+
+			int pos = palette.find(id);
+			if (pos >= 0)
+			{
+				sink.put(FIRST_ID + f, 1 + pos);
+			} else {
+				sink.put(FIRST_ID + f, 1 + PALETTE_SIZE);
+				sink.raw(id, 8);
+			}
+			palette.use(id, pos);
+		}
+
+		int repeats = 0;
+		i++;
+		while (i + repeats < n && cells[i + repeats] == value)
+			repeats++;
+		putRun(sink, REPEAT_RUN, repeats);
+		i += repeats;
+	}
+}
+
+/* Copies the diff into one block, and says whether any of it is set. */
+bool flatten(state_t const* const* diff, int size, state_t *flat)
+{
+	state_t any = 0;
+	for (int y = 0; y < size; y++)
+	{
+		const state_t *row = diff[y];
+		state_t *dst = flat + y * size;
+		for (int x = 0; x < size; x++)
+		{
+			dst[x] = row[x];
+			any |= row[x];
+		}
+	}
+	return any;
+}
+
+template<class Sink>
+void putTick(Sink &sink, const state_t *news, int size, state_t const* const* diff)
+{
+	Q_ASSERT(size <= MAX_SIZE);
+
+	state_t flat[MAX_SIZE * MAX_SIZE];
+	bool any = flatten(diff, size, flat);
+
+	Palette palette;
+	sink.raw(any, 1);
+	putSection(sink, palette, news, size);
+	if (any)
+		putSection(sink, palette, flat, size * size);
+}
+
+} // namespace
+
+struct TickCoder::Codes
+{
+	std::vector<Code> tables;
+
+	Codes()
+	{
+		tables.reserve(TABLES);
+		tables.push_back(Code(RUN_COUNTS[0], RUN_SYMBOLS));
+		tables.push_back(Code(RUN_COUNTS[1], RUN_SYMBOLS));
+		tables.push_back(Code(TYPE_COUNTS, TYPE_SYMBOLS));
+		for (int f = 0; f < ID_FIELDS; f++)
+			tables.push_back(Code(ID_COUNTS[f], ID_SYMBOLS));
+	}
+};
+
+const TickCoder::Codes &TickCoder::codes()
+{
+	static const Codes c;
+	return c;
+}
+
+namespace {
+
+class WriteSink
+{
+public:
+	WriteSink(BitWriter &w, const std::vector<Code> &tables)
+		: w(w)
+		, tables(tables)
+	{
+	}
+
+	void put(int table, int sym)
+	{
+		tables[table].put(w, sym);
+	}
+
+	void raw(quint32 value, int n)
+	{
+		w.write(value, n);
+	}
+
+private:
+	BitWriter &w;
+	const std::vector<Code> &tables;
+};
+
+class CountSink
+{
+public:
+	CountSink(TickCoder::Counts &counts)
+		: counts(counts)
+	{
+	}
+
+	void put(int table, int sym)
+	{
+		switch (table)
+		{
+		case ZERO_RUN:
+		case REPEAT_RUN:
+			counts.runs[table - ZERO_RUN][sym]++;
+			break;
+		case TYPE:
+			counts.types[sym]++;
+			break;
+		default:
+			counts.ids[table - FIRST_ID][sym]++;
+			break;
+		}
+	}
+
+	void raw(quint32, int)
+	{
+	}
+
+private:
+	TickCoder::Counts &counts;
+};
+
+bool getSection(BitReader &r, const std::vector<Code> &tables, Palette &palette, state_t *cells, int n)
+{
+	int i = 0;
+	while (i < n)
+	{
+		int zeros = getRun(r, tables[ZERO_RUN]);
+		if (zeros > n - i)
+			return false;
+		std::fill(cells + i, cells + i + zeros, 0);
+		i += zeros;
+		if (i == n)
+			break;
+
+		state_t value = tables[TYPE].get(r);
+		if (value == TickCoder::TYPE_SYMBOLS - 1)
+			value = r.read(8);
+
+		for (int f = 0; f < TickCoder::ID_FIELDS; f++)
+		{
+			int sym = tables[FIRST_ID + f].get(r);
+			quint8 id = 0;
+			if (sym > PALETTE_SIZE)
+			{
+				id = r.read(8);
+				palette.use(id, -1);
+			} else if (sym) {
+				if (!palette.has(sym - 1))
+					return false;
+				id = palette.at(sym - 1);
+				palette.use(id, sym - 1);
+			}
+			value |= state_t(id) << (8 * (f + 1));
+		}
+
+		int repeats = getRun(r, tables[REPEAT_RUN]);
+		if (repeats >= n - i)
+			return false;
+		std::fill(cells + i, cells + i + 1 + repeats, value);
+		i += 1 + repeats;
+
+		if (r.overrun())
+			return false;
+	}
+	return !r.overrun();
+}
+
+} // namespace
+
+QByteArray TickCoder::encode(const state_t *news, int size, state_t const* const* diff)
+{
+	QByteArray out;
+	out.reserve(64);
+	BitWriter w(out);
+	WriteSink sink(w, codes().tables);
+	putTick(sink, news, size, diff);
+	w.flush();
+	return out;
+}
+
+bool TickCoder::decode(const QByteArray &data, state_t *news, int size, state_t *const *diff)
+{
+	Q_ASSERT(size <= MAX_SIZE);
+
+	const std::vector<Code> &tables = codes().tables;
+	BitReader r(data);
+	Palette palette;
+
+	state_t flat[MAX_SIZE * MAX_SIZE];
+	std::fill(flat, flat + size * size, 0);
+	std::fill(news, news + size, 0);
+
+	bool any = r.read(1);
+	bool ok = getSection(r, tables, palette, news, size);
+	if (ok && any)
+		ok = getSection(r, tables, palette, flat, size * size);
+
+	for (int y = 0; y < size; y++)
+		std::copy(flat + y * size, flat + (y + 1) * size, diff[y]);
+	return ok;
+}
+
+void TickCoder::count(const state_t *news, int size, state_t const* const* diff, Counts &counts)
+{
+	CountSink sink(counts);
+	putTick(sink, news, size, diff);
+}
+
+void TickCoder::writeCounts(QTextStream &out, const Counts &counts)
+{
+	// Scale the counts down if they don't fit, which keeps their ratios.
+	quint64 most = 0;
+	for (int i = 0; i < 2; i++)
+		most = std::max(most, *std::max_element(counts.runs[i], counts.runs[i] + RUN_SYMBOLS));
+	most = std::max(most, *std::max_element(counts.types, counts.types + TYPE_SYMBOLS));
+	for (int f = 0; f < ID_FIELDS; f++)
+		most = std::max(most, *std::max_element(counts.ids[f], counts.ids[f] + ID_SYMBOLS));
+	quint64 scale = most / 0x7FFFFFFF + 1;
+
+	auto row = [&out, scale](const quint64 *values, int n, const char *end) {
+		out << "\t{";
+		for (int i = 0; i < n; i++)
+			out << (i ? ", " : " ") << values[i] / scale;
+		out << " }" << end << "\n";
+	};
+
+	out << "/*\n"
+	    << " * The symbol counts TickCoder builds its codes from, as written by\n"
+	    << " * selfplay --train-codes. See tickcoder.h.\n"
+	    << " */\n\n"
+	    << "#include \"tickcoder.h\"\n\n"
+	    << "const quint16 TickCoder::VERSION = " << VERSION + 1 << ";\n\n"
+	    << "const quint32 TickCoder::RUN_COUNTS[2][TickCoder::RUN_SYMBOLS] = {\n";
+	row(counts.runs[0], RUN_SYMBOLS, ",");
+	row(counts.runs[1], RUN_SYMBOLS, ",");
+	out << "};\n\n"
+	    << "const quint32 TickCoder::TYPE_COUNTS[TickCoder::TYPE_SYMBOLS] =\n";
+	row(counts.types, TYPE_SYMBOLS, ";");
+	out << "\n"
+	    << "const quint32 TickCoder::ID_COUNTS[TickCoder::ID_FIELDS][TickCoder::ID_SYMBOLS] = {\n";
+	for (int f = 0; f < ID_FIELDS; f++)
+		row(counts.ids[f], ID_SYMBOLS, ",");
+	out << "};\n";
+}
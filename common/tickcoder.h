@@ -0,0 +1,77 @@
+/*
+ * TickCoder packs the new row and the diff of a PACKET_GAME_TICK into a
+ * few bits. Nearly every square in a diff is 0, and the rest only hold a
+ * handful of player ids and trail types, so they code well with fixed
+ * Huffman codes. The codes are built from symbol counts kept in
+ * tickcodes.cpp, which selfplay --train-codes regenerates from self-play
+ * games. Both ends must be built with the same counts, which VERSION
+ * tells apart.
+ *
+ * The new row and then the diff are coded as runs. Each run is a count of
+ * zero squares, then a literal square, then a count of how many times the
+ * literal repeats, and so on until the row or diff is full. A literal's
+ * low byte is coded on its own and each of its player ids by where it
+ * is in a short list of the ids used recently in the tick, so that the few
+ * players in view cost a bit or two each. An all-zero diff is a single
+ * bit.
+ */
+
+#ifndef TICKCODER_H
+#define TICKCODER_H
+
+#include <QByteArray>
+#include <QTextStream>
+
+#include "types.h"
+
+class TickCoder
+{
+public:
+	/* Symbols for run lengths: 0 to 15, then one for each power of 2. */
+	static const int RUN_SYMBOLS = 23;
+	/*
+	 * Symbols for the low byte of a square, which holds its trail type and
+	 * direction: 0 to 63, then anything else.
+	 */
+	static const int TYPE_SYMBOLS = 65;
+	/* Symbols for a player id: none, the 8 recent ids, then any other. */
+	static const int ID_SYMBOLS = 10;
+	/* The trail player, occupant and owner ids of a square. */
+	static const int ID_FIELDS = 3;
+
+	static const quint16 VERSION;
+
+	/*
+	 * How often each symbol came up, which the codes are built from. The
+	 * runs are zero runs and then repeat runs.
+	 */
+	struct Counts
+	{
+		quint64 runs[2][RUN_SYMBOLS];
+		quint64 types[TYPE_SYMBOLS];
+		quint64 ids[ID_FIELDS][ID_SYMBOLS];
+	};
+
+	/* news is the row which came into view and diff has size rows. */
+	static QByteArray encode(const state_t *news, int size, state_t const* const* diff);
+	/*
+	 * Returns false if data isn't a valid coding, in which case news and
+	 * diff hold whatever could be read.
+	 */
+	static bool decode(const QByteArray &data, state_t *news, int size, state_t *const *diff);
+
+	/* Adds the symbols encode() would have used to counts. */
+	static void count(const state_t *news, int size, state_t const* const* diff, Counts &counts);
+	/* Writes counts out as a new tickcodes.cpp. */
+	static void writeCounts(QTextStream &out, const Counts &counts);
+
+private:
+	struct Codes;
+	static const Codes &codes();
+
+	static const quint32 RUN_COUNTS[2][RUN_SYMBOLS];
+	static const quint32 TYPE_COUNTS[TYPE_SYMBOLS];
+	static const quint32 ID_COUNTS[ID_FIELDS][ID_SYMBOLS];
+};
+
+#endif // !TICKCODER_H
@@ -0,0 +1,22 @@
+/*
+ * The symbol counts TickCoder builds its codes from, as written by
+ * selfplay --train-codes. See tickcoder.h.
+ */
+
+#include "tickcoder.h"
+
+const quint16 TickCoder::VERSION = 2;
+
+const quint32 TickCoder::RUN_COUNTS[2][TickCoder::RUN_SYMBOLS] = {
+	{ 1793968, 122312, 91357, 64437, 54378, 48241, 44094, 38638, 36482, 34378, 33061, 30446, 28647, 26625, 26114, 27741, 1157510, 79059, 159786, 321130, 1157796, 2260, 0 },
+	{ 3211105, 186967, 156544, 119268, 83966, 66626, 60446, 57666, 57039, 56741, 48443, 43573, 48248, 39741, 31128, 23615, 230236, 13, 6, 13, 0, 0, 0 },
+};
+
+const quint32 TickCoder::TYPE_COUNTS[TickCoder::TYPE_SYMBOLS] =
+	{ 1373237, 156851, 313629, 75476, 75601, 73914, 74706, 0, 378900, 120, 151881, 35472, 36190, 105, 112, 0, 365730, 150351, 145, 35992, 100, 34464, 81, 0, 380159, 126, 149462, 102, 93, 35623, 34765, 0, 365343, 151013, 136, 107, 35361, 99, 35934, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+const quint32 TickCoder::ID_COUNTS[TickCoder::ID_FIELDS][TickCoder::ID_SYMBOLS] = {
+	{ 2567353, 953896, 252524, 51596, 14575, 2849, 409, 52, 1, 678129 },
+	{ 1844042, 1959315, 136187, 55145, 17520, 3566, 553, 50, 2, 505004 },
+	{ 2330228, 1162788, 250462, 12161, 1226, 238, 30, 2, 0, 764249 },
+};
@@ -43,6 +43,35 @@ enum Direction
 	RIGHT	 = 4,
 };
 
+/*
+ * The change in x and y from moving one square in the given direction.
+ */
+inline int getXOff(Direction d)
+{
+	switch (d)
+	{
+	case LEFT:
+		return -1;
+	case RIGHT:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+inline int getYOff(Direction d)
+{
+	switch (d)
+	{
+	case UP:
+		return -1;
+	case DOWN:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 /*
  * The possible types of trail that can be in a square.
  */
@@ -0,0 +1,113 @@
+/*
+ * Implements UdpLink.
+ */
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QTimer>
+
+#include "udplink.h"
+
+double UdpLink::loss = 0;
+int UdpLink::delay = 0;
+int UdpLink::jitter = 0;
+
+UdpLink::UdpLink(QObject *parent)
+	: QObject(parent)
+	, socket(new QUdpSocket(this))
+	, peer()
+	, peerPort(0)
+{
+	connect(socket, &QIODevice::readyRead, this, &UdpLink::readyRead);
+}
+
+bool UdpLink::bind(quint16 port)
+{
+	return socket->bind(QHostAddress::Any, port);
+}
+
+quint16 UdpLink::localPort() const
+{
+	return socket->localPort();
+}
+
+QString UdpLink::errorString() const
+{
+	return socket->errorString();
+}
+
+void UdpLink::setPeer(const QHostAddress &addr, quint16 port)
+{
+	peer = addr;
+	peerPort = port;
+}
+
+bool UdpLink::hasPeer() const
+{
+	return !peer.isNull() && peerPort;
+}
+
+qint64 UdpLink::send(const Packet &pkt)
+{
+	if (!hasPeer())
+		return -1;
+
+	QByteArray data;
+	QDataStream str(&data, QIODevice::WriteOnly);
+	str.setVersion(QDataStream::Qt_5_0);
+	Packet::writePacket(str, pkt);
+
+	if (loss > 0 && qrand() < loss * RAND_MAX)
+		return data.size();
+
+	int wait = delay;
+	if (jitter > 0)
+		wait += qrand() % (2 * jitter + 1) - jitter;
+	if (wait <= 0)
+		return socket->writeDatagram(data, peer, peerPort);
+
+	QHostAddress addr = peer;
+	quint16 port = peerPort;
+	QTimer::singleShot(wait, this, [this, data, addr, port] {
+		socket->writeDatagram(data, addr, port);
+	});
+	return data.size();
+}
+
+bool UdpLink::hasPending() const
+{
+	return socket->hasPendingDatagrams();
+}
+
+qint64 UdpLink::pendingSize() const
+{
+	return socket->pendingDatagramSize();
+}
+
+Packet *UdpLink::receive(QHostAddress *from, quint16 *port)
+{
+	QByteArray data(std::max(socket->pendingDatagramSize(), qint64(0)), Qt::Uninitialized);
+	qint64 len = socket->readDatagram(data.data(), data.size(), from, port);
+	if (len < 0)
+		return NULL;
+	data.truncate(len);
+
+	QDataStream str(data);
+	str.setVersion(QDataStream::Qt_5_0);
+	Packet *pkt = Packet::readPacket(str);
+	if (pkt && (str.status() || !str.atEnd()))
+	{
+		qWarning() << "UDP: Dropping malformed datagram of" << len << "bytes.";
+		delete pkt;
+		return NULL;
+	}
+	return pkt;
+}
+
+void UdpLink::setImpairment(double ls, int dl, int jt)
+{
+	loss = qBound(0.0, ls, 1.0);
+	delay = std::max(dl, 0);
+	jitter = std::max(jt, 0);
+}
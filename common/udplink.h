@@ -0,0 +1,64 @@
+/*
+ * A UDP socket which carries whole packets, one per datagram. Used for
+ * game ticks, which are better dropped than delayed behind a lost one.
+ * It can also drop and delay what it sends to test how the game copes
+ * with a bad network.
+ */
+
+#ifndef UDPLINK_H
+#define UDPLINK_H
+
+#include <QHostAddress>
+#include <QUdpSocket>
+
+#include "protocol.h"
+
+class UdpLink : public QObject
+{
+	Q_OBJECT
+
+public:
+	UdpLink(QObject *parent = Q_NULLPTR);
+
+	/* Binds to the given port on every interface; 0 picks a free one. */
+	bool bind(quint16 port = 0);
+	quint16 localPort() const;
+	QString errorString() const;
+
+	/* Where send() sends to. A null address means nowhere. */
+	void setPeer(const QHostAddress &addr, quint16 port);
+	bool hasPeer() const;
+
+	/* Returns the size of the datagram, or -1 if it couldn't be sent. */
+	qint64 send(const Packet &pkt);
+
+	bool hasPending() const;
+	qint64 pendingSize() const;
+
+	/*
+	 * Reads the next datagram. Returns NULL if it doesn't hold exactly one
+	 * packet, so keep going while hasPending().
+	 */
+	Packet *receive(QHostAddress *from = Q_NULLPTR, quint16 *port = Q_NULLPTR);
+
+	/*
+	 * Every link then drops the given fraction of what it sends and
+	 * delays the rest by delay ms give or take jitter ms, which also
+	 * reorders it. Must be set before any link sends.
+	 */
+	static void setImpairment(double loss, int delay, int jitter);
+
+signals:
+	void readyRead();
+
+private:
+	QUdpSocket *socket;
+	QHostAddress peer;
+	quint16 peerPort;
+
+	static double loss;
+	static int delay;
+	static int jitter;
+};
+
+#endif // !UDPLINK_H
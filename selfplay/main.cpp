@@ -0,0 +1,213 @@
+/*
+ * This is the main entry point for paper-io self-play, which runs many
+ * AI-only games offline across every core and writes how each AI did to
+ * a CSV file. It is meant for tuning the AI and the game balance without
+ * having to watch live games.
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+
+#include "selfplaygame.h"
+
+/*
+ * Collects the results of every game as they finish. Games finish in
+ * whatever order the threads get through them, so the rows are not
+ * sorted by game.
+ */
+class Results
+{
+public:
+	Results(QTextStream &out)
+		: out(out)
+		, causes()
+		, lives(0)
+		, codeCounts()
+	{
+		SelfPlayGame::writeCSVHeader(out);
+	}
+
+	void add(const SelfPlayGame &game)
+	{
+		QMutexLocker locker(&lock);
+		game.writeCSV(out);
+		foreach (const SelfPlayGame::Life &life, game.getLives())
+			++causes[life.cause];
+		lives += game.getLives().size();
+
+		const TickCoder::Counts &counts = game.getCodeCounts();
+		for (int i = 0; i < 2; ++i)
+			for (int s = 0; s < TickCoder::RUN_SYMBOLS; ++s)
+				codeCounts.runs[i][s] += counts.runs[i][s];
+		for (int s = 0; s < TickCoder::TYPE_SYMBOLS; ++s)
+			codeCounts.types[s] += counts.types[s];
+		for (int f = 0; f < TickCoder::ID_FIELDS; ++f)
+			for (int s = 0; s < TickCoder::ID_SYMBOLS; ++s)
+				codeCounts.ids[f][s] += counts.ids[f][s];
+	}
+
+	const TickCoder::Counts &getCodeCounts() const
+	{
+		return codeCounts;
+	}
+
+	QString report() const
+	{
+		QString ret = QString("%1 lives:").arg(lives);
+		for (auto iter = causes.cbegin(); iter != causes.cend(); ++iter)
+			ret += QString(" %1 %2").arg(SelfPlayGame::getCauseName(iter.key())).arg(iter.value());
+		return ret;
+	}
+
+private:
+	QMutex lock;
+	QTextStream &out;
+	QMap<DeathCause, quint64> causes;
+	quint64 lives;
+	TickCoder::Counts codeCounts;
+};
+
+class GameJob : public QRunnable
+{
+public:
+	GameJob(Results &results, int number, pos_t width, pos_t height, plid_t players,
+	        tick_t ticks, AIDetail detail, bool countCodes)
+		: results(results)
+		, number(number)
+		, width(width)
+		, height(height)
+		, players(players)
+		, ticks(ticks)
+		, detail(detail)
+		, countCodes(countCodes)
+	{
+	}
+
+	void run() override
+	{
+		SelfPlayGame game(number, width, height, players, ticks, detail);
+		game.setCountCodes(countCodes);
+		game.run();
+		results.add(game);
+	}
+
+private:
+	Results &results;
+	const int number;
+	const pos_t width;
+	const pos_t height;
+	const plid_t players;
+	const tick_t ticks;
+	const AIDetail detail;
+	const bool countCodes;
+};
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("Arduino-IO Self-Play");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Runs AI-only paper-io games offline and records the outcomes.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{{"g", "games"}, "Number of games to run.", "count", "1000"},
+		{"ticks", "Number of ticks in each game.", "count", "2000"},
+		{"width", "Board width.", "squares", "80"},
+		{"height", "Board height.", "squares", "80"},
+		{{"n", "players"}, "Number of AIs in each game.", "count", "10"},
+		{{"t", "threads"}, "Number of games to run at once.", "count", QString::number(std::max(QThread::idealThreadCount(), 1))},
+		{"cheap", "Use the cheap AI policy instead of the search."},
+		{"seed", "Seed for spawn locations and starting directions.", "seed"},
+		{{"o", "output"}, "CSV file to write the results to.", "file", "selfplay.csv"},
+		{"train-codes", "Count the symbols of every player's game ticks and write them as a new common/tickcodes.cpp.", "file"},
+		{{"v", "verbose"}, "Print game logic debug output."},
+	});
+	parser.process(app);
+
+	int games = std::max(parser.value("games").toInt(), 1);
+	tick_t ticks = std::max(parser.value("ticks").toInt(), 1);
+	// The board has to fit a spawn area and the edge around it.
+	pos_t width = qBound(15, parser.value("width").toInt(), 1000);
+	pos_t height = qBound(15, parser.value("height").toInt(), 1000);
+	plid_t players = qBound(1, parser.value("players").toInt(), 250);
+	int threads = std::min(std::max(parser.value("threads").toInt(), 1), games);
+	AIDetail detail = parser.isSet("cheap") ? AI_CHEAP : AI_FULL;
+
+	// The game logic logs every loop it fills in, which would swamp
+	// everything at this speed.
+	if (!parser.isSet("verbose"))
+		QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false"));
+
+	// The spawns and starting directions come from rand(), which is
+	// shared by every game, so a seed only makes a single threaded run
+	// repeatable.
+	if (parser.isSet("seed"))
+		srand(parser.value("seed").toUInt());
+	else
+		srand(QDateTime::currentMSecsSinceEpoch());
+
+	QSaveFile file(parser.value("output"));
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+	{
+		qCritical() << "Unable to open" << file.fileName() << ":" << file.errorString();
+		return 1;
+	}
+	QTextStream out(&file);
+	Results results(out);
+
+	qInfo() << "Running" << games << "games of" << ticks << "ticks with" << players << "AIs on a"
+	        << width << "x" << height << "board using" << threads << "threads.";
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(threads);
+	for (int i = 0; i < games; ++i)
+		pool.start(new GameJob(results, i, width, height, players, ticks, detail, parser.isSet("train-codes")));
+	pool.waitForDone();
+
+	out.flush();
+	if (!file.commit())
+	{
+		qCritical() << "Unable to write" << file.fileName() << ":" << file.errorString();
+		return 1;
+	}
+
+	if (parser.isSet("train-codes"))
+	{
+		QSaveFile codes(parser.value("train-codes"));
+		if (!codes.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			qCritical() << "Unable to open" << codes.fileName() << ":" << codes.errorString();
+			return 1;
+		}
+		QTextStream codesOut(&codes);
+		TickCoder::writeCounts(codesOut, results.getCodeCounts());
+		codesOut.flush();
+		if (!codes.commit())
+		{
+			qCritical() << "Unable to write" << codes.fileName() << ":" << codes.errorString();
+			return 1;
+		}
+		qInfo() << "Tick code counts written to" << codes.fileName();
+	}
+
+	double secs = std::max(timer.nsecsElapsed() / 1e9, 1e-9);
+	qInfo() << qPrintable(QString("Ran %1 ticks in %2s (%3 ticks/s, %4 ticks/s per thread).")
+	                      .arg(quint64(games) * ticks).arg(secs, 0, 'f', 1)
+	                      .arg(games * double(ticks) / secs, 0, 'f', 0)
+	                      .arg(games * double(ticks) / secs / threads, 0, 'f', 0));
+	qInfo() << qPrintable(results.report());
+	qInfo() << "Results written to" << file.fileName();
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+# Main Config
+TEMPLATE = app
+TARGET = selfplay
+CONFIG += c++11 console release
+CONFIG -= app_bundle
+
+# Build/Install Directories
+MOC_DIR = $$PWD/../build/selfplay/moc
+OBJECTS_DIR = $$PWD/../build/selfplay/obj
+RCC_DIR = $$PWD/../build/selfplay/rcc
+DESTDIR = $$PWD/../bin
+
+# Meta Inputs
+QT = core
+
+# Inputs
+INCLUDEPATH += . $$PWD/../server $$PWD/../common
+HEADERS += selfplaygame.h \
+# Server files
+	../server/aifields.h \
+	../server/aiplayer.h \
+	../server/gamelogic.h \
+	../server/gamestate.h \
+	../server/metrics.h \
+	../server/trace.h \
+# Common files
+	../common/aiengine.h \
+	../common/tickcoder.h \
+	../common/types.h
+SOURCES += main.cpp \
+	selfplaygame.cpp \
+# Server files
+	../server/aifields.cpp \
+	../server/aiplayer.cpp \
+	../server/gamelogic.cpp \
+	../server/gamestate.cpp \
+	../server/metrics.cpp \
+	../server/player.cpp \
+	../server/squarestate.cpp \
+	../server/trace.cpp \
+# Common files
+	../common/tickcoder.cpp \
+	../common/tickcodes.cpp
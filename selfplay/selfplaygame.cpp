@@ -0,0 +1,219 @@
+/*
+ * Implements SelfPlayGame.
+ */
+
+#include "gamelogic.h"
+#include "protocol.h"
+#include "selfplaygame.h"
+
+// Nothing depends on the tick rate without a clock, so use the server's.
+const quint16 TICK_RATE = 250;
+
+SelfPlayGame::SelfPlayGame(int num, pos_t w, pos_t h, plid_t pc, tick_t t, AIDetail dt)
+	: number(num)
+	, playerCount(pc)
+	, ticks(t)
+	, detail(dt)
+	, gs(w, h, TICK_RATE)
+	, ais()
+	, fields()
+	, currentId(1)
+	, alive()
+	, lives()
+	, countCodes(false)
+	, codeCounts()
+{
+}
+
+SelfPlayGame::~SelfPlayGame()
+{
+	foreach (AIPlayer *aip, ais)
+		delete aip;
+}
+
+void SelfPlayGame::run()
+{
+	spawnPlayers();
+
+	while (gs.getTick() < ticks)
+	{
+		moveAIs();
+
+		gs.nextTick();
+		updateGame(gs);
+
+		if (countCodes)
+			countTicks();
+		recordScores();
+		removePlayers();
+
+		if (gs.players.size() < playerCount)
+			spawnPlayers();
+	}
+
+	finish();
+}
+
+const std::vector<SelfPlayGame::Life> &SelfPlayGame::getLives() const
+{
+	return lives;
+}
+
+void SelfPlayGame::setCountCodes(bool count)
+{
+	countCodes = count;
+}
+
+const TickCoder::Counts &SelfPlayGame::getCodeCounts() const
+{
+	return codeCounts;
+}
+
+void SelfPlayGame::moveAIs()
+{
+	fields.update(gs, ais.keys());
+
+	for (auto iter = ais.cbegin(); iter != ais.cend(); ++iter)
+	{
+		Player *pl = gs.lookupPlayer(iter.key());
+		if (pl)
+			pl->newDir = iter.value()->tick(gs, fields);
+	}
+}
+
+void SelfPlayGame::countTicks()
+{
+	state_t news[CLIENT_FRAME];
+	state_t *dptrs[CLIENT_FRAME];
+	state_t *bptrs[CLIENT_FRAME];
+	foreach (const Player *pl, gs.players)
+	{
+		if (!pl)
+			continue;
+		gs.getTickView(pl, news, dptrs, bptrs);
+		TickCoder::count(news, CLIENT_FRAME, dptrs, codeCounts);
+	}
+}
+
+void SelfPlayGame::recordScores()
+{
+	for (auto iter = alive.begin(); iter != alive.end(); ++iter)
+	{
+		const Player *pl = gs.lookupPlayer(iter.key());
+		if (!pl)
+			continue;
+
+		Life &life = iter.value();
+		int gained = int(pl->getScore()) - int(life.finalScore);
+		if (gained > 0)
+		{
+			++life.captures;
+			life.captured += gained;
+			life.largestCapture = std::max(life.largestCapture, gained);
+		}
+		life.finalScore = pl->getScore();
+		life.maxScore = std::max(life.maxScore, life.finalScore);
+	}
+}
+
+void SelfPlayGame::removePlayers()
+{
+	for (auto iter = gs.players.begin(); iter != gs.players.end(); )
+	{
+		Player *pl = iter.value();
+		if (!pl || !pl->isDead())
+		{
+			iter++;
+			continue;
+		}
+
+		Life life = alive.take(iter.key());
+		life.ended = gs.getTick();
+		life.cause = pl->getDeathCause();
+		lives.push_back(life);
+
+		delete ais.take(iter.key());
+
+		iter = gs.removePlayer(iter);
+	}
+}
+
+void SelfPlayGame::spawnPlayers()
+{
+	std::vector<std::pair<pos_t, pos_t> > spawns = findSpawns(playerCount - gs.players.size(), gs);
+	for (auto siter = spawns.begin(); siter < spawns.end(); siter++)
+	{
+		if (!gs.addPlayer(currentId, QString("AI %1").arg(currentId), siter->first, siter->second))
+			continue;
+
+		AIPlayer *ai = new AIPlayer(currentId);
+		ai->setDetail(detail);
+		ais.insert(currentId, ai);
+
+		Player *pl = gs.lookupPlayer(currentId);
+		configureSpawn(pl, gs);
+		alive.insert(currentId, Life{currentId, gs.getTick(), 0, pl->getScore(), pl->getScore(),
+		                             0, 0, 0, DEATH_NONE});
+
+		findNextId();
+	}
+}
+
+void SelfPlayGame::findNextId()
+{
+	while (gs.players.contains(currentId) || currentId == UNOCCUPIED
+	                                      || currentId == OUT_OF_BOUNDS)
+		currentId++;
+}
+
+void SelfPlayGame::finish()
+{
+	for (auto iter = alive.begin(); iter != alive.end(); ++iter)
+	{
+		Life life = iter.value();
+		life.ended = gs.getTick();
+		lives.push_back(life);
+	}
+	alive.clear();
+}
+
+void SelfPlayGame::writeCSVHeader(QTextStream &out)
+{
+	out << "game,player,spawn_tick,end_tick,survival_ticks,final_score,max_score,"
+	       "captures,captured_squares,largest_capture,death_cause\n";
+}
+
+void SelfPlayGame::writeCSV(QTextStream &out) const
+{
+	foreach (const Life &life, lives)
+	{
+		out << number << ',' << int(life.id) << ',' << life.spawned << ',' << life.ended << ','
+		    << life.ended - life.spawned << ',' << life.finalScore << ',' << life.maxScore << ','
+		    << life.captures << ',' << life.captured << ',' << life.largestCapture << ','
+		    << getCauseName(life.cause) << '\n';
+	}
+}
+
+const char *SelfPlayGame::getCauseName(DeathCause cause)
+{
+	switch (cause)
+	{
+	case DEATH_NONE:
+		return "alive";
+	case DEATH_WALL:
+		return "wall";
+	case DEATH_COLLISION:
+		return "collision";
+	case DEATH_RUN_OVER:
+		return "run_over";
+	case DEATH_OWN_TRAIL:
+		return "own_trail";
+	case DEATH_TRAIL_CUT:
+		return "trail_cut";
+	case DEATH_WON:
+		return "won";
+	case DEATH_DISCONNECT:
+		return "disconnect";
+	}
+	return "unknown";
+}
@@ -0,0 +1,89 @@
+/*
+ * SelfPlayGame runs a single game with only AIs, as fast as it can, and
+ * records how each AI fared. It follows the same steps as
+ * GameHandler::tick() with the same game logic, but has no networking, no
+ * locking and no tick timer; ticks simply happen one after another.
+ */
+
+#ifndef SELFPLAYGAME_H
+#define SELFPLAYGAME_H
+
+#include <QHash>
+#include <QTextStream>
+#include <vector>
+
+#include "aifields.h"
+#include "aiplayer.h"
+#include "gamestate.h"
+#include "tickcoder.h"
+#include "types.h"
+
+class SelfPlayGame
+{
+public:
+	/*
+	 * The outcome of one AI, from when it spawned until it died or the
+	 * game ended. Captures are the net number of squares the AI gained
+	 * in a single tick, which is how big its completed loops were.
+	 */
+	struct Life
+	{
+		plid_t id;
+		tick_t spawned;
+		tick_t ended;
+		score_t finalScore;
+		score_t maxScore;
+		int captures;
+		int captured;
+		int largestCapture;
+		DeathCause cause;
+	};
+
+	SelfPlayGame(int number, pos_t width, pos_t height, plid_t playerCount,
+	             tick_t ticks, AIDetail detail);
+	~SelfPlayGame();
+
+	void run();
+
+	const std::vector<Life> &getLives() const;
+
+	/*
+	 * Counts the symbols TickCoder would use for every player's ticks, as
+	 * if each were a connected client.
+	 */
+	void setCountCodes(bool count);
+	const TickCoder::Counts &getCodeCounts() const;
+
+	/* The header for the rows written by writeCSV(). */
+	static void writeCSVHeader(QTextStream &out);
+	void writeCSV(QTextStream &out) const;
+
+	static const char *getCauseName(DeathCause cause);
+
+private:
+	const int number;
+	const plid_t playerCount;
+	const tick_t ticks;
+	const AIDetail detail;
+
+	GameState gs;
+	QHash<plid_t, AIPlayer *> ais;
+	AIFields fields;
+	plid_t currentId;
+
+	QHash<plid_t, Life> alive;
+	std::vector<Life> lives;
+
+	bool countCodes;
+	TickCoder::Counts codeCounts;
+
+	void moveAIs();
+	void countTicks();
+	void recordScores();
+	void removePlayers();
+	void spawnPlayers();
+	void findNextId();
+	void finish();
+};
+
+#endif // !SELFPLAYGAME_H
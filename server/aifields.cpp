@@ -0,0 +1,147 @@
+/*
+ * Implements AIFields.
+ *
+ * Both kinds of field are taxicab distance transforms computed with the
+ * same two raster passes as aiDistanceTransform(). The head field keeps
+ * two heads per square, so it has its own copy of the passes.
+ */
+
+#include "aifields.h"
+#include "trace.h"
+
+const int AIFields::UNREACHABLE;
+
+AIFields::AIFields()
+	: width(0)
+	, height(0)
+	, fieldIndex()
+	, territory()
+	, heads()
+{
+}
+
+void AIFields::update(const GameState &gs, const QList<plid_t> &ais)
+{
+	TRACE_SCOPE("AIFields::update");
+
+	width = gs.getWidth();
+	height = gs.getHeight();
+	const size_t area = size_t(width) * height;
+
+	fieldIndex.clear();
+	territory.resize(ais.size() * area);
+	for (int i = 0; i < ais.size(); ++i)
+	{
+		fieldIndex.insert(ais[i], i);
+		computeTerritory(gs, ais[i], territory.data() + i * area);
+	}
+
+	heads.resize(area);
+	computeHeads(gs);
+}
+
+int AIFields::getTerritoryDistance(plid_t id, pos_t x, pos_t y) const
+{
+	if (x < 0 || x >= width || y < 0 || y >= height)
+		return UNREACHABLE;
+
+	auto iter = fieldIndex.constFind(id);
+	if (iter == fieldIndex.cend())
+		return UNREACHABLE;
+
+	return territory[size_t(iter.value()) * width * height + size_t(y) * width + x];
+}
+
+int AIFields::getEnemyHeadDistance(plid_t id, pos_t x, pos_t y) const
+{
+	if (x < 0 || x >= width || y < 0 || y >= height)
+		return UNREACHABLE;
+
+	const HeadDistance &hd = heads[size_t(y) * width + x];
+	return hd.id1 == id ? hd.d2 : hd.d1;
+}
+
+void AIFields::computeTerritory(const GameState &gs, plid_t id, quint16 *field)
+{
+	aiDistanceTransform(field, width, height, [&gs, id](int x, int y) {
+		return getStateOwningPlayer(gs.board[y][x]) == id;
+	});
+}
+
+/*
+ * Offers a head at the given distance to a square, keeping the two nearest
+ * heads belonging to different players.
+ */
+void AIFields::offerHead(HeadDistance &hd, int d, plid_t id)
+{
+	if (id == NULL_ID || d >= UNREACHABLE)
+		return;
+
+	if (id == hd.id1)
+	{
+		hd.d1 = std::min(hd.d1, quint16(d));
+	} else if (id == hd.id2) {
+		if (d < hd.d2)
+			hd.d2 = quint16(d);
+		if (hd.d2 < hd.d1)
+		{
+			std::swap(hd.d1, hd.d2);
+			std::swap(hd.id1, hd.id2);
+		}
+	} else if (d < hd.d1) {
+		hd.d2 = hd.d1;
+		hd.id2 = hd.id1;
+		hd.d1 = quint16(d);
+		hd.id1 = id;
+	} else if (d < hd.d2) {
+		hd.d2 = quint16(d);
+		hd.id2 = id;
+	}
+}
+
+void AIFields::pullHeads(HeadDistance &hd, const HeadDistance &from)
+{
+	offerHead(hd, from.d1 + 1, from.id1);
+	offerHead(hd, from.d2 + 1, from.id2);
+}
+
+void AIFields::computeHeads(const GameState &gs)
+{
+	std::fill(heads.begin(), heads.end(), HeadDistance{UNREACHABLE, UNREACHABLE, NULL_ID, NULL_ID});
+
+	foreach (const Player *pl, gs.players)
+	{
+		if (!pl || pl->isDead())
+			continue;
+
+		HeadDistance &hd = heads[size_t(pl->getY()) * width + pl->getX()];
+		offerHead(hd, 0, pl->getId());
+	}
+
+	// Keeping the two nearest distinct heads is still exact: if a head is
+	// one of the two nearest to a square, it is one of the two nearest to
+	// every square along a shortest path to it, so it is never dropped.
+	for (pos_t y = 0; y < height; ++y)
+	{
+		HeadDistance *row = heads.data() + size_t(y) * width;
+		for (pos_t x = 0; x < width; ++x)
+		{
+			if (x > 0)
+				pullHeads(row[x], row[x - 1]);
+			if (y > 0)
+				pullHeads(row[x], row[x - width]);
+		}
+	}
+
+	for (pos_t y = height - 1; y >= 0; --y)
+	{
+		HeadDistance *row = heads.data() + size_t(y) * width;
+		for (pos_t x = width - 1; x >= 0; --x)
+		{
+			if (x < width - 1)
+				pullHeads(row[x], row[x + 1]);
+			if (y < height - 1)
+				pullHeads(row[x], row[x + width]);
+		}
+	}
+}
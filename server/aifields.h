@@ -0,0 +1,75 @@
+/*
+ * AIFields holds distance fields over the whole board which are computed
+ * once per tick and shared by every AI in the game, so that the AIs don't
+ * each have to search the board themselves.
+ *
+ * For every AI there is the distance from each square to the nearest
+ * square of that AI's territory. For every square there is also the
+ * distance to the nearest player's head, along with the distance to the
+ * nearest head of a different player, so each AI can find its nearest
+ * enemy. All distances are in moves (taxicab distance).
+ */
+
+#ifndef AIFIELDS_H
+#define AIFIELDS_H
+
+#include <QHash>
+#include <QList>
+#include <vector>
+
+#include "aiengine.h"
+#include "gamestate.h"
+#include "types.h"
+
+class AIFields
+{
+public:
+	/* The distance reported when there is nothing to be found. */
+	static const int UNREACHABLE = AI_UNREACHABLE;
+
+	AIFields();
+
+	/*
+	 * Recomputes the fields for the given AIs. The GameState must be
+	 * locked for at least reading.
+	 */
+	void update(const GameState &gs, const QList<plid_t> &ais);
+
+	/*
+	 * The distance from the square to the nearest square owned by the
+	 * given AI. Out of bounds squares and players which weren't passed to
+	 * update() report UNREACHABLE.
+	 */
+	int getTerritoryDistance(plid_t id, pos_t x, pos_t y) const;
+
+	/*
+	 * The distance from the square to the nearest head of any player
+	 * other than the given one. Out of bounds squares report UNREACHABLE.
+	 */
+	int getEnemyHeadDistance(plid_t id, pos_t x, pos_t y) const;
+
+private:
+	struct HeadDistance
+	{
+		quint16 d1;
+		quint16 d2;
+		plid_t id1;
+		plid_t id2;
+	};
+
+	pos_t width;
+	pos_t height;
+
+	// Which of the territory fields belongs to each AI.
+	QHash<plid_t, int> fieldIndex;
+	std::vector<quint16> territory;
+	std::vector<HeadDistance> heads;
+
+	void computeTerritory(const GameState &gs, plid_t id, quint16 *field);
+	void computeHeads(const GameState &gs);
+
+	static void offerHead(HeadDistance &hd, int d, plid_t id);
+	static void pullHeads(HeadDistance &hd, const HeadDistance &from);
+};
+
+#endif // !AIFIELDS_H
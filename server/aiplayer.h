@@ -1,26 +1,91 @@
 /*
- * This class represents an AI Player in the game.
+ * This class represents an AI Player in the game. The AI itself lives in
+ * common/aiengine.h; this feeds it the GameState and the shared fields.
  */
 
 #ifndef AIPLAYER_H
 #define AIPLAYER_H
 
+#include "aiengine.h"
+#include "aifields.h"
 #include "gamestate.h"
 #include "protocol.h"
 
+/*
+ * The AIEngine's view of the server's board, which reads the board
+ * directly rather than through SquareState.
+ */
+class GameBoardView
+{
+public:
+	GameBoardView(const GameState &gs, const AIFields &fields, const Player &pl)
+		: gs(gs)
+		, fields(fields)
+		, pl(pl)
+	{
+	}
+
+	plid_t getId() const
+	{
+		return pl.getId();
+	}
+
+	pos_t getX() const
+	{
+		return pl.getX();
+	}
+
+	pos_t getY() const
+	{
+		return pl.getY();
+	}
+
+	Direction getDirection() const
+	{
+		return pl.getActualDirection();
+	}
+
+	state_t getState(pos_t x, pos_t y) const
+	{
+		if (x < 0 || x >= gs.width || y < 0 || y >= gs.height)
+			return OUT_OF_BOUNDS_STATE;
+		return gs.board[y][x];
+	}
+
+	int getTerritoryDistance(pos_t x, pos_t y) const
+	{
+		return fields.getTerritoryDistance(pl.getId(), x, y);
+	}
+
+	int getEnemyHeadDistance(pos_t x, pos_t y) const
+	{
+		return fields.getEnemyHeadDistance(pl.getId(), x, y);
+	}
+
+private:
+	const GameState &gs;
+	const AIFields &fields;
+	const Player &pl;
+};
+
 class AIPlayer
 {
 public:
 	AIPlayer(plid_t player);
 
-	Direction tick(const GameState &gs);
+	void setDetail(AIDetail detail);
+
+	/*
+	 * Picks our next move. The fields must have been updated for
+	 * this tick with us included. See AIEngine::tick() for the budget.
+	 */
+	Direction tick(const GameState &gs, const AIFields &fields, qint64 budget = 0);
+
+	/* How many moves ahead the last call to tick() looked. */
+	int getLastDepth() const;
 private:
 	const plid_t id;
-	int traillen;
-	int heur[CLIENT_FRAME][CLIENT_FRAME];
-
-	double assessDirection(const GameState &pgs, Direction d, pos_t x, pos_t y, int traillen, int recurse = 5);
-	int computeDistance(const GameState &cgs, pos_t x, pos_t y);
+	AIEngine<GameBoardView> engine;
 };
 
 #endif // !AIPLAYER_H
@@ -0,0 +1,170 @@
+/*
+ * Implements AIPool.
+ */
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "aipool.h"
+#include "metrics.h"
+#include "trace.h"
+
+// Every game shares the same workers.
+static QThreadPool &workers()
+{
+	static QThreadPool pool;
+	return pool;
+}
+
+class AIPool::Job : public QRunnable
+{
+public:
+	Job(AIPool &p)
+		: pool(p)
+	{
+		// The pool keeps its jobs so that collect() can take back the ones
+		// which haven't started.
+		setAutoDelete(false);
+	}
+
+	void run() override
+	{
+		pool.work();
+	}
+
+private:
+	AIPool &pool;
+};
+
+AIPool::AIPool()
+	: gs(Q_NULLPTR)
+	, fields(Q_NULLPTR)
+	, entries()
+	, jobs()
+	, deadline(0)
+	, budget(0)
+	, next(0)
+	, abort(0)
+	, lock()
+	, idle()
+	, running(0)
+	, started(0)
+	, finished(0)
+	, lastDuration(0)
+	, lastDepth(0)
+{
+}
+
+AIPool::~AIPool()
+{
+	QList<plid_t> late;
+	collect(late);
+}
+
+void AIPool::dispatch(GameState &g, const AIFields &fs, const QHash<plid_t, AIPlayer *> &ais,
+                      qint64 dl, qint64 bdg)
+{
+	// Make sure the previous batch is finished with.
+	QList<plid_t> late;
+	collect(late);
+
+	gs = &g;
+	fields = &fs;
+	deadline = dl;
+	budget = bdg;
+
+	entries.clear();
+	entries.reserve(ais.size());
+	for (auto iter = ais.cbegin(); iter != ais.cend(); ++iter)
+		entries.push_back(Entry{iter.key(), iter.value(), NONE, 0, false});
+
+	next.store(0);
+	abort.store(0);
+	started = Metrics::now();
+	finished = started;
+
+	int count = std::min<int>(entries.size(), workers().maxThreadCount());
+	while (int(jobs.size()) < count)
+		jobs.emplace_back(new Job(*this));
+
+	lock.lock();
+	running = count;
+	lock.unlock();
+
+	for (int i = 0; i < count; ++i)
+		workers().start(jobs[i].get());
+}
+
+void AIPool::work()
+{
+	TRACE_SCOPE("AIPool::work");
+
+	while (!abort.load())
+	{
+		int i = next.fetchAndAddRelaxed(1);
+		if (i >= int(entries.size()) || Metrics::now() > deadline)
+			break;
+
+		Entry &e = entries[i];
+		gs->lockForRead();
+		e.dir = e.ai->tick(*gs, *fields, budget);
+		gs->unlock();
+		e.depth = e.ai->getLastDepth();
+		e.done = true;
+	}
+
+	// The lock publishes our entries to collect().
+	lock.lock();
+	finished = std::max(finished, Metrics::now());
+	if (--running == 0)
+		idle.wakeAll();
+	lock.unlock();
+}
+
+QHash<plid_t, Direction> AIPool::collect(QList<plid_t> &late)
+{
+	abort.store(1);
+
+	// Our jobs which haven't started would only be waited on behind every
+	// other game's, and would find nothing to do anyway.
+	int taken = 0;
+	for (const auto &job : jobs)
+		if (workers().tryTake(job.get()))
+			++taken;
+
+	lock.lock();
+	running -= taken;
+	while (running)
+		idle.wait(&lock);
+	lastDuration = finished - started;
+	lock.unlock();
+
+	QHash<plid_t, Direction> ret;
+	ret.reserve(entries.size());
+	int depth = 0;
+	foreach (const Entry &e, entries)
+	{
+		if (e.done)
+		{
+			ret.insert(e.id, e.dir);
+			depth += e.depth;
+		} else {
+			late.append(e.id);
+		}
+	}
+	if (!ret.isEmpty())
+		lastDepth = double(depth) / ret.size();
+	entries.clear();
+
+	return ret;
+}
+
+qint64 AIPool::getLastDuration() const
+{
+	return lastDuration;
+}
+
+double AIPool::getLastDepth() const
+{
+	return lastDepth;
+}
@@ -0,0 +1,91 @@
+/*
+ * AIPool computes the AIs' moves for a game on a shared pool of worker
+ * threads, so the game thread only has to hand out the work after a tick
+ * and pick up the results before the next one.
+ *
+ * The workers each take the GameState read lock while deciding a single
+ * AI's move, so IO threads and the game thread can get in between AIs.
+ * Any AI which hasn't been started by the deadline or by the time the
+ * results are collected is skipped, and so collecting only waits on the
+ * workers already busy with this game.
+ */
+
+#ifndef AIPOOL_H
+#define AIPOOL_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <memory>
+#include <vector>
+
+#include "aifields.h"
+#include "aiplayer.h"
+#include "gamestate.h"
+#include "types.h"
+
+class AIPool
+{
+public:
+	AIPool();
+	/* Waits for any work in flight. */
+	~AIPool();
+
+	/*
+	 * Starts deciding the next move of each of the given AIs against the
+	 * current state. The AIs and fields must stay alive and unchanged
+	 * until collect() returns, and nothing may write to the GameState in
+	 * the meantime. The caller must not hold the GameState lock. The
+	 * deadline is in Metrics::now() time. Each AI may search for up to
+	 * budget nanoseconds (see AIPlayer::tick()).
+	 */
+	void dispatch(GameState &gs, const AIFields &fields, const QHash<plid_t, AIPlayer *> &ais,
+	              qint64 deadline, qint64 budget);
+
+	/*
+	 * Stops handing out work, waits for the AIs currently being decided,
+	 * and returns the moves that were made. AIs which were not decided are
+	 * returned in late. Must be called before the GameState is written.
+	 */
+	QHash<plid_t, Direction> collect(QList<plid_t> &late);
+
+	/* How long the last collected batch took from dispatch to finishing. */
+	qint64 getLastDuration() const;
+	/* The average search depth of the AIs in the last collected batch. */
+	double getLastDepth() const;
+
+private:
+	class Job;
+
+	struct Entry
+	{
+		plid_t id;
+		AIPlayer *ai;
+		Direction dir;
+		int depth;
+		bool done;
+	};
+
+	GameState *gs;
+	const AIFields *fields;
+	std::vector<Entry> entries;
+	std::vector<std::unique_ptr<Job>> jobs;
+	qint64 deadline;
+	qint64 budget;
+
+	QAtomicInt next;
+	QAtomicInt abort;
+
+	QMutex lock;
+	QWaitCondition idle;
+	int running;
+	qint64 started;
+	qint64 finished;
+	qint64 lastDuration;
+	double lastDepth;
+
+	void work();
+};
+
+#endif // !AIPOOL_H
@@ -3,11 +3,15 @@
  */
 
 #include <QHostAddress>
+#include <QThread>
 
 #include "clienthandler.h"
 #include "protocol.h"
+#include "tickcoder.h"
+#include "trace.h"
 
 thid_t ClientHandler::idCount = 0;
+quint32 ClientHandler::offered = CAPABILITIES;
 
 ClientHandler::ClientHandler(QObject *parent)
 	: QObject(parent)
@@ -16,8 +20,27 @@ ClientHandler::ClientHandler(QObject *parent)
 	, socket(new QTcpSocket(this))
 	, state(LIMBO)
 	, player(NULL_ID)
+	, spectating(false)
+	, feed(NULL)
 	, name(QLatin1String(""))
+	, timeSync(false)
+	, capsJoin(false)
+	, caps(0)
+	, clock()
+	, playersSent(0)
+	, udp(NULL)
+	, udpToken(0)
+	, acked(0)
+	, labels(Metrics::label("connection", id))
+	, sentBytes(Metrics::instance().counter("paper_connection_sent_bytes_total",
+	            "Bytes sent to a connection.", labels))
+	, sentPackets(Metrics::instance().counter("paper_connection_sent_packets_total",
+	              "Packets sent to a connection.", labels))
+	, roundTrip(Metrics::instance().histogram("paper_connection_rtt_seconds",
+	            "Round trip times measured with a connection's time syncs.", labels))
 {
+	std::fill(views, views + GameState::DIFF_HISTORY, SentView{0, 0, 0});
+
 	// Note that due to not locking this makes the constructor not
 	// thread safe.
 	ClientHandler::idCount++;
@@ -35,6 +58,19 @@ ClientHandler::ClientHandler(QObject *parent)
 	connect(socket, &QAbstractSocket::disconnected, this, &ClientHandler::disconnected);
 	connect(socket, &QAbstractSocket::disconnected, keepAlive, &QTimer::stop);
 	connect(socket, &QIODevice::readyRead, this, &ClientHandler::newData);
+	connect(socket, &QIODevice::bytesWritten, this, [this] (qint64 bytes) {
+		sentBytes->inc(bytes);
+	});
+}
+
+ClientHandler::~ClientHandler()
+{
+	Metrics::instance().remove(labels);
+}
+
+void ClientHandler::setCapabilities(quint32 cp)
+{
+	offered = cp & CAPABILITIES;
 }
 
 thid_t ClientHandler::getId() const
@@ -48,7 +84,7 @@ void ClientHandler::enqueue()
 	player = NULL_ID;
 	gs = NULL;
 
-	Packet::writePacket(str, PacketQueued());
+	send(PacketQueued());
 }
 
 void ClientHandler::beginGame(plid_t pid, GameState *g)
@@ -77,7 +113,13 @@ void ClientHandler::beginGame(plid_t pid, GameState *g)
 	player = pid;
 	gs = g;
 
-	Packet::writePacket(str, PacketGameJoin(pid, pl->getScore(), gs->getWidth() * gs->getHeight(), gs->getTickRate(), makePPU(), makePLU(), makePRB()));
+	PacketGameJoin pgj(pid, pl->getScore(), gs->getWidth() * gs->getHeight(), gs->getTickRate(), makePPU(), makePLU(), makePRB());
+	if (capsJoin)
+		send(PacketGameJoinCaps(caps, pgj));
+	else
+		send(pgj);
+	acked = gs->getTick();
+	playersSent = gs->getTick();
 	gs->unlock();
 }
 
@@ -92,13 +134,71 @@ void ClientHandler::endGame(score_t score)
 	state = LIMBO;
 	player = NULL_ID;
 	gs = NULL;
+	spectating = false;
+	feed = NULL;
+
+	send(PacketGameEnd(score));
+}
+
+void ClientHandler::beginSpectating(plid_t target, GameState *g, SpectatorFeed *f)
+{
+	if (state == INGAME)
+	{
+		qWarning() << "Connection" << id << ": beginSpectating() received while in game!";
+		emit stoppedSpectating();
+		return;
+	}
+	if (!g || !f)
+	{
+		qCritical() << "Connection" << id << ": beginSpectating() passed NULL GameState or SpectatorFeed!";
+		emit stoppedSpectating();
+		return;
+	}
+
+	g->lockForRead();
+	state = INGAME;
+	spectating = true;
+	gs = g;
+	feed = f;
+	follow(target);
+	sendSpectatorJoin();
+	gs->unlock();
+}
+
+void ClientHandler::follow(plid_t target)
+{
+	if (target != NULL_ID && !gs->lookupPlayer(target))
+		target = gs->leaderboard[0].first;
+	if (target != NULL_ID && !gs->lookupPlayer(target))
+		target = NULL_ID;
+
+	player = target;
+	qDebug() << "Connection" << id << ": Spectating player" << player;
+}
+
+void ClientHandler::stopSpectating()
+{
+	state = LIMBO;
+	player = NULL_ID;
+	gs = NULL;
+	spectating = false;
+	feed = NULL;
 
-	Packet::writePacket(str, PacketGameEnd(score));
+	emit stoppedSpectating();
+}
+
+void ClientHandler::sendSpectatorJoin()
+{
+	const Player *pl = gs->lookupPlayer(player);
+	PacketGameJoin pgj(player, pl ? pl->getScore() : 0, gs->getWidth() * gs->getHeight(), gs->getTickRate(), makePPU(), makePLU(), makePRB());
+	send(PacketGameJoinCaps(caps, pgj));
+	playersSent = gs->getTick();
 }
 
 void ClientHandler::sendTick()
 {
 	qDebug() << "Sending tick...";
+	TRACE_SCOPE("ClientHandler::sendTick");
 	if (state != INGAME || !gs)
 	{
 		qWarning() << "Connection" << id <<": Received sendTick() while not in game or with invalid game state!";
@@ -107,6 +207,13 @@ void ClientHandler::sendTick()
 
 	gs->lockForRead();
 
+	if (spectating)
+	{
+		sendSpectatorTick();
+		gs->unlock();
+		return;
+	}
+
 	Player *pl = gs->lookupPlayer(player);
 	if (!pl)
 	{
@@ -115,71 +222,164 @@ void ClientHandler::sendTick()
 		return;
 	}
 
+	if (udp && udp->hasPeer())
+		sendDeltaTick(pl);
+	else
+		sendGameTick(pl);
+
+	sendPlayers();
+
+	if (gs->hasLeaderboardChanged())
+		send(makePLU());
+
+	gs->unlock();
+}
+
+void ClientHandler::sendPlayers()
+{
+	// If the ticks got ahead of us, the ones we skipped may have changed
+	// the players too.
+	if (gs->getTick() > playersSent + 1)
+	{
+		qDebug() << "Connection" << id << ": Skipped ticks" << playersSent + 1 << "to" << gs->getTick() - 1 << ", sending all players.";
+		send(makePPU());
+	} else if (gs->havePlayersChanged()) {
+		if (caps & CAP_PLAYER_DELTAS)
+			send(makePPD());
+		else
+			send(makePPU());
+	}
+	playersSent = gs->getTick();
+}
+
+void ClientHandler::sendGameTick(Player *pl)
+{
 	pos_t px = pl->getX() - (CLIENT_FRAME / 2);
 	pos_t py = pl->getY() - (CLIENT_FRAME / 2);
-	pos_t my = gs->getHeight();
-	pos_t mx = gs->getWidth();
 	state_t news[CLIENT_FRAME];
+	state_t *dptrs[CLIENT_FRAME];
+	state_t *bptrs[CLIENT_FRAME];
+	gs->getTickView(pl, news, dptrs, bptrs);
+
+	QByteArray chksum = hashBoard(bptrs, 0, boardHash());
+	rememberView(gs->getTick(), px, py);
 
-	// Compute the new row.
-	switch (pl->getActualDirection())
+	PacketGameTick pgt(gs->getTick(), pl->getActualDirection(), pl->getScore(), news, dptrs, chksum);
+	if (timeSync)
+		pgt.setTimestamp(Metrics::now());
+	pgt.setCoded(caps & CAP_CODED_TICKS);
+	send(pgt);
+}
+
+void ClientHandler::sendSpectatorTick()
+{
+	// The player we followed has gone, so start over with someone else.
+	if (player != NULL_ID && !gs->lookupPlayer(player))
 	{
-	case UP:
-		if (py < 0)
-			std::copy(gs->boardStart, gs->boardStart + CLIENT_FRAME, news);
-		else
-			std::copy(gs->board[py] + px, gs->board[py] + px + CLIENT_FRAME, news);
-		break;
-	case DOWN:
-		if (py + CLIENT_FRAME > my)
-			std::copy(gs->boardStart, gs->boardStart + CLIENT_FRAME, news);
-		else
-			std::copy(gs->board[py + CLIENT_FRAME - 1] + px, gs->board[py + CLIENT_FRAME - 1] + px + CLIENT_FRAME, news);
-		break;
-	case LEFT:
-		if (px < 0)
-			std::copy(gs->boardStart, gs->boardStart + CLIENT_FRAME, news);
-		else
-			for (pos_t y = 0; y < CLIENT_FRAME; ++y)
-				news[y] = (0 <= py + y && py + y < my) ? gs->board[py + y][px] : OUT_OF_BOUNDS_STATE;
-		break;
-	case RIGHT:
-		if (px + CLIENT_FRAME > mx)
-			std::copy(gs->boardStart, gs->boardStart + CLIENT_FRAME, news);
-		else
-			for (pos_t y = 0; y < CLIENT_FRAME; ++y)
-				news[y] = (0 <= py + y && py + y < my) ? gs->board[py + y][px + CLIENT_FRAME - 1] : OUT_OF_BOUNDS_STATE;
-		break;
-	// When we don't move, the new data is ignored.
-	case NONE:
-		break;
+		qDebug() << "Connection" << id << ": Spectated player" << player << "has left.";
+		follow(player);
+		sendSpectatorJoin();
+		return;
 	}
 
+	// Everything the bytes depend on goes in the key, so that spectators
+	// only share what they would have been sent anyway.
+	quint32 key = (quint32(player) << 8) | (caps & (CAP_CODED_TICKS | CAP_FAST_HASH | CAP_PLAYER_DELTAS));
+	QByteArray bytes = feed->get(*gs, key, [this] {
+		return encodeSpectatorTick();
+	});
+	socket->write(bytes);
+	sentPackets->inc();
+
+	// The shared bytes have this tick's players in them, which is only
+	// enough if we sent the last one.
+	if (gs->getTick() > playersSent + 1)
+	{
+		qDebug() << "Connection" << id << ": Skipped ticks" << playersSent + 1 << "to" << gs->getTick() - 1 << ", sending all players.";
+		send(makePPU());
+	}
+	playersSent = gs->getTick();
+
+	const Player *pl = gs->lookupPlayer(player);
+	if (pl)
+		rememberView(gs->getTick(), pl->getX() - (CLIENT_FRAME / 2), pl->getY() - (CLIENT_FRAME / 2));
+}
+
+QByteArray ClientHandler::encodeSpectatorTick()
+{
+	TRACE_SCOPE("ClientHandler::encodeSpectatorTick");
+
+	state_t news[CLIENT_FRAME];
 	state_t *dptrs[CLIENT_FRAME];
 	state_t *bptrs[CLIENT_FRAME];
-	for (int y = 0; y < CLIENT_FRAME; ++y)
+	Direction dir = NONE;
+	score_t score = 0;
+
+	const Player *pl = gs->lookupPlayer(player);
+	if (pl)
 	{
-		if (py + y < 0 || py + y >= my)
-		{
-			dptrs[y] = gs->diffStart;
-			bptrs[y] = gs->boardStart;
-		} else {
-			dptrs[y] = gs->diff[py + y] + px;
-			bptrs[y] = gs->board[py + y] + px;
-		}
+		gs->getTickView(pl, news, dptrs, bptrs);
+		dir = pl->getActualDirection();
+		score = pl->getScore();
+	} else {
+		// The whole board never moves, so nothing new comes into view.
+		std::fill(news, news + CLIENT_FRAME, 0);
+		std::copy(feed->getOverviewDiff(), feed->getOverviewDiff() + CLIENT_FRAME, dptrs);
+		std::copy(feed->getOverview(), feed->getOverview() + CLIENT_FRAME, bptrs);
 	}
 
-	QByteArray chksum = hashBoard(bptrs);
+	QByteArray bytes;
+	QDataStream out(&bytes, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_5_0);
 
-	Packet::writePacket(str, PacketGameTick(gs->getTick(), pl->getActualDirection(), pl->getScore(), news, dptrs, chksum));
+	// No timestamp, as it would differ between spectators.
+	PacketGameTick pgt(gs->getTick(), dir, score, news, dptrs, hashBoard(bptrs, 0, boardHash()));
+	pgt.setCoded(caps & CAP_CODED_TICKS);
+	Packet::writePacket(out, pgt);
 
 	if (gs->havePlayersChanged())
-		Packet::writePacket(str, makePPU());
+	{
+		if (caps & CAP_PLAYER_DELTAS)
+			Packet::writePacket(out, makePPD());
+		else
+			Packet::writePacket(out, makePPU());
+	}
 
 	if (gs->hasLeaderboardChanged())
-		Packet::writePacket(str, makePLU());
+		Packet::writePacket(out, makePLU());
 
-	gs->unlock();
+	return bytes;
+}
+
+void ClientHandler::sendDeltaTick(Player *pl)
+{
+	static MetricCounter *resyncs = Metrics::instance().counter("paper_udp_resyncs_total",
+	                                  "Whole boards sent to UDP clients which hadn't acknowledged a recent enough tick.");
+
+	PacketDeltaTick pdt;
+	if (!makeCatchup(acked, pdt))
+	{
+		// Either the ticks or the acks have been getting lost for a while.
+		// Start over from a board sent over TCP.
+		resyncs->inc();
+		qDebug() << "Connection" << id << ": Tick" << acked << "is too old to send a delta from. Resending the board.";
+		sendBoard(makePRB());
+		acked = gs->getTick();
+		return;
+	}
+
+	pdt.setScore(pl->getScore());
+	if (timeSync)
+		pdt.setTimestamp(Metrics::now());
+
+	qint64 len = udp->send(pdt);
+	if (len < 0)
+	{
+		qWarning() << "Connection" << id << ": Unable to send tick over UDP:" << udp->errorString();
+		return;
+	}
+	sentBytes->inc(len);
+	sentPackets->inc();
 }
 
 void ClientHandler::establishConnection(int socketDescriptor)
@@ -192,6 +392,9 @@ void ClientHandler::establishConnection(int socketDescriptor)
 
 	keepAlive->start();
 
+	// Names the thread in traces.
+	QThread::currentThread()->setObjectName(QString("Connection %1").arg(id));
+
 	qDebug() << "Connection" << id << "established with:" << socket->peerAddress(); 
 
 	emit connected();
@@ -217,17 +420,25 @@ void ClientHandler::kaTimeout()
 {
 	if (lastka.secsTo(QDateTime::currentDateTime()) > TIMEOUT_LEN)
 	{
+		static MetricCounter *timeouts = Metrics::instance().counter("paper_keepalive_timeouts_total",
+		                                   "Connections dropped for not sending keep alives.");
+		timeouts->inc();
+
 		qDebug() << "Connection " << id << ": Haven't received keep alive packet, timing out client.";
 		disconnect();
 		return;
 	}
 
-	Packet::writePacket(str, PacketKeepAlive());
+	send(PacketKeepAlive());
+	if (timeSync)
+		send(PacketTimeSync(Metrics::now()));
 	qDebug() << "Connection " << id << ": Keep alive sent!";
 }
 
 void ClientHandler::newData()
 {
+	TRACE_SCOPE("ClientHandler::newData");
+
 	Packet *packet = NULL;
 
 	// Read all available packets.
@@ -249,7 +460,29 @@ void ClientHandler::newData()
 			lastka = QDateTime::currentDateTime();
 			qDebug() << "Connection" << id << ": Keep alive received!";
 			break;
+		case PACKET_TIME_SYNC:
+		{
+			const PacketTimeSync *pts = static_cast<PacketTimeSync *>(packet);
+			qint64 now = Metrics::now();
+			if (pts->isRequest())
+			{
+				// The first request tells us the client understands
+				// these, so start our own right away.
+				send(pts->reply(now, Metrics::now()));
+				if (!timeSync)
+					send(PacketTimeSync(Metrics::now()));
+				timeSync = true;
+			} else {
+				roundTrip->observe(clock.sample(*pts, now));
+				qDebug() << "Connection" << id << ": Round trip" << clock.getRoundTrip() << "ns, offset" << clock.getOffset() << "ns";
+			}
+			break;
+		}
+		case PACKET_HELLO:
+			send(PacketCapabilities(offered, TickCoder::VERSION));
+			break;
 		case PACKET_REQUEST_JOIN:
+		case PACKET_REQUEST_JOIN_CAPS:
 		{
 			QString nme = static_cast<PacketRequestJoin *>(packet)->getName();
 			if (nme.isEmpty())
@@ -257,6 +490,21 @@ void ClientHandler::newData()
 			else
 				name = nme;
 
+			if (spectating)
+				stopSpectating();
+
+			// Changing encodings mid game would garble the ticks in flight.
+			if (state == INGAME)
+			{
+				qWarning() << "Connection" << id << ": Requested join while in game. Keeping capabilities:" << caps;
+			} else if (packet->getId() == PACKET_REQUEST_JOIN_CAPS) {
+				const PacketRequestJoinCaps *prj = static_cast<PacketRequestJoinCaps *>(packet);
+				agreeCapabilities(prj->getCapabilities(), prj->getCodesVersion());
+			} else {
+				capsJoin = false;
+				caps = 0;
+			}
+
 			qDebug() << "Connection" << id << ": Requesting join with name:" << nme;
 			emit requestJoinGame(nme);
 			break;
@@ -268,8 +516,62 @@ void ClientHandler::newData()
 			emit changeDirection(dir);
 			break;
 		}
+		case PACKET_REQUEST_CATCHUP:
+		{
+			tick_t from = static_cast<PacketRequestCatchup *>(packet)->getTick();
+			qDebug() << "Connection" << id << ": Requesting catch up from tick" << from;
+			if (state != INGAME || !gs)
+			{
+				qWarning() << "Connection" << id << ": Can't catch up because we're not in game or the game state is NULL!";
+				break;
+			}
+
+			gs->lockForRead();
+			sendCatchup(from);
+			gs->unlock();
+			break;
+		}
+		case PACKET_REQUEST_ROWS:
+		{
+			const PacketRequestRows *prr = static_cast<PacketRequestRows *>(packet);
+			qDebug() << "Connection" << id << ": Requesting rows from tick" << prr->getTick();
+			if (state != INGAME || !gs)
+			{
+				qWarning() << "Connection" << id << ": Can't send rows because we're not in game or the game state is NULL!";
+				break;
+			}
+
+			gs->lockForRead();
+			sendRows(prr->getTick(), prr->getHashes());
+			gs->unlock();
+			break;
+		}
+		case PACKET_REQUEST_UDP:
+		{
+			if (!udp)
+			{
+				udp = new UdpLink(this);
+				if (!udp->bind())
+				{
+					qWarning() << "Connection" << id << ": Unable to open a UDP port:" << udp->errorString();
+					delete udp;
+					udp = NULL;
+					break;
+				}
+				connect(udp, &UdpLink::readyRead, this, &ClientHandler::udpData);
+				udpToken = (quint32(qrand()) << 16) ^ quint32(qrand()) ^ quint32(Metrics::now()) ^ id;
+			}
+
+			qDebug() << "Connection" << id << ": Offering UDP port" << udp->localPort();
+			send(PacketUdpOffer(udp->localPort(), udpToken));
+			break;
+		}
 		case PACKET_REQUEST_RESEND:
 		{
+			static MetricCounter *resends = Metrics::instance().counter("paper_resend_requests_total",
+			                                  "Board resends requested by clients.");
+			resends->inc();
+
 			qDebug() << "Connection" << id << ": Requesting resend!";
 			if (state != INGAME || !gs)
 			{
@@ -290,10 +592,52 @@ void ClientHandler::newData()
 			}
 			qDebug() << qPrintable(msg);
 
-			Packet::writePacket(str, prb);
+			sendBoard(prb);
 			gs->unlock();
 			break;
 		}
+		case PACKET_REQUEST_SPECTATE:
+		{
+			const PacketRequestSpectate *prs = static_cast<PacketRequestSpectate *>(packet);
+			qDebug() << "Connection" << id << ": Requesting to spectate player" << prs->getPlayer();
+			if (!(offered & CAP_SPECTATE))
+			{
+				qWarning() << "Connection" << id << ": Requested to spectate, which we don't offer!";
+				break;
+			}
+			if (state == INGAME && !spectating)
+			{
+				qWarning() << "Connection" << id << ": Requested to spectate while in game!";
+				break;
+			}
+
+			// Spectators get a new game join with whatever they ask for,
+			// so they can change capabilities too.
+			agreeCapabilities(prs->getCapabilities(), prs->getCodesVersion());
+			if (spectating)
+			{
+				gs->lockForRead();
+				follow(prs->getPlayer());
+				sendSpectatorJoin();
+				gs->unlock();
+			} else {
+				emit requestSpectate(prs->getPlayer());
+			}
+			break;
+		}
+		case PACKET_REQUEST_PLAYERS:
+			qDebug() << "Connection" << id << ": Requesting players!";
+			if (state != INGAME || !gs)
+			{
+				qWarning() << "Connection" << id << ": Can't send players because we're not in game or the game state is NULL!";
+				break;
+			}
+
+			gs->lockForRead();
+			send(makePPU());
+			playersSent = gs->getTick();
+			gs->unlock();
+			break;
 		default:
 			qDebug() << "Connection" << id << ": Received unexpected packet: " << packet->getId();
 			break;
@@ -303,6 +647,63 @@ void ClientHandler::newData()
 	}
 }
 
+void ClientHandler::udpData()
+{
+	while (udp->hasPending())
+	{
+		QHostAddress addr;
+		quint16 port = 0;
+		Packet *packet = udp->receive(&addr, &port);
+		if (!packet)
+			continue;
+
+		switch (packet->getId()) {
+		case PACKET_UDP_HELLO:
+			if (static_cast<PacketUdpHello *>(packet)->getToken() != udpToken)
+			{
+				qWarning() << "Connection" << id << ": UDP hello from" << addr << "has the wrong token.";
+				break;
+			}
+
+			// Keep following the client in case its NAT moves it.
+			if (!udp->hasPeer())
+				qDebug() << "Connection" << id << ": Sending ticks over UDP to" << addr << "port" << port;
+			udp->setPeer(addr, port);
+			break;
+		case PACKET_TICK_ACK:
+		{
+			const PacketTickAck *pta = static_cast<PacketTickAck *>(packet);
+			if (pta->getToken() != udpToken)
+				break;
+
+			// Acks can arrive out of order.
+			acked = std::max(acked, pta->getTick());
+			break;
+		}
+		default:
+			qDebug() << "Connection" << id << ": Received unexpected UDP packet: " << packet->getId();
+			break;
+		}
+
+		delete packet;
+	}
+}
+
+void ClientHandler::send(const Packet &pkt)
+{
+	Packet::writePacket(str, pkt);
+	sentPackets->inc();
+}
+
+void ClientHandler::agreeCapabilities(quint32 requested, quint16 codesVersion)
+{
+	capsJoin = true;
+	caps = requested & offered;
+	if (codesVersion != TickCoder::VERSION)
+		caps &= ~CAP_CODED_TICKS;
+	qDebug() << "Connection" << id << ": Agreed capabilities:" << caps;
+}
+
 PacketPlayersUpdate ClientHandler::makePPU()
 {
 	if (state != INGAME || !gs)
@@ -320,6 +721,17 @@ PacketPlayersUpdate ClientHandler::makePPU()
 	return PacketPlayersUpdate(gs->getTick(), players);
 }
 
+PacketPlayersDelta ClientHandler::makePPD()
+{
+	if (state != INGAME || !gs)
+	{
+		qWarning() << "Connection" << id << ": Requested PacketPlayersDelta while not in game or with invalid game state!";
+		return PacketPlayersDelta();
+	}
+
+	return PacketPlayersDelta(gs->getTick(), gs->playersLeft, gs->playersJoined);
+}
+
 PacketLeaderboardUpdate ClientHandler::makePLU()
 {
 	if (state != INGAME || !gs)
@@ -339,6 +751,12 @@ PacketResendBoard ClientHandler::makePRB()
 		return PacketResendBoard();
 	}
 
+	if (spectating && player == NULL_ID)
+	{
+		feed->refresh(*gs);
+		return PacketResendBoard(gs->getTick(), feed->getOverview(), boardHash());
+	}
+
 	Player * pl = gs->lookupPlayer(player);
 	if (!pl)
 	{
@@ -359,5 +777,185 @@ PacketResendBoard ClientHandler::makePRB()
 			
 	}
 
-	return PacketResendBoard(gs->getTick(), ptrs);
+	rememberView(gs->getTick(), px, py);
+	return PacketResendBoard(gs->getTick(), ptrs, boardHash());
+}
+
+BoardHash ClientHandler::boardHash() const
+{
+	return caps & CAP_FAST_HASH ? HASH_FNV64 : HASH_MD4;
+}
+
+void ClientHandler::sendBoard(const PacketResendBoard &prb)
+{
+	if (caps & CAP_PACKED_BOARDS)
+		send(PacketPackedBoard(prb));
+	else
+		send(prb);
+}
+
+void ClientHandler::rememberView(tick_t tick, pos_t x, pos_t y)
+{
+	views[tick % GameState::DIFF_HISTORY] = SentView{tick, x, y};
+}
+
+bool ClientHandler::makeCatchup(tick_t from, PacketCatchup &pc)
+{
+	Player *pl = gs->lookupPlayer(player);
+	tick_t now = gs->getTick();
+	const SentView &old = views[from % GameState::DIFF_HISTORY];
+
+	// We need to know where the client was looking and every diff since.
+	// The current tick's diff is still on the board.
+	bool possible = pl && from < now && now - from <= GameState::DIFF_HISTORY && old.tick == from;
+	for (tick_t t = from + 1; possible && t < now; ++t)
+		possible = gs->getHistory(t);
+	if (!possible)
+		return false;
+
+	pos_t px = pl->getX() - (CLIENT_FRAME / 2);
+	pos_t py = pl->getY() - (CLIENT_FRAME / 2);
+	pos_t mx = gs->getWidth();
+	pos_t my = gs->getHeight();
+	pc.setTick(now);
+	pc.setFrom(from);
+	pc.setOffset(px - old.x, py - old.y);
+	state_t *const *out = pc.getDiff();
+
+	// Squares the client could see already only need this tick's diff and
+	// the ones in the history. The rest start out as 0 on the client, so
+	// they get their whole state.
+	auto seen = [&old](pos_t x, pos_t y) {
+		return old.x <= x && x < old.x + CLIENT_FRAME && old.y <= y && y < old.y + CLIENT_FRAME;
+	};
+	for (int ry = 0; ry < CLIENT_FRAME; ++ry)
+	{
+		for (int rx = 0; rx < CLIENT_FRAME; ++rx)
+		{
+			pos_t x = px + rx;
+			pos_t y = py + ry;
+			bool inside = 0 <= x && x < mx && 0 <= y && y < my;
+			if (seen(x, y))
+				out[ry][rx] = inside ? gs->diff[y][x] : 0;
+			else
+				out[ry][rx] = inside ? gs->board[y][x] : OUT_OF_BOUNDS_STATE;
+		}
+	}
+
+	for (tick_t t = from + 1; t < now; ++t)
+	{
+		for (const GameState::SquareDiff &d : *gs->getHistory(t))
+		{
+			int rx = d.x - px;
+			int ry = d.y - py;
+			if (0 <= rx && rx < CLIENT_FRAME && 0 <= ry && ry < CLIENT_FRAME && seen(d.x, d.y))
+				out[ry][rx] ^= d.diff;
+		}
+	}
+
+	state_t *bptrs[CLIENT_FRAME];
+	for (int y = 0; y < CLIENT_FRAME; ++y)
+		bptrs[y] = (py + y < 0 || py + y >= my) ? gs->boardStart : gs->board[py + y] + px;
+	pc.setChecksum(hashBoard(bptrs, 0, boardHash()));
+
+	rememberView(now, px, py);
+	return true;
+}
+
+void ClientHandler::sendCatchup(tick_t from)
+{
+	static MetricCounter *catchups = Metrics::instance().counter("paper_catchups_total",
+	                                   "Clients caught up from the diff history.");
+	static MetricCounter *fallbacks = Metrics::instance().counter("paper_catchup_fallbacks_total",
+	                                    "Catch ups which needed a whole board because the history was too short.");
+
+	PacketCatchup pc;
+	if (!makeCatchup(from, pc))
+	{
+		fallbacks->inc();
+		qDebug() << "Connection" << id << ": Tick" << from << "is too old to catch up from. Resending the board.";
+		sendBoard(makePRB());
+		return;
+	}
+
+	catchups->inc();
+	send(pc);
+}
+
+void ClientHandler::sendRows(tick_t from, const quint32 *hashes)
+{
+	static MetricCounter *repairs = Metrics::instance().counter("paper_row_repairs_total",
+	                                  "Client views fixed by resending only the rows which were wrong.");
+	static MetricCounter *repairedRows = Metrics::instance().counter("paper_row_repair_rows_total",
+	                                       "Rows resent to fix client views.");
+	static MetricCounter *fallbacks = Metrics::instance().counter("paper_row_repair_fallbacks_total",
+	                                    "Row repairs which needed a whole board because the history was too short.");
+
+	Player *pl = gs->lookupPlayer(player);
+	tick_t now = gs->getTick();
+	const SentView &old = views[from % GameState::DIFF_HISTORY];
+
+	// As with a catch up, we need every diff since the client's tick.
+	bool possible = pl && from <= now && now - from <= GameState::DIFF_HISTORY && old.tick == from;
+	for (tick_t t = from + 1; possible && t < now; ++t)
+		possible = gs->getHistory(t);
+	if (!possible)
+	{
+		fallbacks->inc();
+		qDebug() << "Connection" << id << ": Tick" << from << "is too old to compare rows from. Resending the board.";
+		sendBoard(makePRB());
+		return;
+	}
+
+	// Work out what the client should have had by undoing every change
+	// since.
+	pos_t mx = gs->getWidth();
+	pos_t my = gs->getHeight();
+	state_t then[CLIENT_FRAME][CLIENT_FRAME];
+	for (int ry = 0; ry < CLIENT_FRAME; ++ry)
+	{
+		for (int rx = 0; rx < CLIENT_FRAME; ++rx)
+		{
+			pos_t x = old.x + rx;
+			pos_t y = old.y + ry;
+			if (0 <= x && x < mx && 0 <= y && y < my)
+				then[ry][rx] = gs->board[y][x] ^ (from < now ? gs->diff[y][x] : 0);
+			else
+				then[ry][rx] = OUT_OF_BOUNDS_STATE;
+		}
+	}
+	for (tick_t t = from + 1; t < now; ++t)
+	{
+		for (const GameState::SquareDiff &d : *gs->getHistory(t))
+		{
+			int rx = d.x - old.x;
+			int ry = d.y - old.y;
+			if (0 <= rx && rx < CLIENT_FRAME && 0 <= ry && ry < CLIENT_FRAME)
+				then[ry][rx] ^= d.diff;
+		}
+	}
+
+	// The ticks since have XORed their diffs into the same wrong squares,
+	// and any new squares came in whole. So the wrong rows are still wrong,
+	// wherever they are in the view now.
+	pos_t px = pl->getX() - (CLIENT_FRAME / 2);
+	pos_t py = pl->getY() - (CLIENT_FRAME / 2);
+	state_t *bptrs[CLIENT_FRAME];
+	for (int y = 0; y < CLIENT_FRAME; ++y)
+		bptrs[y] = (py + y < 0 || py + y >= my) ? gs->boardStart : gs->board[py + y] + px;
+
+	PacketPartialBoard ppb(now);
+	for (int ry = 0; ry < CLIENT_FRAME; ++ry)
+	{
+		int r = old.y + ry - py;
+		if (hashRow(then[ry]) != hashes[ry] && 0 <= r && r < CLIENT_FRAME)
+			ppb.setRow(r, bptrs[r]);
+	}
+	ppb.setChecksum(hashBoard(bptrs, 0, boardHash()));
+
+	repairs->inc();
+	repairedRows->inc(ppb.getRowCount());
+	qDebug() << "Connection" << id << ": Resending" << ppb.getRowCount() << "rows.";
+	rememberView(now, px, py);
+	send(ppb);
 }
@@ -12,8 +12,11 @@
 #include <QTimer>
 
 #include "gamestate.h"
+#include "metrics.h"
 #include "protocol.h"
+#include "spectatorfeed.h"
 #include "types.h"
+#include "udplink.h"
 
 /*
  * The current state of the client. QUEUEING means the client
@@ -41,12 +44,24 @@ public:
 	 * sure you only construct one ClientHandler at a time.
 	 */
 	ClientHandler(QObject *parent = Q_NULLPTR);
+	~ClientHandler();
 
 	thid_t getId() const;
 
+	/*
+	 * Limits the capabilities offered to clients, so new encodings can be
+	 * turned on gradually. Must be called before any clients connect.
+	 */
+	static void setCapabilities(quint32 caps);
+
 public slots:
 	void enqueue();
 	void beginGame(plid_t id, GameState *gs);
+	/*
+	 * Starts watching the game rather than playing. The client follows
+	 * the given player, or sees the whole board if it is NULL_ID.
+	 */
+	void beginSpectating(plid_t target, GameState *gs, SpectatorFeed *feed);
 	void endGame(score_t score);
 	void establishConnection(int socketDescriptor);
 	void sendTick();
@@ -58,6 +73,8 @@ signals:
 	void connected();
 	void disconnected();
 	void requestJoinGame(const QString &name);
+	void requestSpectate(plid_t target);
+	void stoppedSpectating();
 	void changeDirection(Direction dir);
 	void requestResync();
 
@@ -65,9 +82,11 @@ private slots:
 	void ierror(QAbstractSocket::SocketError error);
 	void kaTimeout();
 	void newData();
+	void udpData();
 
 private:
 	static thid_t idCount;
+	static quint32 offered;
 
 	const thid_t id;
 	QTimer *keepAlive;
@@ -76,14 +95,90 @@ private:
 
 	ClientState state;
 	GameState *gs;
+	// For spectators, the player followed, or NULL_ID for the whole board.
 	plid_t player;
+	bool spectating;
+	SpectatorFeed *feed;
 	QString name;
 
 	QDateTime lastka;
 
+	// Set once the client has sent a PACKET_TIME_SYNC, after which we
+	// sync with it too and timestamp its ticks.
+	bool timeSync;
+	// Whether the client asked to join with capabilities, and the ones we
+	// agreed on. They only change between games.
+	bool capsJoin;
+	quint32 caps;
+	ClockSync clock;
+	// The tick the client's list of players is up to. Deltas only cover
+	// one tick, so if we skip any the whole list has to be sent.
+	tick_t playersSent;
+
+	/*
+	 * Where the top left of the client's view was for each of the last
+	 * ticks we sent it, in the same slots as GameState's history.
+	 */
+	struct SentView
+	{
+		tick_t tick;
+		pos_t x;
+		pos_t y;
+	};
+	SentView views[GameState::DIFF_HISTORY];
+
+	// Created when the client asks for its ticks over UDP. They are sent
+	// there once it has said hello, from wherever it said it from.
+	UdpLink *udp;
+	quint32 udpToken;
+	// The newest tick the client has acknowledged over UDP. Each tick is
+	// sent as a delta from it.
+	tick_t acked;
+
+	const QString labels;
+	MetricCounter *sentBytes;
+	MetricCounter *sentPackets;
+	MetricHistogram *roundTrip;
+
+	void send(const Packet &pkt);
+	void agreeCapabilities(quint32 requested, quint16 codesVersion);
+
 	PacketPlayersUpdate makePPU();
+	PacketPlayersDelta makePPD();
 	PacketLeaderboardUpdate makePLU();
+	/* Sends whatever the client needs to know who left or joined this tick. */
+	void sendPlayers();
 	PacketResendBoard makePRB();
+	BoardHash boardHash() const;
+	/* Sends prb, packed if the client asked for it. */
+	void sendBoard(const PacketResendBoard &prb);
+
+	void sendGameTick(Player *pl);
+	void sendDeltaTick(Player *pl);
+
+	/*
+	 * Follows target, or if it has gone the leader, or failing that the
+	 * whole board. The game state must be locked.
+	 */
+	void follow(plid_t target);
+	void stopSpectating();
+	void sendSpectatorJoin();
+	void sendSpectatorTick();
+	/* What every spectator with our view and capabilities is sent this tick. */
+	QByteArray encodeSpectatorTick();
+
+	void rememberView(tick_t tick, pos_t x, pos_t y);
+	/*
+	 * Fills pc with what the client needs to get from tick from to now.
+	 * Returns false if the history doesn't go back that far.
+	 */
+	bool makeCatchup(tick_t from, PacketCatchup &pc);
+	void sendCatchup(tick_t from);
+	/*
+	 * Sends the rows of the client's view which disagree with the given
+	 * row hashes of its view at tick from.
+	 */
+	void sendRows(tick_t from, const quint32 *hashes);
 };
 
 #endif // !CLIENTHANDLER_H
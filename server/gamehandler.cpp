@@ -2,13 +2,43 @@
  * Implements GameHandler.
  */
 
+#include <limits>
+
 #include "gamehandler.h"
 #include "gamelogic.h"
 #include "nicks.h"
 #include "paperserver.h"
+#include "trace.h"
 
 gid_t GameHandler::idCount = 0;
 
+/*
+ * The AI quota is adjusted after every tick, as fractions of the tick
+ * interval. If the AIs ran late, or the tick itself did, the quota is cut
+ * back sharply; if there was plenty of time left over it grows slowly.
+ * The quota can be larger than the interval since the AIs run in parallel.
+ */
+const double AI_QUOTA_START = 0.25;
+const double AI_QUOTA_MIN = 0.01;
+const double AI_QUOTA_MAX = 2;
+const double AI_QUOTA_STEP = 0.02;
+const double AI_QUOTA_BACKOFF = 0.5;
+// The quota only grows if the AIs finished within this much of the interval.
+const double AI_SLACK = 0.5;
+// A tick starting this much of the interval late counts as overloaded.
+const double TICK_OVERLOAD = 0.1;
+
+/*
+ * AIs are given less effort the further (in Chebyshev distance) they are
+ * from the nearest human. Near AIs are in or close to someone's view and
+ * search every tick. Mid AIs could come into view soon, so they search
+ * every few ticks and use the cheap policy in between. Far AIs always use
+ * the cheap policy.
+ */
+const int AI_NEAR = CLIENT_FRAME / 2 + 5;
+const int AI_MID = CLIENT_FRAME + 5;
+const int AI_MID_REPLAN = 4;
+
 GameHandler::GameHandler(PaperServer &pss, pos_t w, pos_t h, quint16 ti, plid_t mp, QObject *parent)
 	: QObject(parent)
 	, id(idCount)
@@ -19,9 +49,40 @@ GameHandler::GameHandler(PaperServer &pss, pos_t w, pos_t h, quint16 ti, plid_t
 	, ps(pss)
 	, tickTimer(new QTimer(this))
 	, players()
+	, spectators()
 	, ais()
+	, fields()
+	, aipool()
+	, aiQuota(static_cast<qint64>(ti * 1e6 * AI_QUOTA_START))
 	, currentId(1)
 	, gs(w, h, ti)
+	, feed()
+	, labels(Metrics::label("game", id))
+	, lastTick()
+	, tickDuration(Metrics::instance().histogram("paper_game_tick_duration_seconds",
+	               "Time taken to compute a game tick, not including the AIs.", labels))
+	, tickLateness(Metrics::instance().histogram("paper_game_tick_lateness_seconds",
+	               "How late a tick started compared to the tick interval.", labels))
+	, aiDuration(Metrics::instance().histogram("paper_game_ai_duration_seconds",
+	             "Time taken to compute the AI moves between ticks.", labels))
+	, aiLate(Metrics::instance().counter("paper_game_ai_late_total",
+	         "AI moves which weren't ready in time for their tick.", labels))
+	, aiQuotaGauge(Metrics::instance().gauge("paper_game_ai_quota_microseconds",
+	               "CPU time the AIs may use between ticks.", labels))
+	, aiDepth(Metrics::instance().gauge("paper_game_ai_search_depth",
+	          "Average number of moves the AIs looked ahead, rounded down.", labels))
+	, aiNear(Metrics::instance().gauge("paper_game_ai_detail",
+	         "Number of AIs at each level of detail.", labels + "," + Metrics::label("tier", "near")))
+	, aiMid(Metrics::instance().gauge("paper_game_ai_detail",
+	        "Number of AIs at each level of detail.", labels + "," + Metrics::label("tier", "mid")))
+	, aiFar(Metrics::instance().gauge("paper_game_ai_detail",
+	        "Number of AIs at each level of detail.", labels + "," + Metrics::label("tier", "far")))
+	, humanCount(Metrics::instance().gauge("paper_game_players",
+	             "Number of players in a game.", labels + "," + Metrics::label("kind", "human")))
+	, aiCount(Metrics::instance().gauge("paper_game_players",
+	          "Number of players in a game.", labels + "," + Metrics::label("kind", "ai")))
+	, spectatorCount(Metrics::instance().gauge("paper_game_spectators",
+	                 "Number of connections watching a game.", labels))
 {
 	GameHandler::idCount++;
 
@@ -31,8 +92,14 @@ GameHandler::GameHandler(PaperServer &pss, pos_t w, pos_t h, quint16 ti, plid_t
 
 GameHandler::~GameHandler()
 {
+	// The workers may still be using the AIs.
+	QList<plid_t> late;
+	aipool.collect(late);
+
 	foreach (AIPlayer *aip, ais)
 		delete aip;
+
+	Metrics::instance().remove(labels);
 }
 
 gid_t GameHandler::getId() const
@@ -43,17 +110,29 @@ gid_t GameHandler::getId() const
 void GameHandler::tick()
 {
 	qDebug() << "Game" << id << ": Tick" << gs.getTick();
+	TRACE_SCOPE("GameHandler::tick");
+
+	qint64 start = Metrics::now();
+	qint64 lateness = 0;
+	if (lastTick.isValid())
+	{
+		lateness = lastTick.nsecsElapsed() - tickInterval * 1000000LL;
+		tickLateness->observe(lateness);
+	}
+	lastTick.start();
 
-	// First update AIs.
-	tickAIs();
+	// Pick up the AI moves which have been computed since the last tick.
+	// This has to happen before we take the write lock, as the workers
+	// need the read lock to finish.
+	QList<plid_t> late;
+	QHash<plid_t, Direction> moves = aipool.collect(late);
+	aiDuration->observe(aipool.getLastDuration());
+	adjustAIQuota(late.size(), lateness);
 
 	// Now we are ready to begin the tick.
 	gs.lockForWrite();
 
-	static QDateTime cdt = QDateTime::currentDateTime();
-	QDateTime dt = QDateTime::currentDateTime();
-	qDebug() << "Delay:" << cdt.msecsTo(dt);
-	cdt = dt;
+	applyAIs(moves, late);
 
 	gs.nextTick();
 
@@ -69,6 +148,8 @@ void GameHandler::tick()
 	if (gs.players.size() < playerCount)
 		spawnPlayers();
 
+	updateCounts();
+
 	// If we have no players left, quit.
 	if (players.size() == 0)
 	{
@@ -76,6 +157,16 @@ void GameHandler::tick()
 
 		qDebug() << "Game" << id << ": No more players. Terminating...";
 		tickTimer->stop();
+
+		// The spectators go back to waiting for a game.
+		foreach (ClientHandler *ch, spectators)
+		{
+			disconnect(this, 0, ch, 0);
+			QMetaObject::invokeMethod(ch, "endGame", Q_ARG(score_t, 0));
+		}
+		spectators.clear();
+		spectatorCount->set(0);
+
 		emit terminated();
 		return;
 	}
@@ -85,11 +176,25 @@ void GameHandler::tick()
 
 	gs.unlock();
 
+	tickDuration->observe(Metrics::now() - start);
+
 	emit tickComplete();
+
+	// Now the AIs can work out their next move while we wait for the
+	// next tick.
+	dispatchAIs();
 }
 
-void GameHandler::tickAIs()
+void GameHandler::updateCounts()
 {
+	humanCount->set(players.size());
+	aiCount->set(ais.size());
+}
+
+void GameHandler::dispatchAIs()
+{
+	TRACE_SCOPE("GameHandler::dispatchAIs");
+
 	gs.lockForRead();
 	auto iter = ais.begin();
 	while(iter != ais.end())
@@ -105,16 +210,107 @@ void GameHandler::tickAIs()
 			continue;
 		}
 
-		pl->newDir = iter.value()->tick(gs);
-
 		iter++;
 	}
+
+	fields.update(gs, ais.keys());
+	int searching = assignDetail();
 	gs.unlock();
+
+	// Leave a quarter of the interval for the stragglers to finish and
+	// let go of the read lock before the next tick.
+	qint64 budget = searching ? aiQuota / searching : 0;
+	aipool.dispatch(gs, fields, ais, Metrics::now() + tickInterval * 750000LL, budget);
+}
+
+int GameHandler::assignDetail()
+{
+	std::vector<std::pair<pos_t, pos_t>> humans;
+	humans.reserve(players.size());
+	for (auto iter = players.cbegin(); iter != players.cend(); ++iter)
+	{
+		const Player *pl = gs.lookupPlayer(iter.key());
+		if (pl)
+			humans.push_back(std::make_pair(pl->getX(), pl->getY()));
+	}
+
+	int near = 0, mid = 0, far = 0, searching = 0;
+	for (auto iter = ais.begin(); iter != ais.end(); ++iter)
+	{
+		const Player *pl = gs.lookupPlayer(iter.key());
+		int dist = std::numeric_limits<int>::max();
+		foreach (auto pos, humans)
+			dist = std::min(dist, std::max(abs(pl->getX() - pos.first), abs(pl->getY() - pos.second)));
+
+		AIDetail detail;
+		if (dist <= AI_NEAR)
+		{
+			detail = AI_FULL;
+			++near;
+		} else if (dist <= AI_MID) {
+			// Stagger the searches so they don't all land on one tick.
+			detail = (gs.getTick() + iter.key()) % AI_MID_REPLAN ? AI_CHEAP : AI_FULL;
+			++mid;
+		} else {
+			detail = AI_CHEAP;
+			++far;
+		}
+
+		iter.value()->setDetail(detail);
+		if (detail == AI_FULL)
+			++searching;
+	}
+
+	aiNear->set(near);
+	aiMid->set(mid);
+	aiFar->set(far);
+
+	return searching;
+}
+
+void GameHandler::adjustAIQuota(int late, qint64 lateness)
+{
+	if (ais.isEmpty())
+		return;
+
+	const double interval = tickInterval * 1e6;
+	if (late || lateness > interval * TICK_OVERLOAD)
+		aiQuota *= AI_QUOTA_BACKOFF;
+	else if (aipool.getLastDuration() < interval * AI_SLACK)
+		aiQuota += interval * AI_QUOTA_STEP;
+	aiQuota = qBound(static_cast<qint64>(interval * AI_QUOTA_MIN), aiQuota,
+	                 static_cast<qint64>(interval * AI_QUOTA_MAX));
+
+	aiQuotaGauge->set(aiQuota / 1000);
+	aiDepth->set(static_cast<qint64>(aipool.getLastDepth()));
+}
+
+void GameHandler::applyAIs(const QHash<plid_t, Direction> &moves, const QList<plid_t> &late)
+{
+	for (auto iter = moves.cbegin(); iter != moves.cend(); ++iter)
+	{
+		Player *pl = gs.lookupPlayer(iter.key());
+		if (pl)
+			pl->newDir = iter.value();
+	}
+
+	// A late AI just keeps going the way it is.
+	foreach (plid_t pid, late)
+	{
+		Player *pl = gs.lookupPlayer(pid);
+		if (pl)
+			pl->newDir = pl->getActualDirection();
+	}
+
+	if (!late.isEmpty())
+		qDebug() << "Game" << id << ":" << late.size() << "AIs were late.";
+	aiLate->inc(late.size());
 }
 
 void GameHandler::spawnPlayers()
 {
 	qDebug() << "Game" << id << ": Spawning...";
+	TRACE_SCOPE("GameHandler::spawnPlayers");
 
 	std::vector<std::pair<pos_t, pos_t> > spawns = findSpawns(playerCount - gs.players.size(), gs);
 	QList<QPair<ClientHandler *, QString>> clients = ps.dequeueClients(spawns.size());
@@ -193,6 +389,8 @@ void GameHandler::findNextId()
 
 void GameHandler::removePlayers()
 {
+	TRACE_SCOPE("GameHandler::removePlayers");
+
 	for (auto iter = gs.players.begin(); iter != gs.players.end(); )
 	{
 		Player *pl = iter.value();
@@ -244,9 +442,13 @@ void GameHandler::playerDisconnected(plid_t pid)
 	gs.lockForRead();
 	Player *pl = gs.lookupPlayer(pid);
 	if (pl)
+	{
+		if (!pl->dead)
+			pl->cause = DEATH_DISCONNECT;
 		pl->dead = true;
-	else
+	} else {
 		qWarning() << "Game" << id << ": Received disconnect change from unregistered player " << pid << "!";
+	}
 	gs.unlock();
 
 	// Since the player has disconnected, the connection object is invalid
@@ -271,7 +473,56 @@ void GameHandler::playerMoved(plid_t pid, Direction dir)
 	gs.unlock();
 }
 
+void GameHandler::addSpectator(ClientHandler *ch, plid_t target)
+{
+	if (!ch)
+	{
+		qWarning() << "Game" << id << ": addSpectator() passed NULL client!";
+		return;
+	}
+
+	thid_t tid = ch->getId();
+	if (spectators.contains(tid))
+	{
+		qWarning() << "Game" << id << ": Connection" << tid << "is already spectating!";
+		return;
+	}
+
+	QMetaObject::invokeMethod(ch, "beginSpectating", Q_ARG(plid_t, target), Q_ARG(GameState *, &gs),
+	                          Q_ARG(SpectatorFeed *, &feed));
+	connect(this, &GameHandler::tickComplete, ch, &ClientHandler::sendTick);
+	connect(ch, &ClientHandler::disconnected, this, [this, tid] {
+		removeSpectator(tid);
+	});
+	connect(ch, &ClientHandler::stoppedSpectating, this, [this, tid] {
+		removeSpectator(tid);
+	});
+
+	spectators.insert(tid, ch);
+	spectatorCount->set(spectators.size());
+	qDebug() << "Game" << id << ": Connection" << tid << "is spectating. Spectators:" << spectators.size();
+}
+
+void GameHandler::removeSpectator(thid_t tid)
+{
+	// Spectators which stopped spectating and then disconnect end up here
+	// twice.
+	ClientHandler *ch = spectators.take(tid);
+	if (!ch)
+		return;
+
+	// The client may already be gone, so we only touch our own side of
+	// the connections.
+	disconnect(this, 0, ch, 0);
+	spectatorCount->set(spectators.size());
+	qDebug() << "Game" << id << ": Connection" << tid << "stopped spectating. Spectators:" << spectators.size();
+}
+
 void GameHandler::startGame()
 {
+	// Names the thread in traces.
+	QThread::currentThread()->setObjectName(QString("Game %1").arg(id));
+
 	tickTimer->start();
+	dispatchAIs();
 }
@@ -8,13 +8,18 @@
 #ifndef GAMEHANDLER_H
 #define GAMEHANDLER_H
 
+#include <QElapsedTimer>
 #include <QHash>
 #include <QReadWriteLock>
 #include <QTimer>
 
+#include "aifields.h"
 #include "aiplayer.h"
+#include "aipool.h"
 #include "clienthandler.h"
 #include "gamestate.h"
+#include "metrics.h"
+#include "spectatorfeed.h"
 #include "types.h"
 
 class PaperServer;
@@ -46,6 +51,11 @@ signals:
 
 public slots:
 	void startGame();
+	/*
+	 * Has the client watch the game, following the given player or the
+	 * whole board if it is NULL_ID.
+	 */
+	void addSpectator(ClientHandler *ch, plid_t target);
 
 private slots:
 	void tick();
@@ -66,16 +76,49 @@ private:
 
 	QTimer *tickTimer;
 	QHash<plid_t, ClientHandler *> players;
+	QHash<thid_t, ClientHandler *> spectators;
 	QHash<plid_t, AIPlayer *> ais;
+	AIFields fields;
+	AIPool aipool;
+	// CPU time (in nanoseconds) the AIs may use between two ticks. This
+	// is shared out evenly between the AIs.
+	qint64 aiQuota;
 
 	plid_t currentId;
 
 	GameState gs;
-
-	void tickAIs();
+	SpectatorFeed feed;
+
+	// Metrics
+	const QString labels;
+	QElapsedTimer lastTick;
+	MetricHistogram *tickDuration;
+	MetricHistogram *tickLateness;
+	MetricHistogram *aiDuration;
+	MetricCounter *aiLate;
+	MetricGauge *aiQuotaGauge;
+	MetricGauge *aiDepth;
+	MetricGauge *aiNear;
+	MetricGauge *aiMid;
+	MetricGauge *aiFar;
+	MetricGauge *humanCount;
+	MetricGauge *aiCount;
+	MetricGauge *spectatorCount;
+
+	void dispatchAIs();
+	void applyAIs(const QHash<plid_t, Direction> &moves, const QList<plid_t> &late);
+	void adjustAIQuota(int late, qint64 lateness);
+	/*
+	 * Decides how much effort each AI puts into its next move based on
+	 * how close it is to a human and returns how many will search. The
+	 * GameState must be locked.
+	 */
+	int assignDetail();
+	void updateCounts();
 	void spawnPlayers();
 	void findNextId();
 	void removePlayers();
+	void removeSpectator(thid_t tid);
 };
 
 #endif // !GAMEHANDLER_H
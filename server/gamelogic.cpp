@@ -10,6 +10,7 @@
 #include <QtCore>
 
 #include "gamelogic.h"
+#include "trace.h"
 
 void updatePosition(Player& player, GameState &state);
 void leaveTrail(Player &player, GameState &state);
@@ -29,6 +30,7 @@ void configureSpawn(Player *pl, GameState &state);
 
 void updateGame(GameState &state)
 {
+	TRACE_SCOPE("updateGame");
 
 	// Create vector of all Players
 	std::vector<Player *> allPlayers = state.getPlayers();
@@ -56,7 +58,7 @@ void updateGame(GameState &state)
 
 		// Check for winner
 		if (detectWin(*allPlayers[i], state))
-			allPlayers[i]->kill();
+			allPlayers[i]->kill(DEATH_WON);
 
 	}
 	
@@ -67,6 +69,8 @@ void updateGame(GameState &state)
 
 void updatePosition(Player &player, GameState &state)
 {
+	TRACE_SCOPE("updatePosition");
+
 	Direction newD = calculateDirection(player, state);
 
 	bool res = true;
@@ -98,10 +102,10 @@ void updatePosition(Player &player, GameState &state)
 		SquareState ss = state.getState(newX, newY);
 		if (ss.getOccupyingPlayer() && ss.getOwningPlayerId() == player.getId())
 		{
-			ss.getOccupyingPlayer()->kill();
+			ss.getOccupyingPlayer()->kill(DEATH_RUN_OVER);
 			player.setLocation(newX, newY);
 		} else {
-			player.kill();
+			player.kill(ss.isOutOfBounds() ? DEATH_WALL : DEATH_COLLISION);
 		}
 	}
 
@@ -110,6 +114,8 @@ void updatePosition(Player &player, GameState &state)
 
 void leaveTrail(Player &player, GameState &state)
 {
+	TRACE_SCOPE("leaveTrail");
+
 	pos_t xpos = player.getX();
 	pos_t ypos = player.getY();
 
@@ -175,6 +181,8 @@ Direction calculateDirection(Player &player, GameState &state)
 
 void killPlayers(GameState &state)
 {
+	TRACE_SCOPE("killPlayers");
+
 	// Loop over all squares
 	for (int j = 0; j <= (state.getWidth() - 1); ++j){
 		for (int k = 0; k <= (state.getHeight() - 1); ++k){
@@ -197,13 +205,15 @@ void killPlayers(GameState &state)
 
 void checkForTrail(Player &player, GameState &state)
 {
+	TRACE_SCOPE("checkForTrail");
+
 	pos_t xpos = player.getX();
 	pos_t ypos = player.getY();
 	
 	SquareState square = state.getState(xpos, ypos);
 	
 	if (square.hasTrail()){
-		square.getTrailPlayer()->kill();
+		square.getTrailPlayer()->kill(square.getTrailPlayerId() == player.getId() ? DEATH_OWN_TRAIL : DEATH_TRAIL_CUT);
 	}
 }
 
@@ -312,6 +322,8 @@ void fillInBody(Player &player, GameState &state)
 
 void checkForCompletedLoop(Player &player, GameState &state)
 {
+	TRACE_SCOPE("checkForCompletedLoop");
+
 	pos_t xpos = player.getX();
 	pos_t ypos = player.getY();
 
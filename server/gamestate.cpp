@@ -3,10 +3,40 @@
  */
 
 #include "gamestate.h"
+#include "metrics.h"
 #include "protocol.h"
+#include "trace.h"
 
 const int EXTRA_BUFFER = CLIENT_FRAME / 2;
 
+/*
+ * Lock timing. A thread only ever holds the lock of one GameState at a
+ * time, so we can remember when it was acquired in a thread local.
+ */
+static thread_local qint64 lockAcquired = 0;
+static thread_local bool lockWrite = false;
+
+static MetricHistogram *lockMetric(const char *name, const char *help, bool write)
+{
+	return Metrics::instance().histogram(name, help, Metrics::label("mode", write ? "write" : "read"),
+	                                     Metrics::LOCK_BUCKETS);
+}
+
+static void lockTaken(qint64 start, bool write)
+{
+	static MetricHistogram *readWait = lockMetric("paper_gamestate_lock_wait_seconds",
+	                                              "Time spent waiting to acquire a GameState lock.", false);
+	static MetricHistogram *writeWait = lockMetric("paper_gamestate_lock_wait_seconds",
+	                                               "Time spent waiting to acquire a GameState lock.", true);
+
+	lockAcquired = Metrics::now();
+	lockWrite = write;
+	(write ? writeWait : readWait)->observe(lockAcquired - start);
+
+	if (Trace::isEnabled())
+		Trace::record(write ? "GameState::lockForWrite" : "GameState::lockForRead", start, lockAcquired);
+}
+
 GameState::GameState(pos_t w, pos_t h, quint16 tr)
 	: width(w)
 	, height(h)
@@ -14,11 +44,16 @@ GameState::GameState(pos_t w, pos_t h, quint16 tr)
 	, lock()
 	, players()
 	, playersChanged(false)
+	, playersLeft()
+	, playersJoined()
 	, tick(0)
 	, scoresChanged(false)
 	, leaderboardChanged(false)
 {
 	std::fill(leaderboard, leaderboard + 5, std::make_pair(NULL_ID, 0));
+	// Tick 0 is never played, so nothing will match this until the slots
+	// are filled.
+	std::fill(historyTicks, historyTicks + DIFF_HISTORY, 0);
 
 	// The board and diff array start with a CLIENT_FRAME length section
 	// of out of bounds, which clients will link to if an entire row is
@@ -74,6 +109,68 @@ GameState::~GameState()
 	delete[] flags;
 }
 
+const std::vector<GameState::SquareDiff> *GameState::getHistory(tick_t t) const
+{
+	if (!t || historyTicks[t % DIFF_HISTORY] != t)
+		return NULL;
+	return &history[t % DIFF_HISTORY];
+}
+
+void GameState::getTickView(const Player *pl, state_t *news, state_t **dptrs, state_t **bptrs) const
+{
+	pos_t px = pl->getX() - (CLIENT_FRAME / 2);
+	pos_t py = pl->getY() - (CLIENT_FRAME / 2);
+	pos_t my = height;
+	pos_t mx = width;
+
+	// Compute the new row.
+	switch (pl->getActualDirection())
+	{
+	case UP:
+		if (py < 0)
+			std::copy(boardStart, boardStart + CLIENT_FRAME, news);
+		else
+			std::copy(board[py] + px, board[py] + px + CLIENT_FRAME, news);
+		break;
+	case DOWN:
+		if (py + CLIENT_FRAME > my)
+			std::copy(boardStart, boardStart + CLIENT_FRAME, news);
+		else
+			std::copy(board[py + CLIENT_FRAME - 1] + px, board[py + CLIENT_FRAME - 1] + px + CLIENT_FRAME, news);
+		break;
+	case LEFT:
+		if (px < 0)
+			std::copy(boardStart, boardStart + CLIENT_FRAME, news);
+		else
+			for (pos_t y = 0; y < CLIENT_FRAME; ++y)
+				news[y] = (0 <= py + y && py + y < my) ? board[py + y][px] : OUT_OF_BOUNDS_STATE;
+		break;
+	case RIGHT:
+		if (px + CLIENT_FRAME > mx)
+			std::copy(boardStart, boardStart + CLIENT_FRAME, news);
+		else
+			for (pos_t y = 0; y < CLIENT_FRAME; ++y)
+				news[y] = (0 <= py + y && py + y < my) ? board[py + y][px + CLIENT_FRAME - 1] : OUT_OF_BOUNDS_STATE;
+		break;
+	// When we don't move, the new data is ignored, so keep it cheap to send.
+	case NONE:
+		std::fill(news, news + CLIENT_FRAME, 0);
+		break;
+	}
+
+	for (int y = 0; y < CLIENT_FRAME; ++y)
+	{
+		if (py + y < 0 || py + y >= my)
+		{
+			dptrs[y] = diffStart;
+			bptrs[y] = boardStart;
+		} else {
+			dptrs[y] = diff[py + y] + px;
+			bptrs[y] = board[py + y] + px;
+		}
+	}
+}
+
 pos_t GameState::getWidth() const
 {
 	return width;
@@ -91,13 +188,32 @@ tick_t GameState::getTick() const
 
 void GameState::nextTick()
 {
-	tick++;
+	TRACE_SCOPE("GameState::nextTick");
+
+	// Keep the squares which changed and reset the diffs as we go. Note we
+	// don't need to touch the initial CLIENT_STATE buffer or the padding as
+	// they can never change.
+	std::vector<SquareDiff> &past = history[tick % DIFF_HISTORY];
+	past.clear();
+	historyTicks[tick % DIFF_HISTORY] = tick;
+	for (pos_t y = 0; y < height; y++)
+	{
+		state_t *row = diff[y];
+		for (pos_t x = 0; x < width; x++)
+		{
+			if (row[x])
+			{
+				past.push_back({x, y, row[x]});
+				row[x] = 0;
+			}
+		}
+	}
 
-	// Reset the diffs. Note we don't need to touch the initial
-	// CLIENT_STATE buffer as it can never change.
-	std::fill(diff[0], diff[0] + (width + EXTRA_BUFFER) * height, 0);
+	tick++;
 
 	playersChanged = false;
+	playersLeft.clear();
+	playersJoined.clear();
 	scoresChanged = false;
 	leaderboardChanged = false;
 }
@@ -168,6 +284,7 @@ bool GameState::addPlayer(plid_t id, const QString &name, pos_t x, pos_t y)
 	players.insert(id, new Player(*this, id, name, x, y));
 
 	playersChanged = true;
+	playersJoined.insert(id, name);
 
 	return true;
 }
@@ -175,17 +292,22 @@ bool GameState::addPlayer(plid_t id, const QString &name, pos_t x, pos_t y)
 QHash<plid_t, Player *>::iterator GameState::removePlayer(QHash<plid_t, Player *>::iterator i)
 {
 	Player *pl = i.value();
+	plid_t id = i.key();
 	auto ret = players.erase(i);
 
+	playersChanged = true;
+	if (!playersJoined.remove(id))
+		playersLeft.append(id);
+
 	if (!pl)
 	{
-		qWarning() << "Player" << i.key() << "is NULL!";
+		qWarning() << "Player" << id << "is NULL!";
 		return ret;
 	}
 
 	// If the player is still on the board, remove them.
 	SquareState ss = getState(pl->getX(), pl->getY());
-	if (ss.getOccupyingPlayerId() == i.key())
+	if (ss.getOccupyingPlayerId() == id)
 	{
 		ss.setOccupyingPlayerId(UNOCCUPIED);
 		ss.setDirection(Direction::NONE);
@@ -193,8 +315,6 @@ QHash<plid_t, Player *>::iterator GameState::removePlayer(QHash<plid_t, Player *
 
 	delete pl;
 
-	playersChanged = true;
-
 	return ret;
 }
 
@@ -215,6 +335,8 @@ bool GameState::haveScoresChanged() const
 
 void GameState::recomputeLeaderboard()
 {
+	TRACE_SCOPE("GameState::recomputeLeaderboard");
+
 	QList<Player *> pls = players.values();
 	std::sort(pls.begin(), pls.end(), [] (Player *a, Player *b) -> bool {
 		if (!a && !b)
@@ -257,15 +379,29 @@ bool GameState::hasLeaderboardChanged() const
 
 void GameState::lockForRead()
 {
+	qint64 start = Metrics::now();
 	lock.lockForRead();
+	lockTaken(start, false);
 }
 
 void GameState::lockForWrite()
 {
+	qint64 start = Metrics::now();
 	lock.lockForWrite();
+	lockTaken(start, true);
 }
 
 void GameState::unlock()
 {
+	static MetricHistogram *readHold = lockMetric("paper_gamestate_lock_hold_seconds",
+	                                              "Time a GameState lock was held.", false);
+	static MetricHistogram *writeHold = lockMetric("paper_gamestate_lock_hold_seconds",
+	                                               "Time a GameState lock was held.", true);
+
+	qint64 released = Metrics::now();
+	(lockWrite ? writeHold : readHold)->observe(released - lockAcquired);
 	lock.unlock();
+
+	if (Trace::isEnabled())
+		Trace::record(lockWrite ? "write lock held" : "read lock held", lockAcquired, released);
 }
@@ -21,17 +21,36 @@
 
 #include "types.h"
 
+class AIFields;
+class AIPool;
 class ClientHandler;
 class GameHandler;
 class ROGameState;
 
 class GameState;
+class SelfPlayGame;
 class SquareState;
 
+/*
+ * Why a player died. This is only kept server side, for statistics.
+ */
+enum DeathCause
+{
+	DEATH_NONE,		// Still alive
+	DEATH_WALL,		// Ran into the edge of the board
+	DEATH_COLLISION,	// Ran into another player outside of our territory
+	DEATH_RUN_OVER,		// Was run into by another player in their territory
+	DEATH_OWN_TRAIL,	// Crossed our own trail
+	DEATH_TRAIL_CUT,	// Another player crossed our trail
+	DEATH_WON,		// Took the whole board
+	DEATH_DISCONNECT,	// Left the game
+};
+
 class Player
 {
 friend class GameState;
 friend class GameHandler;
+friend class SelfPlayGame;
 public:
 	plid_t getId() const;
 	QString getName() const;
@@ -72,6 +91,7 @@ public:
 	void setActualDirection(Direction dir);
 
 	bool isDead() const;
+	DeathCause getDeathCause() const;
 
 	/*
 	 * Marks the player as dead and removes the player object from the board.
@@ -79,9 +99,9 @@ public:
 	 *
 	 * WARNING: This does not remove the player's trail or the player's territory.
 	 * They must be removed separately in the same tick as this function is called
-	 * or undefined behavior may occur.
+	 * or undefined behavior may occur. Only the first cause of death is kept.
 	 */
-	void kill();
+	void kill(DeathCause cause);
 
 	/*
 	 * A player's score is stored as an unsigned 16 bit integer ranging from
@@ -104,6 +124,7 @@ private:
 	Direction newDir;
 	score_t score;
 	bool dead;
+	DeathCause cause;
 
 	Player(GameState &gs, const plid_t id, const QString &name, pos_t x, pos_t y);
 	Player(const Player &other) = delete;
@@ -204,10 +225,15 @@ private:
 
 class GameState 
 {
+friend class AIFields;
+friend class AIPool;
 friend class ClientHandler;
+friend class GameBoardView;
 friend class GameHandler;
 friend class Player;
 friend class ROGameState;
+friend class SelfPlayGame;
+friend class SpectatorFeed;
 public:
 	pos_t getWidth() const;
 	pos_t getHeight() const;
@@ -243,6 +269,10 @@ private:
 
 	QHash<plid_t, Player *> players;
 	bool playersChanged;
+	// The players who left and joined this tick. A player who joins and
+	// leaves in the same tick is in neither.
+	QVector<plid_t> playersLeft;
+	QHash<plid_t, QString> playersJoined;
 	tick_t tick;
 
 	std::pair<plid_t, score_t> leaderboard[5];
@@ -255,6 +285,36 @@ private:
 	state_t **diff;
 	quint8 **flags;
 
+	/*
+	 * The diffs of the last DIFF_HISTORY ticks before the current one, so
+	 * clients which lost track can be caught up without a whole board.
+	 * Only the squares which changed are kept. Tick t is in slot
+	 * t % DIFF_HISTORY.
+	 */
+	struct SquareDiff
+	{
+		pos_t x;
+		pos_t y;
+		state_t diff;
+	};
+	static const int DIFF_HISTORY = 32;
+	std::vector<SquareDiff> history[DIFF_HISTORY];
+	tick_t historyTicks[DIFF_HISTORY];
+
+	/*
+	 * The diff of the given tick, or NULL if it isn't kept. The current
+	 * tick's diff is still in diff rather than here.
+	 */
+	const std::vector<SquareDiff> *getHistory(tick_t tick) const;
+
+	/*
+	 * Gets what a PACKET_GAME_TICK needs for the given player's view: the
+	 * row or column which came into view as it moved, and pointers to the
+	 * rows of the diff and the board in view. Each array must have room
+	 * for CLIENT_FRAME.
+	 */
+	void getTickView(const Player *pl, state_t *news, state_t **diff, state_t **board) const;
+
 	/*
 	 * If width and height are less than one, bad things will happen.
 	 * In general they should both be at least 15. If they are too
@@ -265,6 +325,10 @@ private:
 	GameState(pos_t width, pos_t height, quint16 tickRate);
 	~GameState();
 
+	/*
+	 * Moves the current tick's diff into the history and starts the next
+	 * tick with an empty diff.
+	 */
 	void nextTick();
 
 	/*
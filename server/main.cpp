@@ -3,15 +3,25 @@
  * code is adapted from the FortuneServer example.
  */
 
+#include <csignal>
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QtNetwork>
 
+#include "clienthandler.h"
 #include "gamestate.h"
+#include "metricsserver.h"
 #include "paperserver.h"
 #include "protocol.h"
+#include "spectatorfeed.h"
+#include "trace.h"
+#include "udplink.h"
 
 void registerPackets();
 
+// Set by SIGUSR1 to ask for a trace dump.
+static volatile std::sig_atomic_t traceRequested = 0;
+
 int main(int argc, char *argv[])
 {
 	// Install a color-coded logger if we're not on Windows (it doesn't work on
@@ -42,15 +52,34 @@ int main(int argc, char *argv[])
 
 	QApplication app(argc, argv);
 
+	QCommandLineParser parser;
+	parser.setApplicationDescription("The paper-io server.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{"metrics-port", "Serve Prometheus metrics on this local port (disabled by default).", "port"},
+		{"trace", "Record a Chrome trace and write it to this file on SIGUSR1 or exit.", "file"},
+		{"trace-interval", "With --trace, also rewrite the trace file every so many seconds.", "secs", "0"},
+		{"udp-loss", "Drop this fraction of the datagrams sent to UDP clients, for testing.", "fraction", "0"},
+		{"udp-delay", "Delay the datagrams sent to UDP clients by this many milliseconds, for testing.", "ms", "0"},
+		{"udp-jitter", "Vary the UDP delay by up to this many milliseconds either way, for testing.", "ms", "0"},
+		{"capabilities", "Only offer clients these optional encodings, as a bit mask (1: coded ticks, 2: packed boards, 4: fast checksums, 8: player deltas, 16: spectators).", "mask", QString::number(CAPABILITIES)},
+	});
+	parser.process(app);
+
 	// Queued Connection type registrations
 	qRegisterMetaType<QAbstractSocket::SocketError>();
+	qRegisterMetaType<ClientHandler *>();
 	qRegisterMetaType<GameState *>();
+	qRegisterMetaType<SpectatorFeed *>();
 	qRegisterMetaType<plid_t>("plid_t");
 	qRegisterMetaType<score_t>("score_t");
 	qRegisterMetaType<Direction>("Direction");
 
 	// Make sure the protocol is set up
 	registerPackets();
+	UdpLink::setImpairment(parser.value("udp-loss").toDouble(), parser.value("udp-delay").toInt(),
+	                       parser.value("udp-jitter").toInt());
+	ClientHandler::setCapabilities(parser.value("capabilities").toUInt(Q_NULLPTR, 0));
 
 	PaperServer server;
 
@@ -70,7 +99,64 @@ int main(int argc, char *argv[])
 		qInfo() << "Listening at: " << ips.at(i).toString() << " on port " << port;
 	}
 
-	return app.exec();
+	// The metrics are only exposed locally; put a proxy in front if they
+	// need to be scraped from elsewhere.
+	MetricsServer metrics;
+	if (parser.isSet("metrics-port"))
+	{
+		bool ok = false;
+		quint16 mport = parser.value("metrics-port").toUShort(&ok);
+		if (!ok || !metrics.listen(QHostAddress::LocalHost, mport))
+			qWarning() << "Unable to serve metrics on port" << parser.value("metrics-port") << ":" << metrics.errorString();
+		else
+			qInfo() << "Serving metrics at:" << qPrintable(QString("http://localhost:%1/metrics").arg(metrics.serverPort()));
+	}
+
+	// Tracing is dumped on request, periodically, and on exit. The signal
+	// handler only sets a flag since almost nothing is safe to do there.
+	QString tracePath = parser.value("trace");
+	if (!tracePath.isEmpty())
+	{
+		QThread::currentThread()->setObjectName("Main");
+		Trace::setEnabled(true);
+
+#ifndef _WIN32
+		std::signal(SIGUSR1, [] (int) {
+			traceRequested = 1;
+		});
+#endif // !_WIN32
+
+		QTimer *poll = new QTimer(&app);
+		poll->setInterval(250);
+		QObject::connect(poll, &QTimer::timeout, &app, [tracePath] {
+			if (!traceRequested)
+				return;
+			traceRequested = 0;
+			if (Trace::dump(tracePath))
+				qInfo() << "Trace written to" << tracePath;
+		});
+		poll->start();
+
+		int interval = parser.value("trace-interval").toInt();
+		if (interval > 0)
+		{
+			QTimer *periodic = new QTimer(&app);
+			periodic->setInterval(interval * 1000);
+			QObject::connect(periodic, &QTimer::timeout, &app, [] {
+				traceRequested = 1;
+			});
+			periodic->start();
+		}
+
+		qInfo() << "Tracing enabled. Writing to" << tracePath;
+	}
+
+	int ret = app.exec();
+
+	if (!tracePath.isEmpty())
+		Trace::dump(tracePath);
+
+	return ret;
 }
 
 void registerPackets()
@@ -86,4 +172,22 @@ void registerPackets()
 	Packet::registerPacket(PACKET_UPDATE_DIR, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUpdateDir>()));
 	Packet::registerPacket(PACKET_REQUEST_RESEND, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestResend>()));
 	Packet::registerPacket(PACKET_GAME_END, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameEnd>()));
+	Packet::registerPacket(PACKET_TIME_SYNC, std::unique_ptr<APacketFactory>(new PacketFactory<PacketTimeSync>()));
+	Packet::registerPacket(PACKET_REQUEST_CATCHUP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestCatchup>()));
+	Packet::registerPacket(PACKET_CATCHUP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketCatchup>()));
+	Packet::registerPacket(PACKET_REQUEST_UDP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestUdp>()));
+	Packet::registerPacket(PACKET_UDP_OFFER, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUdpOffer>()));
+	Packet::registerPacket(PACKET_UDP_HELLO, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUdpHello>()));
+	Packet::registerPacket(PACKET_TICK_ACK, std::unique_ptr<APacketFactory>(new PacketFactory<PacketTickAck>()));
+	Packet::registerPacket(PACKET_DELTA_TICK, std::unique_ptr<APacketFactory>(new PacketFactory<PacketDeltaTick>()));
+	Packet::registerPacket(PACKET_REQUEST_ROWS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestRows>()));
+	Packet::registerPacket(PACKET_PARTIAL_BOARD, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPartialBoard>()));
+	Packet::registerPacket(PACKET_HELLO, std::unique_ptr<APacketFactory>(new PacketFactory<PacketHello>()));
+	Packet::registerPacket(PACKET_CAPABILITIES, std::unique_ptr<APacketFactory>(new PacketFactory<PacketCapabilities>()));
+	Packet::registerPacket(PACKET_PACKED_BOARD, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPackedBoard>()));
+	Packet::registerPacket(PACKET_REQUEST_JOIN_CAPS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestJoinCaps>()));
+	Packet::registerPacket(PACKET_GAME_JOIN_CAPS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameJoinCaps>()));
+	Packet::registerPacket(PACKET_PLAYERS_DELTA, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPlayersDelta>()));
+	Packet::registerPacket(PACKET_REQUEST_PLAYERS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestPlayers>()));
+	Packet::registerPacket(PACKET_REQUEST_SPECTATE, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestSpectate>()));
 }
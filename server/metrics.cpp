@@ -0,0 +1,301 @@
+/*
+ * Implements the metrics registry and its Prometheus rendering.
+ */
+
+#include <QElapsedTimer>
+#include <QtCore>
+
+#include "metrics.h"
+
+const std::vector<double> Metrics::TICK_BUCKETS = {
+	0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1
+};
+
+const std::vector<double> Metrics::LOCK_BUCKETS = {
+	0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025,
+	0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1
+};
+
+// Prometheus wants floating point values in seconds.
+static QString formatSeconds(qint64 nsecs)
+{
+	return QString::number(nsecs / 1e9, 'g', 12);
+}
+
+static QString joinLabels(const QString &labels, const QString &extra)
+{
+	if (labels.isEmpty() && extra.isEmpty())
+		return QString();
+	if (labels.isEmpty())
+		return "{" % extra % "}";
+	if (extra.isEmpty())
+		return "{" % labels % "}";
+	return "{" % labels % "," % extra % "}";
+}
+
+Metric::~Metric()
+{
+}
+
+MetricCounter::MetricCounter()
+	: value(0)
+{
+}
+
+void MetricCounter::inc(quint64 n)
+{
+	value.fetchAndAddRelaxed(n);
+}
+
+quint64 MetricCounter::get() const
+{
+	return value.load();
+}
+
+const char *MetricCounter::getType() const
+{
+	return "counter";
+}
+
+void MetricCounter::render(QTextStream &out, const QString &name, const QString &labels) const
+{
+	out << name << joinLabels(labels, QString()) << " " << get() << "\n";
+}
+
+MetricGauge::MetricGauge()
+	: value(0)
+{
+}
+
+void MetricGauge::set(qint64 v)
+{
+	value.store(v);
+}
+
+void MetricGauge::add(qint64 n)
+{
+	value.fetchAndAddRelaxed(n);
+}
+
+qint64 MetricGauge::get() const
+{
+	return value.load();
+}
+
+const char *MetricGauge::getType() const
+{
+	return "gauge";
+}
+
+void MetricGauge::render(QTextStream &out, const QString &name, const QString &labels) const
+{
+	out << name << joinLabels(labels, QString()) << " " << get() << "\n";
+}
+
+MetricHistogram::MetricHistogram(const std::vector<double> &bds)
+	: bounds()
+	, counts(new QAtomicInteger<quint64>[bds.size() + 1])
+	, count(0)
+	, sum(0)
+{
+	bounds.reserve(bds.size());
+	for (double b : bds)
+		bounds.push_back(static_cast<qint64>(b * 1e9));
+
+	for (size_t i = 0; i <= bounds.size(); ++i)
+		counts[i].store(0);
+}
+
+MetricHistogram::~MetricHistogram()
+{
+	delete[] counts;
+}
+
+void MetricHistogram::observe(qint64 nsecs)
+{
+	if (nsecs < 0)
+		nsecs = 0;
+
+	size_t i = std::lower_bound(bounds.cbegin(), bounds.cend(), nsecs) - bounds.cbegin();
+	counts[i].fetchAndAddRelaxed(1);
+	count.fetchAndAddRelaxed(1);
+	sum.fetchAndAddRelaxed(nsecs);
+}
+
+const char *MetricHistogram::getType() const
+{
+	return "histogram";
+}
+
+void MetricHistogram::render(QTextStream &out, const QString &name, const QString &labels) const
+{
+	// The buckets are cumulative in the exposition format.
+	quint64 cumulative = 0;
+	for (size_t i = 0; i < bounds.size(); ++i)
+	{
+		cumulative += counts[i].load();
+		out << name << "_bucket" << joinLabels(labels, "le=\"" % formatSeconds(bounds[i]) % "\"")
+		    << " " << cumulative << "\n";
+	}
+	cumulative += counts[bounds.size()].load();
+	out << name << "_bucket" << joinLabels(labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+	out << name << "_sum" << joinLabels(labels, QString()) << " " << formatSeconds(sum.load()) << "\n";
+	out << name << "_count" << joinLabels(labels, QString()) << " " << count.load() << "\n";
+}
+
+Metrics::Metrics()
+	: lock()
+	, families()
+{
+}
+
+Metrics::~Metrics()
+{
+	foreach (const Family &fam, families)
+		foreach (Metric *m, fam.series)
+			delete m;
+}
+
+Metrics &Metrics::instance()
+{
+	static Metrics metrics;
+	return metrics;
+}
+
+qint64 Metrics::now()
+{
+	static const QElapsedTimer clock = [] {
+		QElapsedTimer timer;
+		timer.start();
+		return timer;
+	}();
+
+	return clock.nsecsElapsed();
+}
+
+QString Metrics::label(const char *key, const QString &value)
+{
+	QString escaped = value;
+	escaped.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+	escaped.replace(QLatin1Char('"'), QLatin1String("\\\""));
+	escaped.replace(QLatin1Char('\n'), QLatin1String("\\n"));
+	return QLatin1String(key) % "=\"" % escaped % "\"";
+}
+
+QString Metrics::label(const char *key, qint64 value)
+{
+	return label(key, QString::number(value));
+}
+
+Metric *Metrics::lookup(const char *name, const char *help, const QString &labels, std::function<Metric *()> create)
+{
+	QMutexLocker locker(&lock);
+
+	Family &fam = families[QLatin1String(name)];
+	if (fam.help.isEmpty())
+		fam.help = QLatin1String(help);
+
+	Metric *&m = fam.series[labels];
+	if (!m)
+		m = create();
+	return m;
+}
+
+MetricCounter *Metrics::counter(const char *name, const char *help, const QString &labels)
+{
+	Metric *m = lookup(name, help, labels, [] () -> Metric * {
+		return new MetricCounter();
+	});
+
+	MetricCounter *c = dynamic_cast<MetricCounter *>(m);
+	if (!c)
+	{
+		// Hand back something usable rather than crashing the caller. It
+		// isn't exported, so one of each type can be shared by every caller.
+		qCritical() << "Metric" << name << "is registered as a" << m->getType() << "not a counter!";
+		static MetricCounter dummy;
+		c = &dummy;
+	}
+	return c;
+}
+
+MetricGauge *Metrics::gauge(const char *name, const char *help, const QString &labels)
+{
+	Metric *m = lookup(name, help, labels, [] () -> Metric * {
+		return new MetricGauge();
+	});
+
+	MetricGauge *g = dynamic_cast<MetricGauge *>(m);
+	if (!g)
+	{
+		qCritical() << "Metric" << name << "is registered as a" << m->getType() << "not a gauge!";
+		static MetricGauge dummy;
+		g = &dummy;
+	}
+	return g;
+}
+
+MetricHistogram *Metrics::histogram(const char *name, const char *help, const QString &labels,
+                                    const std::vector<double> &bounds)
+{
+	Metric *m = lookup(name, help, labels, [&bounds] () -> Metric * {
+		return new MetricHistogram(bounds);
+	});
+
+	MetricHistogram *h = dynamic_cast<MetricHistogram *>(m);
+	if (!h)
+	{
+		qCritical() << "Metric" << name << "is registered as a" << m->getType() << "not a histogram!";
+		static MetricHistogram dummy(TICK_BUCKETS);
+		h = &dummy;
+	}
+	return h;
+}
+
+void Metrics::remove(const QString &labels)
+{
+	QMutexLocker locker(&lock);
+
+	for (auto iter = families.begin(); iter != families.end(); )
+	{
+		for (auto siter = iter->series.begin(); siter != iter->series.end(); )
+		{
+			const QString &key = siter.key();
+			if (key == labels || key.startsWith(labels + ",") || key.endsWith("," + labels)
+			                  || key.contains("," + labels + ","))
+			{
+				delete siter.value();
+				siter = iter->series.erase(siter);
+			} else {
+				++siter;
+			}
+		}
+
+		if (iter->series.isEmpty())
+			iter = families.erase(iter);
+		else
+			++iter;
+	}
+}
+
+QByteArray Metrics::render() const
+{
+	QString text;
+	QTextStream out(&text);
+
+	lock.lock();
+	for (auto iter = families.cbegin(); iter != families.cend(); ++iter)
+	{
+		if (iter->series.isEmpty())
+			continue;
+
+		out << "# HELP " << iter.key() << " " << iter->help << "\n";
+		out << "# TYPE " << iter.key() << " " << iter->series.first()->getType() << "\n";
+		for (auto siter = iter->series.cbegin(); siter != iter->series.cend(); ++siter)
+			siter.value()->render(out, iter.key(), siter.key());
+	}
+	lock.unlock();
+
+	out.flush();
+	return text.toUtf8();
+}
@@ -0,0 +1,147 @@
+/*
+ * A small registry of runtime metrics which can be rendered in the
+ * Prometheus text exposition format. Counters, gauges, and histograms are
+ * lock free to update, so they can be bumped from the game and IO threads
+ * freely. Only registering, removing, and rendering a series takes the
+ * registry lock.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <functional>
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QTextStream>
+#include <vector>
+
+class Metric
+{
+public:
+	virtual ~Metric();
+
+	virtual const char *getType() const = 0;
+	virtual void render(QTextStream &out, const QString &name, const QString &labels) const = 0;
+};
+
+class MetricCounter : public Metric
+{
+public:
+	MetricCounter();
+
+	void inc(quint64 n = 1);
+	quint64 get() const;
+
+	const char *getType() const override;
+	void render(QTextStream &out, const QString &name, const QString &labels) const override;
+
+private:
+	QAtomicInteger<quint64> value;
+};
+
+class MetricGauge : public Metric
+{
+public:
+	MetricGauge();
+
+	void set(qint64 v);
+	void add(qint64 n);
+	qint64 get() const;
+
+	const char *getType() const override;
+	void render(QTextStream &out, const QString &name, const QString &labels) const override;
+
+private:
+	QAtomicInteger<qint64> value;
+};
+
+/*
+ * A histogram of durations. Observations are made in nanoseconds and
+ * exposed in seconds as Prometheus expects.
+ */
+class MetricHistogram : public Metric
+{
+public:
+	/*
+	 * The bucket bounds are the inclusive upper bounds in seconds and
+	 * must be in ascending order. An implicit +Inf bucket is added.
+	 */
+	MetricHistogram(const std::vector<double> &bounds);
+	~MetricHistogram();
+
+	void observe(qint64 nsecs);
+
+	const char *getType() const override;
+	void render(QTextStream &out, const QString &name, const QString &labels) const override;
+
+private:
+	std::vector<qint64> bounds;
+	QAtomicInteger<quint64> *counts;
+	QAtomicInteger<quint64> count;
+	QAtomicInteger<quint64> sum;
+
+	MetricHistogram(const MetricHistogram &other) = delete;
+};
+
+class Metrics
+{
+public:
+	/* Buckets suited to whole ticks and other millisecond scale work. */
+	static const std::vector<double> TICK_BUCKETS;
+	/* Buckets suited to lock waits and other microsecond scale work. */
+	static const std::vector<double> LOCK_BUCKETS;
+
+	static Metrics &instance();
+
+	/*
+	 * A monotonic clock in nanoseconds, shared by everything that
+	 * records durations.
+	 */
+	static qint64 now();
+
+	/*
+	 * Formats a single label pair, e.g. label("game", 3) gives game="3".
+	 * Label sets are joined with commas.
+	 */
+	static QString label(const char *key, const QString &value);
+	static QString label(const char *key, qint64 value);
+
+	/*
+	 * These return the series with the given name and labels, creating it
+	 * if it doesn't exist yet. The returned pointer remains valid until
+	 * the series is removed.
+	 */
+	MetricCounter *counter(const char *name, const char *help, const QString &labels = QString());
+	MetricGauge *gauge(const char *name, const char *help, const QString &labels = QString());
+	MetricHistogram *histogram(const char *name, const char *help, const QString &labels = QString(),
+	                           const std::vector<double> &bounds = TICK_BUCKETS);
+
+	/*
+	 * Removes and deletes every series whose labels include the given
+	 * label pair (e.g. everything belonging to one game). Any pointers
+	 * to them must no longer be used.
+	 */
+	void remove(const QString &labels);
+
+	QByteArray render() const;
+
+private:
+	struct Family
+	{
+		QString help;
+		QMap<QString, Metric *> series;
+	};
+
+	mutable QMutex lock;
+	QMap<QString, Family> families;
+
+	Metrics();
+	~Metrics();
+
+	Metric *lookup(const char *name, const char *help, const QString &labels, std::function<Metric *()> create);
+};
+
+#endif // !METRICS_H
@@ -0,0 +1,67 @@
+/*
+ * Implements MetricsServer.
+ */
+
+#include <QTcpSocket>
+
+#include "metrics.h"
+#include "metricsserver.h"
+
+// Requests larger than this are dropped. A scrape request is tiny.
+const int MAX_REQUEST = 8192;
+
+MetricsServer::MetricsServer(QObject *parent)
+	: QTcpServer(parent)
+{
+	connect(this, &QTcpServer::newConnection, this, &MetricsServer::acceptScraper);
+}
+
+void MetricsServer::acceptScraper()
+{
+	while (QTcpSocket *sock = nextPendingConnection())
+	{
+		connect(sock, &QAbstractSocket::disconnected, sock, &QObject::deleteLater);
+		connect(sock, &QIODevice::readyRead, this, [this, sock] {
+			respond(sock);
+		});
+	}
+}
+
+void MetricsServer::respond(QTcpSocket *sock)
+{
+	// Wait until we have the whole header.
+	QByteArray req = sock->peek(MAX_REQUEST);
+	if (!req.contains("\r\n\r\n"))
+	{
+		if (req.size() >= MAX_REQUEST)
+		{
+			qWarning() << "Metrics: Request too large. Dropping scraper.";
+			sock->abort();
+		}
+		return;
+	}
+	sock->readAll();
+
+	QList<QByteArray> line = req.left(req.indexOf("\r\n")).split(' ');
+	QByteArray status;
+	QByteArray body;
+	if (line.size() >= 2 && line[0] == "GET" && (line[1] == "/metrics" || line[1] == "/"))
+	{
+		status = "200 OK";
+		body = Metrics::instance().render();
+	} else {
+		status = "404 Not Found";
+		body = "Not Found\n";
+	}
+
+	QByteArray resp;
+	resp += "HTTP/1.1 " + status + "\r\n";
+	resp += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+	resp += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+	resp += "Connection: close\r\n\r\n";
+	resp += body;
+
+	QObject::disconnect(sock, &QIODevice::readyRead, this, 0);
+	sock->write(resp);
+	sock->disconnectFromHost();
+}
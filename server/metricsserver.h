@@ -0,0 +1,28 @@
+/*
+ * A minimal HTTP server which exposes the contents of the Metrics registry
+ * for Prometheus to scrape. It only understands GET /metrics and closes
+ * the connection after every response, which is all a scraper needs.
+ */
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QTcpServer>
+
+class QTcpSocket;
+
+class MetricsServer : public QTcpServer
+{
+	Q_OBJECT
+
+public:
+	MetricsServer(QObject *parent = Q_NULLPTR);
+
+private slots:
+	void acceptScraper();
+
+private:
+	void respond(QTcpSocket *sock);
+};
+
+#endif // !METRICSSERVER_H
@@ -30,6 +30,12 @@ PaperServer::PaperServer(QObject *parent)
 	, connections()
 	, waiting()
 	, ngt(new QTimer(this))
+	, queueDepth(Metrics::instance().gauge("paper_matchmaking_queue_depth",
+	             "Number of connections waiting to be placed in a game."))
+	, connectionCount(Metrics::instance().gauge("paper_connections",
+	                  "Number of open client connections."))
+	, gameCount(Metrics::instance().gauge("paper_games",
+	            "Number of running games."))
 {
 	ngt->setInterval(5000);
 	connect(ngt, &QTimer::timeout, this, &PaperServer::launchGame);
@@ -82,6 +88,9 @@ void PaperServer::incomingConnection(qintptr socketDescriptor)
 	connect(chand, &ClientHandler::requestJoinGame, this, [id,this] (const QString &name) {
 		this->queueConnection(id, name);
 	} ); 
+	connect(chand, &ClientHandler::requestSpectate, this, [id,this] (plid_t target) {
+		this->spectateConnection(id, target);
+	} ); 
 
 	connect(cthrd, &QThread::finished, chand, &QObject::deleteLater);
 	connect(cthrd, &QThread::finished, this, [id,this] {
@@ -93,6 +102,7 @@ void PaperServer::incomingConnection(qintptr socketDescriptor)
 	ThreadClient tc{false, cthrd, chand, QLatin1String("")};
 	ctclock.lock();
 	connections.insert(id, tc);
+	connectionCount->set(connections.size());
 	ctclock.unlock();
 
 	QMetaObject::invokeMethod(chand, "establishConnection", Q_ARG(int, socketDescriptor));
@@ -115,6 +125,7 @@ void PaperServer::ioError(thid_t id, QAbstractSocket::SocketError err, QString m
 	ThreadClient tc = connections.value(id);
 	if (!tc.established)
 		connections.remove(id);
+	connectionCount->set(connections.size());
 	ctclock.unlock();
 }
 
@@ -146,7 +157,9 @@ void PaperServer::queueConnection(thid_t id, const QString &name)
 		return;
 	}
 
+	watching.remove(id);
 	waiting.enqueue(id);
+	queueDepth->set(waiting.size());
 	ThreadClient tc = connections.value(id);
 	if (!name.isEmpty())
 	{
@@ -168,16 +181,57 @@ void PaperServer::queueConnection(thid_t id, const QString &name)
 		ngt->start();
 }
 
+void PaperServer::spectateConnection(thid_t id, plid_t target)
+{
+	ctclock.lock();
+	if (!connections.contains(id))
+	{
+		ctclock.unlock();
+		qWarning() << "Warning: Connection" << id << "is not registered but requests to spectate!";
+		return;
+	}
+
+	waiting.removeAll(id);
+	queueDepth->set(waiting.size());
+
+	if (games.size())
+	{
+		assignSpectator(id, target);
+	} else {
+		// There's nothing to watch until someone wants to play.
+		watching.insert(id, target);
+		QMetaObject::invokeMethod(connections.value(id).client, "enqueue");
+		qDebug() << "Connection" << id << "waiting for a game to spectate.";
+	}
+
+	ctclock.unlock();
+}
+
+void PaperServer::assignSpectator(thid_t id, plid_t target)
+{
+	auto game = games.cbegin();
+	for (auto iter = games.cbegin(); iter != games.cend(); iter++)
+		if (iter.key() < game.key())
+			game = iter;
+
+	QMetaObject::invokeMethod(game.value().game, "addSpectator",
+	                          Q_ARG(ClientHandler *, connections.value(id).client), Q_ARG(plid_t, target));
+	qDebug() << "Connection" << id << "spectating game" << game.key();
+}
+
 void PaperServer::deleteConnection(thid_t id)
 {
 	ctclock.lock();
 	waiting.removeAll(id);
+	watching.remove(id);
 	if (connections.remove(id))
 	{
 		qDebug() << "Connection " << id << " closed.";
 	} else {
 		qWarning() << "Warning: Connection " << id << " is not registered but claims to be terminated!";
 	}
+	queueDepth->set(waiting.size());
+	connectionCount->set(connections.size());
 	ctclock.unlock();
 }
 
@@ -207,16 +261,25 @@ void PaperServer::launchGame()
 
 	ThreadGame gc{gthrd, ghand};
 	games.insert(id, gc);
+	gameCount->set(games.size());
 
 	QMetaObject::invokeMethod(ghand, "startGame");
 
 	qDebug() << "Game" << id << "launched.";
+
+	// Anyone waiting to spectate can now.
+	ctclock.lock();
+	for (auto iter = watching.cbegin(); iter != watching.cend(); iter++)
+		assignSpectator(iter.key(), iter.value());
+	watching.clear();
+	ctclock.unlock();
 }
 
 void PaperServer::deleteGame(gid_t id)
 {
 	if (!games.remove(id))
 		qDebug() << "Game" << id << " reports being terminated, but is not registered!";
+	gameCount->set(games.size());
 }
 
 QList<QPair<ClientHandler *, QString>> PaperServer::dequeueClients(int num)
@@ -238,6 +301,7 @@ QList<QPair<ClientHandler *, QString>> PaperServer::dequeueClients(int num)
 		ThreadClient tc = connections.value(id);
 		ret.append(qMakePair(tc.client, tc.name));
 	}
+	queueDepth->set(waiting.size());
 
 	ctclock.unlock();
 
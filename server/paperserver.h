@@ -14,6 +14,7 @@
 
 #include "gamehandler.h"
 #include "clienthandler.h"
+#include "metrics.h"
 
 class PaperServer : public QTcpServer
 {
@@ -32,6 +33,7 @@ private slots:
 	void ioError(thid_t source, QAbstractSocket::SocketError err, QString msg);
 	void validateConnection(thid_t id);
 	void queueConnection(thid_t id, const QString &name);
+	void spectateConnection(thid_t id, plid_t target);
 	void deleteConnection(thid_t id);
 	void launchGame();
 	void deleteGame(gid_t id);
@@ -44,8 +46,20 @@ private:
 	QMutex ctclock;
 	QHash<thid_t, ThreadClient> connections;
 	QQueue<thid_t> waiting;
+	// Spectators waiting for a game to start, and who they want to follow.
+	QHash<thid_t, plid_t> watching;
 
 	QTimer *ngt;
+
+	MetricGauge *queueDepth;
+	MetricGauge *connectionCount;
+	MetricGauge *gameCount;
+
+	/*
+	 * Has the connection spectate the oldest game. ctclock must be held
+	 * and there must be a game.
+	 */
+	void assignSpectator(thid_t id, plid_t target);
 };
 
 #endif // !PAPERSERVER_H
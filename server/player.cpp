@@ -19,6 +19,7 @@ Player::Player(GameState &ngs, const plid_t pid, const QString &nm, pos_t cx, po
 	, newDir(Direction::NONE)
 	, score(0)
 	, dead(false)
+	, cause(DEATH_NONE)
 {
 }
 
@@ -105,8 +106,15 @@ bool Player::isDead() const
 	return dead;
 }
 
-void Player::kill()
+DeathCause Player::getDeathCause() const
 {
+	return cause;
+}
+
+void Player::kill(DeathCause why)
+{
+	if (!dead)
+		cause = why;
 	dead = true;
 
 	SquareState ss = gs.getState(x, y);
@@ -17,33 +17,58 @@ CXXFLAGS += -g
 
 # Input
 INCLUDEPATH += . $$PWD/../common
-HEADERS += aiplayer.h \
+HEADERS += aifields.h \
+	aiplayer.h \
+	aipool.h \
 	clienthandler.h \
 	gamehandler.h \
 	gamelogic.h \
 	gamestate.h \
+	metrics.h \
+	metricsserver.h \
 	nicks.h \
 	paperserver.h \
+	spectatorfeed.h \
+	trace.h \
+	../common/aiengine.h \
 	../common/protocol.h \
-	../common/types.h
+	../common/tickcoder.h \
+	../common/types.h \
+	../common/udplink.h
 SOURCES += main.cpp \
+	aifields.cpp \
 	aiplayer.cpp \
+	aipool.cpp \
 	clienthandler.cpp \
 	gamehandler.cpp \
 	gamelogic.cpp \
 	gamestate.cpp \
+	metrics.cpp \
+	metricsserver.cpp \
 	nicks.cpp \
 	paperserver.cpp \
 	player.cpp \
+	spectatorfeed.cpp \
 	squarestate.cpp \
+	trace.cpp \
 # Common files
+	../common/packetcapabilities.cpp \
+	../common/packetcatchup.cpp \
 	../common/packetgameend.cpp \
 	../common/packetgamejoin.cpp \
 	../common/packetgametick.cpp \
 	../common/packetleaderboardupdate.cpp \
+	../common/packetpartialboard.cpp \
+	../common/packetplayersdelta.cpp \
 	../common/packetplayersupdate.cpp \
 	../common/packetrequestjoin.cpp \
+	../common/packetrequestspectate.cpp \
 	../common/packetresendboard.cpp \
+	../common/packettimesync.cpp \
+	../common/packetudp.cpp \
 	../common/packetupdatedir.cpp \
-	../common/protocol.cpp
+	../common/protocol.cpp \
+	../common/tickcoder.cpp \
+	../common/tickcodes.cpp \
+	../common/udplink.cpp
 
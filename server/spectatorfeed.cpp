@@ -0,0 +1,120 @@
+/*
+ * Implements SpectatorFeed.
+ */
+
+#include "aiengine.h"
+#include "spectatorfeed.h"
+#include "trace.h"
+
+SpectatorFeed::SpectatorFeed()
+	: lock()
+	, tick(0)
+	, encoded()
+	, overviewValid(false)
+	, overviewTick(0)
+{
+	std::fill(overview[0], overview[0] + CLIENT_FRAME * CLIENT_FRAME, 0);
+	std::fill(overviewDiff[0], overviewDiff[0] + CLIENT_FRAME * CLIENT_FRAME, 0);
+	for (int i = 0; i < CLIENT_FRAME; i++)
+	{
+		overviewRows[i] = overview[i];
+		overviewDiffRows[i] = overviewDiff[i];
+	}
+}
+
+QByteArray SpectatorFeed::get(const GameState &gs, quint32 key, const std::function<QByteArray()> &encode)
+{
+	QMutexLocker locker(&lock);
+
+	if (tick != gs.getTick())
+	{
+		tick = gs.getTick();
+		encoded.clear();
+	}
+
+	auto iter = encoded.constFind(key);
+	if (iter != encoded.constEnd())
+		return iter.value();
+
+	// Only spectators of the whole board need the overview.
+	if (plid_t(key >> 8) == NULL_ID)
+		updateOverview(gs);
+	QByteArray bytes = encode();
+	encoded.insert(key, bytes);
+	return bytes;
+}
+
+void SpectatorFeed::refresh(const GameState &gs)
+{
+	QMutexLocker locker(&lock);
+	updateOverview(gs);
+}
+
+state_t **SpectatorFeed::getOverview()
+{
+	return overviewRows;
+}
+
+state_t **SpectatorFeed::getOverviewDiff()
+{
+	return overviewDiffRows;
+}
+
+void SpectatorFeed::updateOverview(const GameState &gs)
+{
+	if (overviewValid && overviewTick == gs.getTick())
+		return;
+
+	TRACE_SCOPE("SpectatorFeed::updateOverview");
+
+	// Each square of the overview stands for a scale by scale block, with
+	// the board in the middle.
+	pos_t w = gs.getWidth();
+	pos_t h = gs.getHeight();
+	int scale = (std::max(w, h) + CLIENT_FRAME - 1) / CLIENT_FRAME;
+	int ox = (CLIENT_FRAME * scale - w) / 2;
+	int oy = (CLIENT_FRAME * scale - h) / 2;
+
+	for (int vy = 0; vy < CLIENT_FRAME; vy++)
+	{
+		for (int vx = 0; vx < CLIENT_FRAME; vx++)
+		{
+			int x0 = vx * scale - ox;
+			int y0 = vy * scale - oy;
+			int mx = x0 + scale / 2;
+			int my = y0 + scale / 2;
+
+			// Players matter most, then trails, as both are easily lost
+			// in a block.
+			state_t shown = OUT_OF_BOUNDS_STATE;
+			if (0 <= mx && mx < w && 0 <= my && my < h)
+				shown = gs.board[my][mx];
+			bool trail = false;
+			bool occupied = false;
+			for (int y = std::max(y0, 0); y < std::min(y0 + scale, int(h)) && !occupied; y++)
+			{
+				for (int x = std::max(x0, 0); x < std::min(x0 + scale, int(w)); x++)
+				{
+					state_t s = gs.board[y][x];
+					if (getStateOccupyingPlayer(s) != UNOCCUPIED)
+					{
+						shown = s;
+						occupied = true;
+						break;
+					}
+					if (!trail && getStateTrailType(s) != NOTRAIL)
+					{
+						shown = s;
+						trail = true;
+					}
+				}
+			}
+
+			overviewDiff[vy][vx] = overviewValid ? overview[vy][vx] ^ shown : shown;
+			overview[vy][vx] = shown;
+		}
+	}
+
+	overviewValid = true;
+	overviewTick = gs.getTick();
+}
@@ -0,0 +1,73 @@
+/*
+ * The SpectatorFeed class shares the work of sending a game to its
+ * spectators. Spectators following the same player with the same
+ * capabilities are sent exactly the same bytes each tick, so whichever of
+ * their ClientHandlers gets to a tick first encodes it and the rest send
+ * the copy kept here. It also keeps the whole board scaled down to
+ * CLIENT_FRAME squares for the spectators which watch all of it.
+ */
+
+#ifndef SPECTATORFEED_H
+#define SPECTATORFEED_H
+
+#include <functional>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+
+#include "gamestate.h"
+#include "protocol.h"
+#include "types.h"
+
+class SpectatorFeed
+{
+public:
+	SpectatorFeed();
+
+	/*
+	 * Returns the bytes stored under key for the game's current tick,
+	 * calling encode to make them if they haven't been yet. The key is
+	 * the player followed shifted up a byte and or'd with capabilities;
+	 * for NULL_ID the overview is brought up to date first, so encode may
+	 * use it. The GameState must be locked for reading.
+	 */
+	QByteArray get(const GameState &gs, quint32 key, const std::function<QByteArray()> &encode);
+
+	/*
+	 * Brings the overview up to date with the game's current tick. The
+	 * GameState must be locked for reading.
+	 */
+	void refresh(const GameState &gs);
+
+	/*
+	 * The rows of the overview as of the last refresh, and what changed
+	 * in them since the refresh before. Only valid until the GameState is
+	 * unlocked.
+	 */
+	state_t **getOverview();
+	state_t **getOverviewDiff();
+
+private:
+	QMutex lock;
+
+	tick_t tick;
+	QHash<quint32, QByteArray> encoded;
+
+	/*
+	 * The overview is only worked out on the ticks someone asks for it.
+	 * Its diff is from the last of those, which is the last one any
+	 * spectator was sent, so it still adds up if ticks are skipped.
+	 */
+	bool overviewValid;
+	tick_t overviewTick;
+	state_t overview[CLIENT_FRAME][CLIENT_FRAME];
+	state_t overviewDiff[CLIENT_FRAME][CLIENT_FRAME];
+	state_t *overviewRows[CLIENT_FRAME];
+	state_t *overviewDiffRows[CLIENT_FRAME];
+
+	void updateOverview(const GameState &gs);
+};
+
+Q_DECLARE_METATYPE(SpectatorFeed *)
+
+#endif // !SPECTATORFEED_H
@@ -0,0 +1,168 @@
+/*
+ * Implements the trace buffers and the Chrome trace event export.
+ */
+
+#include <QMutex>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QtCore>
+
+#include "trace.h"
+
+// Spans kept per thread. There is a thread per connection, so this is kept
+// fairly small; it is still several seconds of history for the game threads.
+const int TRACE_CAPACITY = 8192;
+
+struct TraceEvent
+{
+	const char *name;
+	qint64 start;
+	qint64 end;
+};
+
+/*
+ * A single producer ring buffer. Only the owning thread writes events and
+ * advances head; the dumper reads head, copies events, and then checks head
+ * again to throw away anything that was overwritten while copying.
+ */
+struct TraceBuffer
+{
+	quint32 tid;
+	QString name;
+	QAtomicInteger<quint64> head;
+	QAtomicInt retired;
+	TraceEvent events[TRACE_CAPACITY];
+};
+
+static QMutex registryLock;
+static QList<TraceBuffer *> registry;
+static quint32 tidCount = 0;
+
+/*
+ * Owns the calling thread's buffer pointer. When the thread exits its
+ * buffer is only marked as retired so the spans still make it into the
+ * next dump, which then frees it.
+ */
+struct TraceThreadBuffer
+{
+	TraceBuffer *buffer = Q_NULLPTR;
+
+	~TraceThreadBuffer()
+	{
+		if (buffer)
+			buffer->retired.store(1);
+	}
+};
+
+static thread_local TraceThreadBuffer threadBuffer;
+
+QAtomicInt Trace::enabled(0);
+
+void Trace::setEnabled(bool on)
+{
+	enabled.store(on);
+}
+
+void Trace::record(const char *name, qint64 start, qint64 end)
+{
+	TraceBuffer *buf = threadBuffer.buffer;
+	if (!buf)
+	{
+		buf = new TraceBuffer;
+		buf->head.store(0);
+		buf->retired.store(0);
+		QThread *thrd = QThread::currentThread();
+		buf->name = thrd && !thrd->objectName().isEmpty() ? thrd->objectName()
+		                                                   : QStringLiteral("Thread");
+
+		registryLock.lock();
+		buf->tid = ++tidCount;
+		registry.append(buf);
+		registryLock.unlock();
+
+		threadBuffer.buffer = buf;
+	}
+
+	quint64 h = buf->head.load();
+	buf->events[h % TRACE_CAPACITY] = TraceEvent{name, start, end};
+	buf->head.storeRelease(h + 1);
+}
+
+// Chrome wants microseconds.
+static QString formatMicros(qint64 nsecs)
+{
+	return QString::number(nsecs / 1000.0, 'f', 3);
+}
+
+static QString escapeJson(QString str)
+{
+	str.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+	str.replace(QLatin1Char('"'), QLatin1String("\\\""));
+	return str;
+}
+
+bool Trace::dump(const QString &path)
+{
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+	{
+		qWarning() << "Trace: Could not open" << path << "for writing:" << file.errorString();
+		return false;
+	}
+
+	QTextStream out(&file);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+
+	std::vector<TraceEvent> copy;
+	copy.reserve(TRACE_CAPACITY);
+
+	registryLock.lock();
+	for (auto iter = registry.begin(); iter != registry.end(); )
+	{
+		TraceBuffer *buf = *iter;
+		bool retired = buf->retired.load();
+
+		quint64 head = buf->head.loadAcquire();
+		quint64 tail = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+		copy.clear();
+		for (quint64 i = tail; i < head; ++i)
+			copy.push_back(buf->events[i % TRACE_CAPACITY]);
+
+		// Anything the thread lapped while we were copying may be torn, and
+		// so may the slot at after, which it could be writing right now.
+		quint64 after = buf->head.loadAcquire();
+		size_t skip = after + 1 > tail + TRACE_CAPACITY ? after + 1 - tail - TRACE_CAPACITY : 0;
+
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buf->tid
+		    << ",\"args\":{\"name\":\"" << escapeJson(buf->name) << "\"}}";
+		first = false;
+
+		for (size_t i = skip; i < copy.size(); ++i)
+		{
+			const TraceEvent &ev = copy[i];
+			out << ",\n{\"name\":\"" << ev.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buf->tid
+			    << ",\"ts\":" << formatMicros(ev.start) << ",\"dur\":" << formatMicros(ev.end - ev.start) << "}";
+		}
+
+		if (retired)
+		{
+			delete buf;
+			iter = registry.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	registryLock.unlock();
+
+	out << "\n]}\n";
+	out.flush();
+
+	if (!file.commit())
+	{
+		qWarning() << "Trace: Could not write" << path << ":" << file.errorString();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+/*
+ * Optional tracing of where the server spends its time. Code marks scoped
+ * spans with TRACE_SCOPE, and each thread appends the finished spans to its
+ * own ring buffer without taking any locks. Trace::dump() writes what the
+ * buffers currently hold as a Chrome trace event file, which can be opened
+ * in chrome://tracing or ui.perfetto.dev.
+ *
+ * Tracing is off by default, in which case a span costs one relaxed atomic
+ * load and no buffers are allocated.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QAtomicInt>
+#include <QString>
+
+#include "metrics.h"
+
+class Trace
+{
+public:
+	static bool isEnabled()
+	{
+		return enabled.load();
+	}
+	static void setEnabled(bool on);
+
+	/*
+	 * Records a finished span on the calling thread. The name must be a
+	 * string literal (or otherwise outlive the trace) as only the pointer
+	 * is stored. Times are from Metrics::now().
+	 */
+	static void record(const char *name, qint64 start, qint64 end);
+
+	/*
+	 * Writes every span currently held in the buffers to the given file,
+	 * replacing it. Returns false if the file couldn't be written.
+	 *
+	 * Threads name themselves in the trace with their QThread's object
+	 * name, so set that before the thread records anything.
+	 */
+	static bool dump(const QString &path);
+
+private:
+	static QAtomicInt enabled;
+};
+
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char *nm)
+		: name(Trace::isEnabled() ? nm : Q_NULLPTR)
+		, start(name ? Metrics::now() : 0)
+	{
+	}
+
+	~TraceSpan()
+	{
+		if (name)
+			Trace::record(name, start, Metrics::now());
+	}
+
+private:
+	const char *name;
+	qint64 start;
+
+	TraceSpan(const TraceSpan &other) = delete;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/* Traces the rest of the enclosing scope under the given name. */
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif // !TRACE_H
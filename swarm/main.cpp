@@ -0,0 +1,187 @@
+/*
+ * This is the main entry point for the paper-io swarm, a headless load
+ * generator which connects many simulated players to a server. Each
+ * player speaks the real protocol through the client's IOHandler and is
+ * steered by KioskAI. Players are spread across a few event loop threads.
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QThread>
+#include <QTimer>
+#include <QtNetwork>
+
+#include "protocol.h"
+#include "swarmbot.h"
+#include "swarmstats.h"
+#include "udplink.h"
+
+void registerPackets();
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("Arduino-IO Swarm");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Connects many simulated players to a paper-io server.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{{"H", "host"}, "Server address.", "host", "127.0.0.1"},
+		{{"p", "port"}, "Server port.", "port"},
+		{{"n", "clients"}, "Number of simulated players.", "count", "100"},
+		{"spectators", "Number of extra connections which watch the whole board instead of playing.", "count", "0"},
+		{{"t", "threads"}, "Number of event loop threads.", "count", QString::number(std::max(QThread::idealThreadCount(), 1))},
+		{"ramp", "Milliseconds between successive connection attempts.", "ms", "10"},
+		{"report", "Seconds between statistics reports.", "secs", "5"},
+		{"duration", "Seconds to run before exiting (0 runs forever).", "secs", "0"},
+		{"name", "Prefix for player names.", "prefix", "Swarm"},
+		{"udp", "Ask for game ticks over UDP."},
+		{"udp-loss", "Drop this fraction of the datagrams the players send.", "fraction", "0"},
+		{"udp-delay", "Delay the datagrams the players send by this many milliseconds.", "ms", "0"},
+		{"udp-jitter", "Vary the UDP delay by up to this many milliseconds either way.", "ms", "0"},
+		{"capabilities", "Only ask for these optional encodings, as a bit mask (see the server's --capabilities).", "mask", QString::number(CAPABILITIES)},
+		{{"v", "verbose"}, "Print protocol debug output."},
+	});
+	parser.process(app);
+
+	bool ok = false;
+	quint16 port = parser.value("port").toUShort(&ok);
+	if (!ok || !port)
+	{
+		qCritical() << "A valid --port is required.";
+		return 1;
+	}
+
+	int clients = std::max(parser.value("clients").toInt(), 1);
+	int spectators = std::max(parser.value("spectators").toInt(), 0);
+	int threads = std::min(std::max(parser.value("threads").toInt(), 1), clients + spectators);
+	int ramp = std::max(parser.value("ramp").toInt(), 0);
+	int report = std::max(parser.value("report").toInt(), 1);
+	int duration = std::max(parser.value("duration").toInt(), 0);
+	QString host = parser.value("host");
+	QString prefix = parser.value("name");
+	bool udp = parser.isSet("udp");
+	quint32 caps = parser.value("capabilities").toUInt(Q_NULLPTR, 0);
+
+	// With thousands of players the protocol debug output would swamp
+	// everything else, so only keep it if asked for.
+	if (!parser.isSet("verbose"))
+		QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false"));
+
+	// Queued Connection type registrations
+	qRegisterMetaType<QAbstractSocket::SocketError>();
+	qRegisterMetaType<score_t>("score_t");
+	qRegisterMetaType<Direction>("Direction");
+
+	// Make sure the protocol is set up
+	registerPackets();
+	UdpLink::setImpairment(parser.value("udp-loss").toDouble(), parser.value("udp-delay").toInt(),
+	                       parser.value("udp-jitter").toInt());
+
+	SwarmStats stats;
+
+	QList<QThread *> workers;
+	for (int i = 0; i < threads; ++i)
+	{
+		QThread *thrd = new QThread(&app);
+		thrd->start();
+		workers.append(thrd);
+	}
+
+	QList<SwarmBot *> bots;
+	for (int i = 0; i < clients + spectators; ++i)
+	{
+		SwarmBot *bot = new SwarmBot(stats, host, port, prefix + QString::number(i), udp, caps, i >= clients);
+		QThread *thrd = workers[i % threads];
+		bot->moveToThread(thrd);
+		QObject::connect(thrd, &QThread::finished, bot, &QObject::deleteLater);
+		bots.append(bot);
+	}
+
+	qInfo() << "Connecting" << clients << "players and" << spectators << "spectators to" << host << "on port" << port << "using" << threads << "threads.";
+
+	// Stagger the connections so we measure the server rather than a
+	// thundering herd on accept().
+	QTimer *launcher = new QTimer(&app);
+	int launched = 0;
+	launcher->setInterval(ramp);
+	QObject::connect(launcher, &QTimer::timeout, &app, [&] {
+		if (launched >= bots.size())
+		{
+			launcher->stop();
+			return;
+		}
+		QMetaObject::invokeMethod(bots[launched++], "start");
+	});
+	launcher->start();
+
+	QTimer *reporter = new QTimer(&app);
+	reporter->setInterval(report * 1000);
+	QObject::connect(reporter, &QTimer::timeout, &app, [&] {
+		qInfo() << qPrintable(stats.report());
+	});
+	reporter->start();
+
+	if (duration)
+	{
+		QTimer::singleShot(duration * 1000, &app, [&] {
+			launcher->stop();
+			foreach (SwarmBot *bot, bots)
+				QMetaObject::invokeMethod(bot, "stop");
+			// Give the bots a moment to flush their statistics.
+			QTimer::singleShot(500, &app, [&] {
+				qInfo() << qPrintable(stats.report());
+				app.quit();
+			});
+		});
+	}
+
+	int ret = app.exec();
+
+	foreach (QThread *thrd, workers)
+	{
+		thrd->quit();
+		if (!thrd->wait(1000)) // Wait for termination (1 sec max)
+		{
+			thrd->terminate();
+			thrd->wait();
+		}
+	}
+
+	return ret;
+}
+
+void registerPackets()
+{
+	Packet::registerPacket(PACKET_KEEP_ALIVE, std::unique_ptr<APacketFactory>(new PacketFactory<PacketKeepAlive>()));
+	Packet::registerPacket(PACKET_REQUEST_JOIN, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestJoin>()));
+	Packet::registerPacket(PACKET_QUEUED, std::unique_ptr<APacketFactory>(new PacketFactory<PacketQueued>()));
+	Packet::registerPacket(PACKET_PLAYERS_UPDATE, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPlayersUpdate>()));
+	Packet::registerPacket(PACKET_LEADERBOARD_UPDATE, std::unique_ptr<APacketFactory>(new PacketFactory<PacketLeaderboardUpdate>()));
+	Packet::registerPacket(PACKET_RESEND_BOARD, std::unique_ptr<APacketFactory>(new PacketFactory<PacketResendBoard>()));
+	Packet::registerPacket(PACKET_GAME_JOIN, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameJoin>()));
+	Packet::registerPacket(PACKET_GAME_TICK, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameTick>()));
+	Packet::registerPacket(PACKET_UPDATE_DIR, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUpdateDir>()));
+	Packet::registerPacket(PACKET_REQUEST_RESEND, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestResend>()));
+	Packet::registerPacket(PACKET_GAME_END, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameEnd>()));
+	Packet::registerPacket(PACKET_TIME_SYNC, std::unique_ptr<APacketFactory>(new PacketFactory<PacketTimeSync>()));
+	Packet::registerPacket(PACKET_REQUEST_CATCHUP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestCatchup>()));
+	Packet::registerPacket(PACKET_CATCHUP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketCatchup>()));
+	Packet::registerPacket(PACKET_REQUEST_UDP, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestUdp>()));
+	Packet::registerPacket(PACKET_UDP_OFFER, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUdpOffer>()));
+	Packet::registerPacket(PACKET_UDP_HELLO, std::unique_ptr<APacketFactory>(new PacketFactory<PacketUdpHello>()));
+	Packet::registerPacket(PACKET_TICK_ACK, std::unique_ptr<APacketFactory>(new PacketFactory<PacketTickAck>()));
+	Packet::registerPacket(PACKET_DELTA_TICK, std::unique_ptr<APacketFactory>(new PacketFactory<PacketDeltaTick>()));
+	Packet::registerPacket(PACKET_REQUEST_ROWS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestRows>()));
+	Packet::registerPacket(PACKET_PARTIAL_BOARD, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPartialBoard>()));
+	Packet::registerPacket(PACKET_HELLO, std::unique_ptr<APacketFactory>(new PacketFactory<PacketHello>()));
+	Packet::registerPacket(PACKET_CAPABILITIES, std::unique_ptr<APacketFactory>(new PacketFactory<PacketCapabilities>()));
+	Packet::registerPacket(PACKET_PACKED_BOARD, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPackedBoard>()));
+	Packet::registerPacket(PACKET_REQUEST_JOIN_CAPS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestJoinCaps>()));
+	Packet::registerPacket(PACKET_GAME_JOIN_CAPS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketGameJoinCaps>()));
+	Packet::registerPacket(PACKET_PLAYERS_DELTA, std::unique_ptr<APacketFactory>(new PacketFactory<PacketPlayersDelta>()));
+	Packet::registerPacket(PACKET_REQUEST_PLAYERS, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestPlayers>()));
+	Packet::registerPacket(PACKET_REQUEST_SPECTATE, std::unique_ptr<APacketFactory>(new PacketFactory<PacketRequestSpectate>()));
+}
@@ -0,0 +1,63 @@
+# Main Config
+TEMPLATE = app
+TARGET = swarm
+CONFIG += c++11 console debug
+CONFIG -= app_bundle
+
+# Build/Install Directories
+MOC_DIR = $$PWD/../build/swarm/moc
+OBJECTS_DIR = $$PWD/../build/swarm/obj
+RCC_DIR = $$PWD/../build/swarm/rcc
+DESTDIR = $$PWD/../bin
+
+# Meta Inputs
+QT = core network
+
+CXXFLAGS += -g
+
+# Inputs
+INCLUDEPATH += . $$PWD/../client $$PWD/../common
+HEADERS += swarmbot.h \
+	swarmstats.h \
+# Client files
+	../client/clientgamestate.h \
+	../client/iohandler.h \
+	../client/kioskai.h \
+	../client/viewbuffer.h \
+# Common files
+	../common/aiengine.h \
+	../common/protocol.h \
+	../common/tickcoder.h \
+	../common/types.h \
+	../common/udplink.h
+SOURCES += main.cpp \
+	swarmbot.cpp \
+	swarmstats.cpp \
+# Client files
+	../client/clientgamestate.cpp \
+	../client/clientplayer.cpp \
+	../client/clientsquarestate.cpp \
+	../client/iohandler.cpp \
+	../client/kioskai.cpp \
+	../client/viewbuffer.cpp \
+# Common files
+	../common/packetcapabilities.cpp \
+	../common/packetcatchup.cpp \
+	../common/packetgameend.cpp \
+	../common/packetgamejoin.cpp \
+	../common/packetgametick.cpp \
+	../common/packetleaderboardupdate.cpp \
+	../common/packetpartialboard.cpp \
+	../common/packetplayersdelta.cpp \
+	../common/packetplayersupdate.cpp \
+	../common/packetrequestjoin.cpp \
+	../common/packetrequestspectate.cpp \
+	../common/packetresendboard.cpp \
+	../common/packettimesync.cpp \
+	../common/packetudp.cpp \
+	../common/packetupdatedir.cpp \
+	../common/protocol.cpp \
+	../common/tickcoder.cpp \
+	../common/tickcodes.cpp \
+	../common/udplink.cpp
+
@@ -0,0 +1,109 @@
+/*
+ * Implements SwarmBot.
+ */
+
+#include <QTimer>
+
+#include "swarmbot.h"
+
+// How long to wait before reconnecting after losing the connection.
+const int RECONNECT_DELAY = 1000;
+
+SwarmBot::SwarmBot(SwarmStats &st, const QString &hst, quint16 prt, const QString &nm, bool udp,
+                   quint32 caps, bool spectate, QObject *parent)
+	: QObject(parent)
+	, stats(st)
+	, host(hst)
+	, port(prt)
+	, name(nm)
+	, cgs()
+	, ioh(new IOHandler(cgs, Q_NULLPTR, this))
+	, connecting(false)
+	, running(false)
+	, connectTimer()
+	, tickTimer()
+	, last{0, 0, 0, 0}
+{
+	// Kiosk mode makes the IOHandler steer with KioskAI and requeue
+	// as soon as a game ends, which is exactly what we want.
+	cgs.kiosk = 1;
+	ioh->setUdp(udp);
+	ioh->setCapabilities(caps);
+	ioh->setSpectate(spectate);
+
+	connect(ioh, &IOHandler::connected, this, &SwarmBot::connected);
+	connect(ioh, &IOHandler::connected, ioh, &IOHandler::enterQueue);
+	connect(ioh, &IOHandler::disconnected, this, &SwarmBot::disconnected);
+	connect(ioh, &IOHandler::error, this, &SwarmBot::ierror);
+	connect(ioh, &IOHandler::enteredGame, this, &SwarmBot::enteredGame);
+	connect(ioh, &IOHandler::gameTick, this, &SwarmBot::gameTick);
+}
+
+void SwarmBot::start()
+{
+	running = true;
+	connecting = true;
+	connectTimer.start();
+	ioh->connectToServer(host, port, name);
+}
+
+void SwarmBot::stop()
+{
+	running = false;
+	collect();
+	ioh->disconnect();
+}
+
+void SwarmBot::connected()
+{
+	connecting = false;
+	stats.recordConnect(connectTimer.nsecsElapsed() / 1000);
+}
+
+void SwarmBot::disconnected()
+{
+	collect();
+	stats.recordDisconnect();
+	tickTimer.invalidate();
+
+	if (running)
+		QTimer::singleShot(RECONNECT_DELAY, this, &SwarmBot::start);
+}
+
+void SwarmBot::ierror(QAbstractSocket::SocketError error, QString msg)
+{
+	if (!connecting)
+		return;
+
+	qWarning() << name << ": Could not connect:" << error << msg;
+	connecting = false;
+	stats.recordConnectFailure();
+
+	if (running)
+		QTimer::singleShot(RECONNECT_DELAY, this, &SwarmBot::start);
+}
+
+void SwarmBot::enteredGame()
+{
+	stats.recordGameJoin();
+	// The gap between the last tick of the previous game and the
+	// first tick of this one isn't jitter.
+	tickTimer.invalidate();
+}
+
+void SwarmBot::gameTick()
+{
+	if (tickTimer.isValid())
+		stats.recordTickInterval(tickTimer.nsecsElapsed() / 1000, cgs.getTickRate());
+	tickTimer.start();
+
+	collect();
+}
+
+void SwarmBot::collect()
+{
+	IOStatistics cur = ioh->getStatistics();
+	stats.addTraffic(cur.bytesReceived - last.bytesReceived, cur.ticks - last.ticks,
+	                 cur.checksumFailures - last.checksumFailures, cur.resendRequests - last.resendRequests);
+	last = cur;
+}
@@ -0,0 +1,56 @@
+/*
+ * A SwarmBot is one simulated player. It drives a regular IOHandler in
+ * kiosk mode, so it decodes the real protocol and steers with KioskAI
+ * exactly like a client left running on a kiosk would. Many bots share
+ * a thread; everything a bot owns lives on that thread.
+ */
+
+#ifndef SWARMBOT_H
+#define SWARMBOT_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+#include "clientgamestate.h"
+#include "iohandler.h"
+#include "swarmstats.h"
+
+class SwarmBot : public QObject
+{
+	Q_OBJECT
+
+public:
+	/* With spectate, the bot watches the whole board instead of playing. */
+	SwarmBot(SwarmStats &stats, const QString &host, quint16 port, const QString &name, bool udp,
+	         quint32 caps, bool spectate = false, QObject *parent = Q_NULLPTR);
+
+public slots:
+	void start();
+	void stop();
+
+private slots:
+	void connected();
+	void disconnected();
+	void ierror(QAbstractSocket::SocketError error, QString msg);
+	void enteredGame();
+	void gameTick();
+
+private:
+	SwarmStats &stats;
+	const QString host;
+	const quint16 port;
+	const QString name;
+
+	ClientGameState cgs;
+	IOHandler *ioh;
+
+	bool connecting;
+	bool running;
+	QElapsedTimer connectTimer;
+	QElapsedTimer tickTimer;
+	IOStatistics last;
+
+	void collect();
+};
+
+#endif // !SWARMBOT_H
@@ -0,0 +1,165 @@
+/*
+ * Implements SwarmStats and LatencyHistogram.
+ */
+
+#include <QtCore>
+
+#include "swarmstats.h"
+
+LatencyHistogram::LatencyHistogram()
+	: count(0)
+	, max(0)
+{
+	for (int i = 0; i < BUCKETS; ++i)
+		counts[i].store(0);
+}
+
+void LatencyHistogram::record(qint64 usecs)
+{
+	if (usecs < 0)
+		usecs = 0;
+
+	int bucket = 0;
+	qint64 bound = 100;
+	while (bucket < BUCKETS - 1 && usecs > bound)
+	{
+		bound *= 2;
+		++bucket;
+	}
+
+	counts[bucket].fetchAndAddRelaxed(1);
+	count.fetchAndAddRelaxed(1);
+
+	qint64 cmax = max.load();
+	while (usecs > cmax && !max.testAndSetOrdered(cmax, usecs, cmax))
+		;
+}
+
+quint64 LatencyHistogram::getCount() const
+{
+	return count.load();
+}
+
+qint64 LatencyHistogram::getMax() const
+{
+	return max.load();
+}
+
+qint64 LatencyHistogram::getQuantile(double q) const
+{
+	quint64 total = count.load();
+	if (!total)
+		return 0;
+
+	quint64 target = std::max<quint64>(1, std::ceil(q * total));
+	quint64 seen = 0;
+	qint64 bound = 100;
+	for (int i = 0; i < BUCKETS; ++i, bound *= 2)
+	{
+		seen += counts[i].load();
+		if (seen >= target)
+			return std::min(bound, getMax());
+	}
+
+	return getMax();
+}
+
+SwarmStats::SwarmStats()
+	: connectLatency()
+	, tickJitter()
+	, connects(0)
+	, connectFailures(0)
+	, disconnects(0)
+	, joins(0)
+	, bytes(0)
+	, ticks(0)
+	, checksumFailures(0)
+	, resends(0)
+	, interval()
+	, lastBytes(0)
+	, lastTicks(0)
+	, lastChecksumFailures(0)
+	, lastResends(0)
+{
+	interval.start();
+}
+
+void SwarmStats::recordConnect(qint64 usecs)
+{
+	connects.fetchAndAddRelaxed(1);
+	connectLatency.record(usecs);
+}
+
+void SwarmStats::recordConnectFailure()
+{
+	connectFailures.fetchAndAddRelaxed(1);
+}
+
+void SwarmStats::recordDisconnect()
+{
+	disconnects.fetchAndAddRelaxed(1);
+}
+
+void SwarmStats::recordGameJoin()
+{
+	joins.fetchAndAddRelaxed(1);
+}
+
+void SwarmStats::recordTickInterval(qint64 usecs, quint16 tickRate)
+{
+	tickJitter.record(std::abs(usecs - 1000 * static_cast<qint64>(tickRate)));
+}
+
+void SwarmStats::addTraffic(quint64 nb, quint32 nt, quint32 nc, quint32 nr)
+{
+	if (nb)
+		bytes.fetchAndAddRelaxed(nb);
+	if (nt)
+		ticks.fetchAndAddRelaxed(nt);
+	if (nc)
+		checksumFailures.fetchAndAddRelaxed(nc);
+	if (nr)
+		resends.fetchAndAddRelaxed(nr);
+}
+
+QString SwarmStats::report()
+{
+	double secs = std::max<qint64>(interval.restart(), 1) / 1000.0;
+
+	quint64 cb = bytes.load();
+	quint64 ct = ticks.load();
+	quint64 cc = checksumFailures.load();
+	quint64 cr = resends.load();
+
+	quint64 db = cb - lastBytes;
+	quint64 dt = ct - lastTicks;
+	quint64 dc = cc - lastChecksumFailures;
+	quint64 dr = cr - lastResends;
+
+	lastBytes = cb;
+	lastTicks = ct;
+	lastChecksumFailures = cc;
+	lastResends = cr;
+
+	QString msg;
+	QTextStream out(&msg);
+	out.setRealNumberNotation(QTextStream::FixedNotation);
+	out.setRealNumberPrecision(2);
+
+	out << "connects " << connects.load() << " (failed " << connectFailures.load()
+	    << ", dropped " << disconnects.load() << "), games joined " << joins.load() << "\n";
+	out << "  connect latency ms: p50 " << connectLatency.getQuantile(0.5) / 1000.0
+	    << " p95 " << connectLatency.getQuantile(0.95) / 1000.0
+	    << " max " << connectLatency.getMax() / 1000.0 << "\n";
+	out << "  tick jitter ms: p50 " << tickJitter.getQuantile(0.5) / 1000.0
+	    << " p95 " << tickJitter.getQuantile(0.95) / 1000.0
+	    << " p99 " << tickJitter.getQuantile(0.99) / 1000.0
+	    << " max " << tickJitter.getMax() / 1000.0 << "\n";
+	out << "  ticks/s " << dt / secs << ", KiB/s " << db / secs / 1024.0
+	    << ", total MiB " << cb / (1024.0 * 1024.0) << "\n";
+	out << "  checksum failures " << dc << " (" << (dt ? 100.0 * dc / dt : 0.0) << "% of ticks)"
+	    << ", resends " << dr << " (" << (dt ? 100.0 * dr / dt : 0.0) << "% of ticks)";
+	out.flush();
+
+	return msg;
+}
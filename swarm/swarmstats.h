@@ -0,0 +1,85 @@
+/*
+ * SwarmStats collects the measurements taken by every SwarmBot in the
+ * process. Bots on any thread may record into it concurrently; all of the
+ * counters are atomic so recording never blocks a bot's event loop.
+ */
+
+#ifndef SWARMSTATS_H
+#define SWARMSTATS_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QString>
+
+/*
+ * A histogram of durations in microseconds with exponentially
+ * growing buckets. Quantiles are reported as the upper bound of
+ * the bucket they fall in.
+ */
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void record(qint64 usecs);
+
+	quint64 getCount() const;
+	qint64 getMax() const;
+	qint64 getQuantile(double q) const;
+
+private:
+	/* Buckets cover 100us * 2^i, so 24 of them reach well past 10 minutes. */
+	static const int BUCKETS = 24;
+
+	QAtomicInteger<quint64> counts[BUCKETS];
+	QAtomicInteger<quint64> count;
+	QAtomicInteger<qint64> max;
+};
+
+class SwarmStats
+{
+public:
+	SwarmStats();
+
+	void recordConnect(qint64 usecs);
+	void recordConnectFailure();
+	void recordDisconnect();
+	void recordGameJoin();
+
+	/*
+	 * Records the time between two consecutive ticks and how far it
+	 * was from the game's advertised tick rate.
+	 */
+	void recordTickInterval(qint64 usecs, quint16 tickRate);
+
+	void addTraffic(quint64 bytes, quint32 ticks, quint32 checksumFailures, quint32 resends);
+
+	/*
+	 * Produces a human readable summary. Rates are computed over the
+	 * time since the previous call; latency quantiles are cumulative.
+	 */
+	QString report();
+
+private:
+	LatencyHistogram connectLatency;
+	LatencyHistogram tickJitter;
+
+	QAtomicInteger<quint32> connects;
+	QAtomicInteger<quint32> connectFailures;
+	QAtomicInteger<quint32> disconnects;
+	QAtomicInteger<quint32> joins;
+
+	QAtomicInteger<quint64> bytes;
+	QAtomicInteger<quint64> ticks;
+	QAtomicInteger<quint64> checksumFailures;
+	QAtomicInteger<quint64> resends;
+
+	// Only touched by report(), which is called from a single thread.
+	QElapsedTimer interval;
+	quint64 lastBytes;
+	quint64 lastTicks;
+	quint64 lastChecksumFailures;
+	quint64 lastResends;
+};
+
+#endif // !SWARMSTATS_H